@@ -11,6 +11,14 @@
 #define DYN_ALLOC_MAX_SIZE (32<<20) 					//32 MB
 #define DYN_ALLOC_MIN_BLOCK_SIZE (1<<LOG2_MIN_SIZE)		//8 BYTE
 #define DYN_ALLOC_MAX_BLOCK_SIZE (1<<LOG2_MAX_SIZE) 	//2 KB
+#define DYN_ALLOC_NUM_OF_POW2_SIZES (LOG2_MAX_SIZE - LOG2_MIN_SIZE + 1)
+//Power of 2 classes come first [index = log2(size) - LOG2_MIN_SIZE], followed by the classes in between them
+//[4 per doubling, multiples of 8]: 24, 40, 48, 56, 80, 96, 112, ..., 1280, 1536, 1792
+#define DYN_ALLOC_NUM_OF_SIZES (DYN_ALLOC_NUM_OF_POW2_SIZES + 3 * (LOG2_MAX_SIZE - LOG2_MIN_SIZE - 2) + 1)
+
+//Size classes (set before initialize_dynamic_allocator())
+#define DA_SIZE_CLASSES_POW2	0		//a class per power of 2: 8, 16, 32, ..., 2 KB
+#define DA_SIZE_CLASSES_FINE	1		//~4 classes per doubling: 8, 16, 24, 32, 40, 48, 56, 64, 80, ..., 2 KB
 
 //[2] Data Structures
 struct BlockElement
@@ -18,7 +26,7 @@ struct BlockElement
 	LIST_ENTRY(BlockElement) prev_next_info;	/* linked list links */
 };
 LIST_HEAD(BlockElement_List, BlockElement);
-struct BlockElement_List freeBlockLists[LOG2_MAX_SIZE - LOG2_MIN_SIZE + 1] ;
+struct BlockElement_List freeBlockLists[DYN_ALLOC_NUM_OF_SIZES] ;
 
 struct PageInfoElement
 {
@@ -34,6 +42,28 @@ struct PageInfoElement pageBlockInfoArr[DYN_ALLOC_MAX_SIZE/PAGE_SIZE];
 uint32 dynAllocStart;
 uint32 dynAllocEnd;
 
+//[4] Statistics (kept up to date by alloc_block() & free_block())
+struct DynAllocStats
+{
+	uint32 num_of_live_blocks[DYN_ALLOC_NUM_OF_SIZES];	//allocated blocks of each size
+	uint32 num_of_pages[DYN_ALLOC_NUM_OF_SIZES];		//pages split into blocks of each size
+	//Total bytes of all the allocations so far: requested vs. taken by each kind of size classes
+	//[only counted while the class statistics are enabled]
+	uint32 requested_bytes;
+	uint32 pow2_class_bytes;
+	uint32 fine_class_bytes;
+};
+struct DynAllocStats dynAllocStats;
+
+//[5] Size classes
+uint32 dynAllocSizeClasses;
+static inline void set_dyn_alloc_size_classes(uint32 classes){dynAllocSizeClasses = classes;}
+static inline uint32 get_dyn_alloc_size_classes(){return dynAllocSizeClasses;}
+//Count the bytes each kind of classes would take [off by default: 2 class lookups per alloc_block()]
+uint32 dynAllocClassStats;
+static inline void set_dyn_alloc_class_stats(uint32 enable){dynAllocClassStats = enable;}
+static inline uint32 get_dyn_alloc_class_stats(){return dynAllocClassStats;}
+
 /*FUNCTIONS*/
 //=============================================================================
 /*2025*/ //GIVEN FUNCTIONS
@@ -45,6 +75,13 @@ int get_page(void* va);		//get a page from the Kernel Page Allocator for DA (i.e
 void return_page(void* va);	//return a page from the DA to Kernel Page Allocator (i.e. Free It)
 //=============================================================================
 
+//Size classes of the block lists
+int get_nearst_power_of_2(uint32 size);
+int get_block_list_idx(uint32 size);
+uint32 get_size_class(uint32 size);
+uint32 get_block_class_size(int idx);
+void print_size_classes_fragmentation();
+
 /*2025*/ //REQUIRED FUNCTIONS
 void initialize_dynamic_allocator(uint32 daStart, uint32 daEnd);
 void *alloc_block(uint32 size);
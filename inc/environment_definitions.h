@@ -103,6 +103,8 @@ struct Context {
   uint32 eip;
 };
 
+struct UserProgramInfo;
+
 struct Env {
 	//================
 	/*MAIN INFO...*/
@@ -123,6 +125,8 @@ struct Env {
 	uint32 *env_page_directory;		// Kernel virtual address of page dir
 	uint32 env_cr3;					// Physical address of page dir
 	uint32 initNumStackPages ;		// Initial number of allocated stack pages
+	uint32 uheap_break;				// Break of the user heap page allocator moved by sys_sbrk()
+	struct UserProgramInfo* program;// Program loaded in the env (to map its shared read-only pages)
 	char* kstack;					//Bottom of kernel stack for this process
 									//(to be dynamically allocated during the process creation)
 									//Its first page is ALWAYS used as a GUARD PAGE (i.e. unmapped)
@@ -184,6 +188,7 @@ struct Env {
 	//================
 	uint32 pageFaultsCounter;
 	uint32 tableFaultsCounter;
+	uint32 cowFaultsCounter;	//writes to copy-on-write pages [see env_fork()]
 	uint32 freeingFullWSCounter;
 	uint32 freeingScarceMemCounter;
 	uint32 nModifiedPages;
@@ -191,6 +196,9 @@ struct Env {
 	uint32 env_runs;			// Number of times environment has run
 	//2020
 	uint32 nPageIn, nPageOut, nNewPageAdded;
+	//page faults served without (minor) & with (major) a page file read, and their total CPU cycles
+	uint32 nMinorFaults, nMajorFaults;
+	uint64 minorFaultsCycles, majorFaultsCycles;
 	uint32 nClocks ;
 	uint32 time;
 
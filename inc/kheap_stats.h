@@ -0,0 +1,35 @@
+#ifndef FOS_INC_KHEAP_STATS_H
+#define FOS_INC_KHEAP_STATS_H
+
+#include <inc/types.h>
+#include <inc/dynamic_allocator.h>
+
+//Snapshot of the kernel heap counters [kheapstat command & sys_get_kheap_stats()].
+//All counters are kept up to date incrementally by the allocators, so taking it is cheap.
+struct KHeapStats
+{
+	//Block allocator [sizes <= DYN_ALLOC_MAX_BLOCK_SIZE], per size class
+	uint32 block_size[DYN_ALLOC_NUM_OF_SIZES];
+	uint32 num_of_live_blocks[DYN_ALLOC_NUM_OF_SIZES];	//allocated blocks (including the ones cached in the magazines)
+	uint32 num_of_cached_blocks[DYN_ALLOC_NUM_OF_SIZES];	//free blocks held in the per-CPU magazines
+	uint32 num_of_free_blocks[DYN_ALLOC_NUM_OF_SIZES];	//free blocks in the freeBlockLists
+	uint32 num_of_pages[DYN_ALLOC_NUM_OF_SIZES];			//pages split into blocks of this size
+	uint32 num_of_free_block_pages;						//pages of the block allocator that are not used yet
+
+	//Page allocator
+	uint32 num_of_used_pages;
+	uint32 num_of_used_segments;
+	uint32 num_of_free_pages;			//pages in the free holes below the break
+	uint32 num_of_free_segments;
+	uint32 largest_free_segment;		//in pages
+	uint32 break_address;				//kheapPageAllocBreak
+	uint32 max_address;					//KERNEL_HEAP_MAX
+
+	//Totals [rates are the difference between 2 snapshots over the difference of their ticks]
+	uint32 num_of_kmallocs;
+	uint32 num_of_kfrees;
+	uint32 num_of_failed_kmallocs;
+	uint32 ticks;
+};
+
+#endif
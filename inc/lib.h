@@ -17,6 +17,7 @@
 #include <inc/x86.h>
 #include <inc/environment_definitions.h>
 #include <inc/semaphore.h>
+#include <inc/kheap_stats.h>
 #include <inc/memlayout.h>
 #include <inc/syscall.h>
 #include <inc/uheap.h>
@@ -55,6 +56,7 @@ void 	sys_exit_env();
 int 	sys_create_env(char* programName, unsigned int page_WS_size,unsigned int LRU_second_list_size,unsigned int percent_WS_pages_to_remove);
 int		sys_destroy_env(int32 envId);
 void	sys_run_env(int32 envId);
+int		sys_fork(void);
 
 //Memory
 int 	__sys_allocate_page(void *va, int perm);
@@ -74,6 +76,7 @@ void* 	sys_sbrk(int numOfPages);
 //User Heap
 void 	sys_free_user_mem(uint32 virtual_address, uint32 size);
 void	sys_allocate_user_mem(uint32 virtual_address, uint32 size);
+int 	sys_free_user_mem_ranges(struct UserMemRange* ranges, uint32 count);
 void	sys_allocate_chunk(uint32 virtual_address, uint32 size, uint32 perms);
 void 	sys_move_user_mem(uint32 src_virtual_address, uint32 dst_virtual_address, uint32 size);
 uint32 	sys_get_uheap_strategy();
@@ -111,6 +114,7 @@ int 	sys_check_WS_list(uint32* WS_list_content, int actual_WS_list_size, uint32
 void 	sys_utilities(char* utilityName, int value);
 //2025
 int 	sys_get_optimal_num_faults();
+int 	sys_get_kheap_stats(struct KHeapStats* stats);
 
 /* concurrency.c */
 void env_sleep(uint32 apprxMilliSeconds);
@@ -52,8 +52,8 @@
  * USER_LIMIT  ------> +------------------------------+ 0xef800000     ------------------+
  *                     |  Cur. Page Table (User R-)   | R-/R-  	PTSIZE
  *    UVPT      ---->  +------------------------------+ 0xef400000
- *                     |   		  FREE Space	      | 		PTSIZE
- *					   +------------------------------+ 0xef000000
+ *                     |     Kernel Temp. Mappings    | RW/--  PTSIZE
+ *    KMAP_BASE --->   +------------------------------+ 0xef000000
  *                     |           RO ENVS            | R-/R-  PTSIZE
  * USER_TOP,UENVS -->  +------------------------------+ 0xeec00000
  * UXSTACKTOP -/       |     User Exception Stack     | RW/RW  PAGE_SIZE
@@ -127,6 +127,11 @@
 //2016: READ_ONLY_FRAMES_INFO is not FIT any more in the 4 MB space
 //#define READ_ONLY_FRAMES_INFO		(UVPT - PTSIZE)
 
+// Kernel-only pages that temporarily map the frames outside the kernel direct map
+// [KMAP_SLOTS pages per CPU, see kmap_frame()]
+#define KMAP_BASE	(UVPT - PTSIZE)
+#define KMAP_SLOTS	4
+
 // Read-only copies of the global env structures
 #define UENVS		(UVPT - 2 * PTSIZE)
 
@@ -205,6 +210,13 @@ extern volatile uint32 vpd[];     // VA of current page directory
 LIST_HEAD(FrameInfo_List, FrameInfo);
 typedef LIST_ENTRY(FrameInfo) Page_LIST_entry_t;
 
+// One user mapping of a frame [see rmap_add()]
+struct FrameMapping {
+	uint32 *page_directory;
+	uint32 virtual_address;
+	struct FrameMapping *next;
+};
+
 struct FrameInfo {
 	/* free list link */
 	Page_LIST_entry_t prev_next_info;
@@ -216,7 +228,13 @@ struct FrameInfo {
 	uint16 references;
 	struct Env *proc;
 	unsigned char isBuffered;
+	unsigned char isShared;		// frame of a shared object: stays shared (not copy-on-write) on fork
 	uint32 base_virual_address;
+	struct FrameMapping *mappings;	// reverse map: all the (directory, va) that map this frame in the user space
+
+	// buddy allocator: set on the first frame of each free block of 2^order frames
+	unsigned char isFreeBlock;
+	unsigned char order;
 };
 
 
@@ -65,9 +65,14 @@
 #define PERM_USED		0x020	// Accessed
 #define PERM_MODIFIED	0x040	// Dirty
 #define PTE_PS			0x080	// Page Size
+#define PERM_GLOBAL		0x100	// Global: not flushed from the TLB on CR3 reload [if CR4_PGE]
 #define PTE_MBZ			0x180	// Bits must be zero
 #define PERM_BUFFERED 	0x200 	//Page is buffered
 #define PERM_UHPAGE 	0x400 	//Page in User Heap
+#define PERM_NEVER_SWAPPED 0x800 //Non-present page has no copy in the page file yet: zero-fill it on fault
+//PERM_NEVER_SWAPPED means nothing once the page is present [it's cleared by map_frame()],
+//so the same bit marks the present pages that are shared copy-on-write
+#define PERM_COW		0x800	//Present page is shared copy-on-write
 
 // The PERM_AVAILABLE bits aren't used by the kernel or interpreted by the
 // hardware, so user processes are allowed to set them arbitrarily.
@@ -93,6 +98,7 @@
 #define CR0_PG		0x80000000	// Paging
 
 #define CR4_PCE		0x00000100	// Performance counter enable
+#define CR4_PGE		0x00000080	// Page Global Enable
 #define CR4_MCE		0x00000040	// Machine Check Enable
 #define CR4_PSE		0x00000010	// Page Size Extensions
 #define CR4_DE		0x00000008	// Debugging Extensions
@@ -100,6 +106,10 @@
 #define CR4_PVI		0x00000002	// Protected-Mode Virtual Interrupts
 #define CR4_VME		0x00000001	// V86 Mode Extensions
 
+// CPUID feature flags (EAX = 1) in EDX
+#define CPUID_FEATURE_PSE	0x00000008	// Page Size Extensions
+#define CPUID_FEATURE_PGE	0x00002000	// Page Global Enable
+
 // Eflags register
 #define FL_CF		0x00000001	// Carry Flag
 #define FL_PF		0x00000004	// Parity Flag
@@ -54,6 +54,10 @@ enum
 	//Your code is here
 	SYS_set_env_priority,
 	//=====================================================================
+	SYS_get_kheap_stats,
+	SYS_free_user_mem_ranges,
+	SYS_sbrk,
+	SYS_fork,
 	NSYSCALLS
 };
 
@@ -7,17 +7,49 @@
 #define UHP_PLACE_NEXTFIT 	0x3
 #define UHP_PLACE_WORSTFIT 	0x4
 #define UHP_PLACE_CUSTOMFIT 0x5
+#define UHP_PLACE_BRK 		0x6	//bump allocation at the per-env break [sys_sbrk()], free() ignores it
 
 //2020
 #define UHP_USE_BUDDY 0
 
+//Start of the page allocator of the user heap (a guard page after the dynamic allocator).
+//It's also the initial per-env break of sys_sbrk()
+#define USER_HEAP_PAGE_ALLOC_START (USER_HEAP_START + DYN_ALLOC_MAX_SIZE + PAGE_SIZE)
+
 //TODO: [PROJECT'25.GM#2] USER HEAP - #0 Page Alloc Limits [GIVEN]
 uint32 uheapPageAllocStart ;
 uint32 uheapPageAllocBreak ;
 uint32 uheapPlaceStrategy ;
 
+//Arenas of the page allocator [see lib/uheap.c]: disabled by default so that each
+//malloc()/free() allocates/frees its pages in the kernel right away
+#define UHEAP_ARENA_PAGES			32	//pages allocated ahead of the break at once
+#define UHEAP_MAX_PENDING_RANGES	32	//freed ranges kept before one batched release
+#define UHEAP_MAX_PENDING_PAGES		256	//freed pages kept before one batched release
+
+struct UserMemRange
+{
+	uint32 virtual_address;
+	uint32 size;
+};
+
+struct UHeapStats
+{
+	uint32 num_of_page_allocs;	//ranges allocated by the page allocator (one sys_allocate_user_mem each w/o arenas)
+	uint32 num_of_page_frees;	//ranges freed by the page allocator (one sys_free_user_mem each w/o arenas)
+	uint32 num_of_syscalls;		//user mem syscalls actually issued for them
+};
+uint8 uheapArenasEnabled ;
+struct UHeapStats uheapStats ;
+
 //=================================================================
+void uheap_set_arenas(uint8 enable);
+static inline int32 uheap_syscalls_saved()
+{
+	return (int32)(uheapStats.num_of_page_allocs + uheapStats.num_of_page_frees) - (int32)uheapStats.num_of_syscalls;
+}
 void *malloc(uint32 size);
+void *calloc(uint32 num, uint32 size);
 void* smalloc(char *sharedVarName, uint32 size, uint8 isWritable);
 void* sget(int32 ownerEnvID, char *sharedVarName);
 void free(void* virtual_address);
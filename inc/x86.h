@@ -30,6 +30,7 @@ static __inline void lcr2(uint32 val) __attribute__((always_inline));
 static __inline void cli() __attribute__((always_inline));
 static __inline void sti() __attribute__((always_inline));
 static __inline uint32 xchg(volatile uint32 *addr, uint32 newval) __attribute__((always_inline));
+static __inline void atomic_add(volatile uint32 *addr, int32 delta) __attribute__((always_inline));
 static __inline void lgdt(struct Segdesc *p, int size) __attribute__((always_inline));
 static __inline void lidt(struct Gatedesc *p, int size) __attribute__((always_inline));
 //****************
@@ -40,6 +41,7 @@ static __inline uint32 rcr3(void) __attribute__((always_inline));
 static __inline void lcr4(uint32 val) __attribute__((always_inline));
 static __inline uint32 rcr4(void) __attribute__((always_inline));
 static __inline void tlbflush(void) __attribute__((always_inline));
+static __inline void tlbflush_global(void) __attribute__((always_inline));
 static __inline uint32 read_eflags(void) __attribute__((always_inline));
 static __inline void write_eflags(uint32 eflags) __attribute__((always_inline));
 static __inline uint32 read_ebp(void) __attribute__((always_inline));
@@ -247,6 +249,20 @@ tlbflush(void)
 	__asm __volatile("movl %0,%%cr3" : : "r" (cr3));
 }
 
+//flush the global entries too [a CR3 reload keeps them]: toggling CR4_PGE flushes the whole TLB
+static __inline void
+tlbflush_global(void)
+{
+	uint32 cr4 = rcr4();
+	if (cr4 & CR4_PGE)
+	{
+		lcr4(cr4 & ~CR4_PGE);
+		lcr4(cr4);
+	}
+	else
+		tlbflush();
+}
+
 static __inline uint32
 read_eflags(void)
 {
@@ -346,6 +362,17 @@ xchg(volatile uint32 *addr, uint32 newval)
   return result;
 }
 
+//atomic add [delta may be negative]
+//Example: atomic_add(&(globalIntVar), -1);
+static __inline void
+atomic_add(volatile uint32 *addr, int32 delta)
+{
+  __asm __volatile("lock; addl %1, %0" :
+               "+m" (*addr) :
+               "ir" (delta) :
+               "cc");
+}
+
 //load GDT register
 static __inline void
 lgdt(struct Segdesc *p, int size)
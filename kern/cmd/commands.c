@@ -16,6 +16,7 @@
 #include "../cpu/sched.h"
 #include "../disk/pagefile_manager.h"
 #include "../mem/kheap.h"
+#include "../mem/kmem_cache.h"
 #include "../mem/memory_manager.h"
 #include "../tests/tst_handler.h"
 #include "../tests/utilities.h"
@@ -55,6 +56,7 @@ struct Command commands[] =
 		{"uhnextfit", "set USER heap placement strategy to NEXT FIT", command_set_uheap_plac_NEXTFIT, 0},
 		{"uhworstfit", "set USER heap placement strategy to WORST FIT", command_set_uheap_plac_WORSTFIT, 0},
 		{"uhcustomfit", "set USER heap placement strategy to CUSTOM FIT", command_set_uheap_plac_CUSTOMFIT, 0},
+		{"uhbrk", "set USER heap placement strategy to BRK (bump allocation at the break)", command_set_uheap_plac_BRK, 0},
 		{"uheap?", "print current USER heap placement strategy", command_print_uheap_plac, 0},
 		{"khcontalloc", "set KERNEL heap placement strategy to CONTINUOUS ALLOCATION", command_set_kheap_plac_CONTALLOC, 0},
 		{"khfirstfit", "set KERNEL heap placement strategy to FIRST FIT", command_set_kheap_plac_FIRSTFIT, 0},
@@ -63,11 +65,16 @@ struct Command commands[] =
 		{"khworstfit", "set KERNEL heap placement strategy to WORST FIT", command_set_kheap_plac_WORSTFIT, 0},
 		{"khcustomfit", "set KERNEL heap placement strategy to CUSTOM FIT", command_set_kheap_plac_CUSTOMFIT, 0},
 		{"kheap?", "print current KERNEL heap placement strategy", command_print_kheap_plac, 0},
+		{"kmemstat", "print statistics of the kernel object caches", command_kmem_cache_stats, 0},
+		{"kheapstat", "print statistics of the kernel heap (live/free per size, holes, break, rates)", command_kheap_stats, 0},
+		{"frag", "print the free blocks & fragmentation of the physical frames [buddy allocator]", command_frames_fragmentation, 0},
 		{"nobuff", "disable buffering", command_disable_buffering, 0},
 		{"buff", "enable buffering", command_enable_buffering, 0},
 		{"nomodbuff", "disable modified buffer", command_disable_modified_buffer, 0},
 		{"modbuff", "enable modified buffer", command_enable_modified_buffer, 0},
 		{"modbufflength?", "get modified buffer length", command_get_modified_buffer_length, 0},
+		{"lazyload", "enable lazy program loading: load the program pages on fault", command_enable_lazy_loading, 0},
+		{"nolazyload", "disable lazy program loading", command_disable_lazy_loading, 0},
 		{"cls", "clear screen", command_cls, 0},
 
 		//*****************************//
@@ -609,6 +616,57 @@ int command_meminfo(int number_of_arguments, char **arguments)
 	return 0;
 }
 
+int command_kmem_cache_stats(int number_of_arguments, char **arguments)
+{
+	kmem_cache_print_stats();
+	return 0;
+}
+
+int command_kheap_stats(int number_of_arguments, char **arguments)
+{
+	//the rates are calculated since the previous call of this command
+	static struct KHeapStats prev_stats;
+	struct KHeapStats stats;
+	get_kheap_stats(&stats);
+
+	cprintf("%6s %8s %8s %8s %8s %6s %10s\n", "block", "live", "cached", "free", "pages", "used%", "live bytes");
+	//classes in increasing size, skipping the ones not used so far
+	for (uint32 size = DYN_ALLOC_MIN_BLOCK_SIZE; size <= DYN_ALLOC_MAX_BLOCK_SIZE; size += DYN_ALLOC_MIN_BLOCK_SIZE)
+	{
+		int i = get_block_list_idx(size);
+		if (stats.block_size[i] != size || (stats.num_of_pages[i] == 0 && stats.num_of_free_blocks[i] == 0))
+			continue;
+		uint32 capacity = stats.num_of_pages[i] * (PAGE_SIZE / stats.block_size[i]);
+		uint32 in_use = stats.num_of_live_blocks[i] - stats.num_of_cached_blocks[i];
+		cprintf("%6d %8d %8d %8d %8d %5d%% %10d\n", stats.block_size[i], stats.num_of_live_blocks[i],
+				stats.num_of_cached_blocks[i], stats.num_of_free_blocks[i], stats.num_of_pages[i],
+				capacity == 0 ? 0 : (in_use * 100) / capacity, in_use * stats.block_size[i]);
+	}
+	cprintf("Block allocator pages not used yet = %d\n", stats.num_of_free_block_pages);
+	print_size_classes_fragmentation();
+
+	cprintf("Page allocator: used = %d pages in %d segments, free = %d pages in %d holes, largest hole = %d pages\n",
+			stats.num_of_used_pages, stats.num_of_used_segments, stats.num_of_free_pages,
+			stats.num_of_free_segments, stats.largest_free_segment);
+	cprintf("Break = %x, %d KB below KERNEL_HEAP_MAX\n", stats.break_address, (stats.max_address - stats.break_address) / 1024);
+
+	cprintf("kmalloc = %d [failed = %d], kfree = %d\n", stats.num_of_kmallocs, stats.num_of_failed_kmallocs, stats.num_of_kfrees);
+	if (prev_stats.ticks != 0 && stats.ticks > prev_stats.ticks)
+	{
+		uint32 elapsed = stats.ticks - prev_stats.ticks;
+		cprintf("Since last kheapstat [%d ticks]: %d kmalloc, %d kfree\n", elapsed,
+				stats.num_of_kmallocs - prev_stats.num_of_kmallocs, stats.num_of_kfrees - prev_stats.num_of_kfrees);
+	}
+	prev_stats = stats;
+	return 0;
+}
+
+int command_frames_fragmentation(int number_of_arguments, char **arguments)
+{
+	print_frames_fragmentation();
+	return 0;
+}
+
 //2020
 struct Env * CreateEnv(int number_of_arguments, char **arguments)
 {
@@ -1032,6 +1090,12 @@ int command_set_uheap_plac_CUSTOMFIT(int number_of_arguments, char **arguments)
 	cprintf("User Heap placement strategy is now CUSTOM FIT\n");
 	return 0;
 }
+int command_set_uheap_plac_BRK(int number_of_arguments, char **arguments)
+{
+	set_uheap_strategy(UHP_PLACE_BRK);
+	cprintf("User Heap placement strategy is now BRK (bump allocation at the break)\n");
+	return 0;
+}
 
 int command_print_uheap_plac(int number_of_arguments, char **arguments)
 {
@@ -1053,6 +1117,9 @@ int command_print_uheap_plac(int number_of_arguments, char **arguments)
 	case UHP_PLACE_CUSTOMFIT:
 		cprintf("User Heap placement strategy is CUSTOM FIT\n");
 		break;
+	case UHP_PLACE_BRK:
+		cprintf("User Heap placement strategy is BRK\n");
+		break;
 	default:
 		cprintf("User Heap placement strategy is UNDEFINED\n");
 	}
@@ -1190,6 +1257,24 @@ int command_enable_buffering(int number_of_arguments, char **arguments)
 	return 0;
 }
 
+int command_enable_lazy_loading(int number_of_arguments, char **arguments)
+{
+#if USE_KHEAP
+	enableLazyProgramLoading(1);
+	cprintf("Lazy program loading is now ENABLED\n");
+#else
+	cprintf("Lazy program loading requires the kernel heap: USE_KHEAP=1\n");
+#endif
+	return 0;
+}
+
+int command_disable_lazy_loading(int number_of_arguments, char **arguments)
+{
+	enableLazyProgramLoading(0);
+	cprintf("Lazy program loading is now DISABLED\n");
+	return 0;
+}
+
 int command_set_modified_buffer_length(int number_of_arguments, char **arguments)
 {
 	if(!isBufferingEnabled())
@@ -86,6 +86,9 @@ int command_readuserblock(int number_of_arguments, char **arguments);
 int command_remove_table(int number_of_arguments, char **arguments);
 int command_allocuserpage(int number_of_arguments, char **arguments);
 int command_meminfo(int number_of_arguments, char **arguments);
+int command_kmem_cache_stats(int number_of_arguments, char **arguments);
+int command_kheap_stats(int number_of_arguments, char **arguments);
+int command_frames_fragmentation(int number_of_arguments, char **arguments);
 //2023
 int command_tst(int number_of_arguments, char **arguments);
 
@@ -113,6 +116,8 @@ int command_enable_modified_buffer(int number_of_arguments, char **arguments);
 //2016
 int command_disable_buffering(int number_of_arguments, char **arguments);
 int command_enable_buffering(int number_of_arguments, char **arguments);
+int command_enable_lazy_loading(int number_of_arguments, char **arguments);
+int command_disable_lazy_loading(int number_of_arguments, char **arguments);
 int command_set_modified_buffer_length(int number_of_arguments, char **arguments);
 int command_get_modified_buffer_length(int number_of_arguments, char **arguments);
 
@@ -123,6 +128,7 @@ int command_set_uheap_plac_BESTFIT(int number_of_arguments, char **arguments);
 int command_set_uheap_plac_NEXTFIT(int number_of_arguments, char **arguments);
 int command_set_uheap_plac_WORSTFIT(int number_of_arguments, char **arguments);
 int command_set_uheap_plac_CUSTOMFIT(int number_of_arguments, char **arguments);
+int command_set_uheap_plac_BRK(int number_of_arguments, char **arguments);
 int command_print_uheap_plac(int number_of_arguments, char **arguments);
 
 //KERNEL HEAP Commands
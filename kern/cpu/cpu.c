@@ -54,6 +54,16 @@ void cpu_init(int cpuIndx)
   c->scheduler = NULL ;
   c->scheduler_status = SCH_UNINITIALIZED;
 
+  //Its free frames cache is empty till the 1st allocate_frame()
+  LIST_INIT(&c->frame_cache);
+
+  //No TLB invalidations are batched till the 1st tlb_batch_begin()
+  c->tlb_batch.depth = 0;
+  c->tlb_batch.num_of_pages = 0;
+
+  //None of its temp. mapping slots is used
+  c->kmap_depth = 0;
+
   //Initialize its sched stack
   c->stack = (char*)(KERN_STACK_TOP - (cpuIndx+1)*KERNEL_STACK_SIZE);
 
@@ -9,6 +9,20 @@
 #define KERN_CPU_CPU_H_
 #include <inc/mmu.h>
 #include <inc/memlayout.h>
+
+//Per-CPU free frames cache [see allocate_frame()/free_frame()]
+#define FRAME_CACHE_BATCH 16	// # frames moved at once between a CPU cache & the global free lists
+#define FRAME_CACHE_HIGH 64		// High watermark: a cache holding more frames is drained by a batch
+
+//Per-CPU batch of pending TLB invalidations [see tlb_batch_begin()/tlb_batch_end()]
+#define TLB_BATCH_MAX_PAGES 32	// More pending pages are flushed by a single CR3 reload instead of an invlpg each
+struct tlb_batch {
+	uint32 depth;				// Depth of tlb_batch_begin() nesting: the invalidations are pending while > 0
+	uint32 *page_directory;		// The address space of the pending invalidations
+	uint32 num_of_pages;		// # pending pages (only the first TLB_BATCH_MAX_PAGES are kept)
+	uint32 virtual_addresses[TLB_BATCH_MAX_PAGES];
+};
+
 // Per-CPU state
 struct cpu {
   unsigned char apicid;			// Local APIC ID
@@ -22,6 +36,9 @@ struct cpu {
   int intena;                  	// Were interrupts enabled before pushcli? (for locking)
   struct Env *proc;           	// The process running on this cpu or null
   int scheduler_status ;		// Status of the scheduler at this CPU
+  struct FrameInfo_List frame_cache;	// Free frames cached by this CPU (still counted as free)
+  struct tlb_batch tlb_batch;	// TLB invalidations of this CPU that wait for a single flush
+  int kmap_depth;				// # its KMAP_SLOTS pages that map a frame now [see kmap_frame()]
 };
 
 struct cpu CPUS[NCPUS] ;
@@ -146,6 +146,10 @@ void fos_scheduler(void)
 		}
 		release_kspinlock(&ProcessQueues.qlock);  //release lock: to protect ready & blocked Qs in multi-CPU
 		//cprintf("\n[FOS_SCHEDULER] release: lock status after = %d\n", qlock.locked);
+
+		//Nothing is ready: use the idle time to clear some frames ahead [see allocate_zeroed_frame()]
+		if (is_any_blocked)
+			refill_zeroed_frames();
 	} while (is_any_blocked > 0);
 
 	/*2015*///No more envs... curenv doesn't exist any more! return back to command prompt
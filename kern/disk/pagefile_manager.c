@@ -15,6 +15,7 @@
 
 #include "../mem/kheap.h"
 #include "../mem/memory_manager.h"
+#include <kern/proc/user_environment.h>
 
 int __pf_write_env_table( struct Env* ptr_env, uint32 virtual_address, uint32* tableKVirtualAddress);
 int __pf_read_env_table(struct Env* ptr_env, uint32 virtual_address, uint32* tableKVirtualAddress);
@@ -134,6 +135,7 @@ int allocate_disk_frame(uint32 *dfn)
 
 //
 // Return a frame to the disk_free_frame_list.
+// (a frame shared by forked envs [references > 0] only loses one of its sharers)
 //
 inline void free_disk_frame(uint32 dfn)
 {
@@ -141,11 +143,32 @@ inline void free_disk_frame(uint32 dfn)
 	if(dfn == 0) return;
 	acquire_kspinlock(&DiskFrameLists.dfllock);
 	{
-		LIST_INSERT_HEAD(&DiskFrameLists.disk_free_frame_list, &disk_frames_info[dfn]);
+		if (disk_frames_info[dfn].references > 0)
+			disk_frames_info[dfn].references--;
+		else
+			LIST_INSERT_HEAD(&DiskFrameLists.disk_free_frame_list, &disk_frames_info[dfn]);
 	}
 	release_kspinlock(&DiskFrameLists.dfllock);
 }
 
+//
+// Give the page at virtual_address its own disk frame if its current one is shared
+// with a forked env, so that writing it doesn't change the page of the other env(s).
+// The content of the new frame is NOT initialized.
+//
+static int unshare_disk_frame(uint32 *ptr_disk_page_table, uint32 virtual_address)
+{
+	uint32 dfn = ptr_disk_page_table[PTX(virtual_address)];
+	if (dfn == 0 || disk_frames_info[dfn].references == 0)
+		return 0;
+
+	uint32 new_dfn;
+	if (allocate_disk_frame(&new_dfn) == E_NO_PAGE_FILE_SPACE) return E_NO_PAGE_FILE_SPACE;
+	ptr_disk_page_table[PTX(virtual_address)] = new_dfn;
+	free_disk_frame(dfn);
+	return 0;
+}
+
 int get_disk_page_table(uint32 *ptr_disk_page_directory, const uint32 virtual_address, int create, uint32 **ptr_disk_page_table)
 {
 	// Fill this function in
@@ -252,6 +275,11 @@ int pf_add_env_page( struct Env* ptr_env, uint32 virtual_address, void* dataSrc)
 		if( allocate_disk_frame(&dfn) == E_NO_PAGE_FILE_SPACE) return E_NO_PAGE_FILE_SPACE;
 		ptr_disk_page_table[PTX(virtual_address)] = dfn;
 	}
+	else
+	{
+		if (unshare_disk_frame(ptr_disk_page_table, virtual_address) == E_NO_PAGE_FILE_SPACE) return E_NO_PAGE_FILE_SPACE;
+		dfn = ptr_disk_page_table[PTX(virtual_address)];
+	}
 
 	//TODOObsolete: we should here lcr3 with the env pgdir to make sure that dataSrc is not read mistakenly
 	// from another env directory
@@ -286,7 +314,8 @@ int pf_update_env_page(struct Env* ptr_env, uint32 virtual_address, struct Frame
 	{
 
 		if ((virtual_address >= USER_HEAP_START && virtual_address < USER_HEAP_MAX) ||
-				(virtual_address >= USTACKBOTTOM && virtual_address < USTACKTOP))
+				(virtual_address >= USTACKBOTTOM && virtual_address < USTACKTOP) ||
+				(virtual_address < USER_HEAP_START && is_program_page(ptr_env, virtual_address)))
 		{
 			/*2023*/ //EL7 :)
 			/* REMOVE THIS CONDITION SINCE THE GIVEN virtual_address MIGHT HAVE PRESENT = 0
@@ -327,17 +356,26 @@ int pf_update_env_page(struct Env* ptr_env, uint32 virtual_address, struct Frame
 				//cprintf("[%s] adding EMPTY page with content\n",ptr_env->prog_name);
 
 				ptr_env->nNewPageAdded++ ;
+
+				//From now on, the page has a copy in the page file (can't be zero-filled on fault)
+				//[a present page has no PERM_NEVER_SWAPPED: the bit is its PERM_COW]
+				if (!(pt_get_page_permissions(ptr_env->env_page_directory, virtual_address) & PERM_PRESENT))
+					pt_set_page_permissions(ptr_env->env_page_directory, virtual_address, 0, PERM_NEVER_SWAPPED);
 			}
 		}
 		else
 		{
-			panic("pf_update_env_page: Invalid Access - Attempt to add a new page to page file that's outside the USER HEAP and USER STACK!");
+			panic("pf_update_env_page: Invalid Access - Attempt to add a new page to page file that's outside the USER HEAP, USER STACK and the program!");
 		}
 	}
 	//2022 END========================================
 
 
 	get_disk_page_table(ptr_env->disk_env_pgdir, virtual_address, 0, &ptr_disk_page_table);
+	if (unshare_disk_frame(ptr_disk_page_table, virtual_address) == E_NO_PAGE_FILE_SPACE)
+	{
+		panic("pf_update_env_page: attempt to unshare a forked page, but page file out of space!") ;
+	}
 	uint32 dfn=ptr_disk_page_table[PTX(virtual_address)];
 
 #if USE_KHEAP
@@ -465,6 +503,64 @@ void pf_remove_env_page(struct Env* ptr_env, uint32 virtual_address)
 	//LOG_STRING("pf_remove_env_page: 3");
 }
 
+//Move the page file slot (if any) of src_va to dst_va [see move_user_mem()]
+int pf_move_env_page(struct Env* ptr_env, uint32 src_va, uint32 dst_va)
+{
+	uint32 *ptr_src_disk_page_table, *ptr_dst_disk_page_table;
+
+	if (ptr_env->disk_env_pgdir == 0) return 0;
+	get_disk_page_table(ptr_env->disk_env_pgdir, src_va, 0, &ptr_src_disk_page_table);
+	if (ptr_src_disk_page_table == 0) return 0;
+
+	uint32 dfn = ptr_src_disk_page_table[PTX(src_va)];
+	if (dfn == 0) return 0;
+
+	int ret = get_disk_page_table(ptr_env->disk_env_pgdir, dst_va, 1, &ptr_dst_disk_page_table);
+	if (ret != 0) return ret;
+
+	ptr_src_disk_page_table[PTX(src_va)] = 0;
+	free_disk_frame(ptr_dst_disk_page_table[PTX(dst_va)]);
+	ptr_dst_disk_page_table[PTX(dst_va)] = dfn;
+	return 0;
+}
+
+//Share all the page file slots of src_env with dst_env [see env_fork()]:
+//	each shared slot is reference counted & is unshared on the first write by any of them
+int pf_share_env_pages(struct Env* src_env, struct Env* dst_env)
+{
+	uint32 pdeno, *ptr_dst_disk_page_table;
+
+	if (src_env->disk_env_pgdir == 0) return 0;
+	int ret = get_disk_page_directory(dst_env, &(dst_env->disk_env_pgdir));
+	if (ret != 0) return ret;
+
+	for (pdeno = 0; pdeno < PDX(USER_TOP) ; pdeno++)
+	{
+		if (!(src_env->disk_env_pgdir[pdeno] & PERM_PRESENT))
+			continue;
+
+		uint32 *pt;
+		get_disk_page_table(src_env->disk_env_pgdir, pdeno << PDXSHIFT, 0, &pt);
+		ret = get_disk_page_table(dst_env->disk_env_pgdir, pdeno << PDXSHIFT, 1, &ptr_dst_disk_page_table);
+		if (ret != 0) return ret;
+
+		acquire_kspinlock(&DiskFrameLists.dfllock);
+		{
+			uint32 pteno;
+			for (pteno = 0; pteno < 1024; pteno++)
+			{
+				uint32 dfn = pt[pteno];
+				if (dfn == 0)
+					continue;
+				ptr_dst_disk_page_table[pteno] = dfn;
+				disk_frames_info[dfn].references++;
+			}
+		}
+		release_kspinlock(&DiskFrameLists.dfllock);
+	}
+	return 0;
+}
+
 void pf_free_env(struct Env* ptr_env)
 {
 	uint32 pdeno;
@@ -31,6 +31,8 @@ int pf_update_env_page(struct Env* ptr_env, uint32 virtual_address, struct Frame
 //int pf_special_update_env_modified_page(struct Env* ptr_env, uint32 virtual_address, struct Frame_Info* page_modified_frame_info);
 int pf_read_env_page(struct Env* ptr_env, void* virtual_address);
 void pf_remove_env_page(struct Env* ptr_env, uint32 virtual_address);
+int pf_move_env_page(struct Env* ptr_env, uint32 src_va, uint32 dst_va);
+int pf_share_env_pages(struct Env* src_env, struct Env* dst_env);
 ///=============================================================================================
 
 int pf_calculate_allocated_pages(struct Env* ptr_env);
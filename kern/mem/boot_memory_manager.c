@@ -74,11 +74,29 @@ seg_init(void)
 // From USER_TOP to USER_LIMIT, the user is allowed to read but not write.
 // Above USER_LIMIT the user cannot read (or write).
 
+static void enable_large_pages()
+{
+	uint32 eax, ebx, ecx, edx;
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	pse_enabled = (edx & CPUID_FEATURE_PSE) != 0;
+	if (pse_enabled)
+		lcr4(rcr4() | CR4_PSE);
+
+	//PGE: the kernel half (>= KERNEL_BASE) is the same in all the directories, so its mappings
+	//are made global [KERNEL_GLOBAL_PERM] to survive the CR3 reloads of the context switches.
+	//CR4_PGE is set in turn_on_paging() once the temporary low mappings are removed.
+	pge_enabled = (edx & CPUID_FEATURE_PGE) != 0;
+}
+
 void initialize_kernel_VM()
 {
 	// Remove this line when you're ready to test this function.
 	//panic("initialize_kernel_VM: This function is not finished\n");
 
+	//PSE: allow 4 MB pages in the kernel direct map [see boot_map_range()] & for the big kheap
+	//allocations [see map_pages() in kheap.c]
+	enable_large_pages();
+
 	//////////////////////////////////////////////////////////////////////
 	// create initial page directory.
 
@@ -123,6 +141,10 @@ void initialize_kernel_VM()
 	}
 	//cprintf("nTables = %d\n", nTables);
 
+	//the table of the kernel temp. mappings is created here as well, so it's shared by all the
+	//page directories of the envs [see kmap_frame()]
+	ptr_kmap_page_table = boot_get_page_table(ptr_page_directory, KMAP_BASE, 1);
+
 	//////////////////////////////////////////////////////////////////////
 	// Make 'frames_info' point to an array of size 'number_of_frames' of 'struct Frame_Info'.
 	// The kernel uses this structure to keep track of physical frames;
@@ -185,11 +207,11 @@ void initialize_kernel_VM()
 		// MAKE SURE THAT THIS MAPPING HAPPENS AFTER ALL BOOT ALLOCATIONS (boot_allocate_space)
 		// calls are fininshed, and no remaining data to be allocated for the kernel
 		// map all used pages so far for the kernel
-		boot_map_range(ptr_page_directory, KERNEL_BASE, (uint32)ptr_free_mem - KERNEL_BASE, 0, PERM_WRITEABLE) ;
+		boot_map_range(ptr_page_directory, KERNEL_BASE, (uint32)ptr_free_mem - KERNEL_BASE, 0, PERM_WRITEABLE | KERNEL_GLOBAL_PERM) ;
 	}
 #else
 	{
-		boot_map_range(ptr_page_directory, KERNEL_BASE, 0xFFFFFFFF - KERNEL_BASE, 0, PERM_WRITEABLE) ;
+		boot_map_range(ptr_page_directory, KERNEL_BASE, 0xFFFFFFFF - KERNEL_BASE, 0, PERM_WRITEABLE | KERNEL_GLOBAL_PERM) ;
 	}
 #endif
 	// Check that the initial page directory has been set up correctly.
@@ -256,6 +278,11 @@ void* boot_allocate_space(uint32 size, uint32 align)
 // in the page table rooted at ptr_page_directory.
 // "size" is a multiple of PAGE_SIZE.
 // Use permission bits perm|PERM_PRESENT for the entries.
+// If PSE is enabled, each 4 MB aligned part of a kernel range is mapped by a single 4 MB page in
+// the directory entry itself (one TLB entry), except the 1st 4 MB of the physical memory: its IO
+// hole & BIOS areas have other memory types [fixed MTRRs], so they're kept on 4 KB pages.
+// The page table of such entry is kept in saved_kernel_tables to be restored on split
+// [see split_kernel_large_page()].
 //
 // This function may ONLY be used during boot time,
 // before the free_frame_list has been set up.
@@ -269,6 +296,17 @@ void boot_map_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 s
 	for (i = 0 ; i < size ; i += PAGE_SIZE)
 	{
 		uint32 *ptr_page_table = boot_get_page_table(ptr_page_directory, virtual_address, 1) ;
+		if (pse_enabled && CHECK_IF_KERNEL_ADDRESS(virtual_address) && physical_address >= PTSIZE &&
+				virtual_address % PTSIZE == 0 && physical_address % PTSIZE == 0 && size - i >= PTSIZE)
+		{
+			uint32 pdx = PDX(virtual_address);
+			saved_kernel_tables[pdx] = ptr_page_directory[pdx];
+			ptr_page_directory[pdx] = CONSTRUCT_ENTRY(physical_address, perm | PERM_PRESENT | PTE_PS) ;
+			physical_address += PTSIZE ;
+			virtual_address += PTSIZE ;
+			i += PTSIZE - PAGE_SIZE ;
+			continue;
+		}
 		uint32 index_page_table = PTX(virtual_address);
 		//LOG_VARS("\nCONSTRUCT_ENTRY = %x",physical_address);
 		ptr_page_table[index_page_table] = CONSTRUCT_ENTRY(physical_address, perm | PERM_PRESENT) ;
@@ -451,6 +489,10 @@ void turn_on_paging()
 	// Flush the TLB for good measure, to kill the ptr_page_directory[0] mapping.
 	lcr3(phys_page_directory);
 
+	// The low mappings are gone: from now on, the kernel mappings are kept in the TLB on CR3 reloads
+	if (pge_enabled)
+		lcr4(rcr4() | CR4_PGE);
+
 }
 
 void setup_listing_to_all_page_tables_entries()
@@ -22,15 +22,28 @@ uint32* ptr_page_directory;			// Virtual address of boot time page directory
 uint8* ptr_zero_page;				// Virtual address of zero page used by program loader to initialize extra segment zero memory (bss section) it to zero
 uint8* ptr_temp_page;				// Virtual address of a page used by program loader to initialize segment last page fraction
 uint32 phys_page_directory;			// Physical address of boot time page directory
+uint32* ptr_kmap_page_table;		// Virtual address of the page table of the kernel temp. mappings [KMAP_BASE]
 char* ptr_free_mem;					// Pointer to next byte of free mem
+uint32 pse_enabled;					// 4 MB pages are supported by the CPU & enabled in CR4 [PSE]
+uint32 pge_enabled;					// the kernel mappings are global [PERM_GLOBAL] & enabled in CR4 [PGE]
+#define KERNEL_GLOBAL_PERM (pge_enabled ? PERM_GLOBAL : 0)
+uint32 saved_kernel_tables[NPDENTRIES];	// Page table of each kernel entry that maps a 4 MB page [PSE], restored on split
 
 //struct FrameInfo* disk_frames_info;	// Virtual address of physical frames_info array
 struct FrameInfo* frames_info;		// Virtual address of physical frames_info array
 
+#define MAX_FRAME_ORDER 10		// Largest block of the buddy allocator is 2^10 frames [4 MB]
+
 struct
 {
-	struct FrameInfo_List free_frame_list;		// Free list of physical frames_info
+	struct FrameInfo_List free_frame_list;		// Free list of physical frames_info [single frames, i.e. buddy blocks of order 0]
+	struct FrameInfo_List free_block_lists[MAX_FRAME_ORDER + 1];	// Free buddy blocks of each order > 0 [index 0 is not used]
 	struct FrameInfo_List modified_frame_list;	// Modified frame list for buffering
+	struct FrameInfo_List zeroed_frame_list;	// Free frames that are already cleared [see allocate_zeroed_frame()]
+	uint32 num_of_free_buffered;				// # frames in the free blocks of all orders that are buffered...
+	uint32 num_of_free_not_buffered;			// ...& not buffered [kept up to date by the buddy allocator]
+	uint32 num_of_zeroing;						// Free frames being cleared outside the lock [see refill_zeroed_frames()]
+	volatile uint32 num_of_cached;				// Free frames cached by all the CPUs [changed by atomic_add(), see free_frame()]
 	struct kspinlock mfllock;					// Lock to protect the frame info lists
 } MemFrameLists;
 
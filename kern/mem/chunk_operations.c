@@ -28,9 +28,49 @@
 //	The given addresses may be not aligned on 4 KB
 int cut_paste_pages(uint32* page_directory, uint32 source_va, uint32 dest_va, uint32 num_of_pages)
 {
-	//TODO: PRACTICE: fill this function.
-	//Comment the following line
-	panic("cut_paste_pages() is not implemented yet...!!");
+	uint32 src_start = ROUNDDOWN(source_va, PAGE_SIZE);
+	uint32 dst_start = ROUNDDOWN(dest_va, PAGE_SIZE);
+	uint32 *ptr_src_table = NULL, *ptr_dst_table = NULL;
+
+	//deny if any destination page exists [a missing table means a free 4 MB]
+	for (uint32 i = 0; i < num_of_pages; ++i)
+	{
+		uint32 dst_va = dst_start + i * PAGE_SIZE;
+		if (i == 0 || dst_va % PTSIZE == 0)
+			get_page_table(page_directory, dst_va, &ptr_dst_table);
+		if (ptr_dst_table != NULL && (ptr_dst_table[PTX(dst_va)] & PERM_PRESENT))
+			return -1;
+	}
+
+	//move the whole entries (frame, permissions & available bits): the references don't change
+	for (uint32 i = 0; i < num_of_pages; ++i)
+	{
+		uint32 src_va = src_start + i * PAGE_SIZE;
+		uint32 dst_va = dst_start + i * PAGE_SIZE;
+		if (i == 0 || src_va % PTSIZE == 0)
+			get_page_table(page_directory, src_va, &ptr_src_table);
+		if (i == 0 || dst_va % PTSIZE == 0)
+		{
+			get_page_table(page_directory, dst_va, &ptr_dst_table);
+			if (ptr_dst_table == NULL)
+				ptr_dst_table = create_page_table(page_directory, dst_va);
+		}
+		if (ptr_src_table == NULL)
+			continue;
+
+		uint32 entry = ptr_src_table[PTX(src_va)];
+		ptr_dst_table[PTX(dst_va)] = entry;
+		ptr_src_table[PTX(src_va)] = 0;
+		if (entry & PERM_PRESENT)
+		{
+			struct FrameInfo *ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(entry));
+			ptr_frame_info->base_virual_address = dst_va;
+			rmap_move(ptr_frame_info, page_directory, src_va, dst_va);
+		}
+		tlb_invalidate(page_directory, (void *)src_va);
+		tlb_invalidate(page_directory, (void *)dst_va);
+	}
+	return 0;
 }
 
 //===============================
@@ -79,9 +119,23 @@ int share_chunk(uint32* page_directory, uint32 source_va,uint32 dest_va, uint32
 //	Allocation should be aligned on page boundary. However, the given range may be not aligned.
 int allocate_chunk(uint32* page_directory, uint32 va, uint32 size, uint32 perms)
 {
-	//TODO: PRACTICE: fill this function.
-	//Comment the following line
-	panic("allocate_chunk() is not implemented yet...!!");
+	uint32 start_va = ROUNDDOWN(va, PAGE_SIZE);
+	uint32 end_va = ROUNDUP(va + size, PAGE_SIZE);
+	uint32 num_of_pages = (end_va - start_va) / PAGE_SIZE;
+
+	//deny if any page of the range exists [a missing table means a free 4 MB]
+	uint32 *ptr_page_table = NULL;
+	for (uint32 cur_va = start_va; cur_va < end_va; cur_va += PAGE_SIZE)
+	{
+		if (cur_va == start_va || cur_va % PTSIZE == 0)
+			get_page_table(page_directory, cur_va, &ptr_page_table);
+		if (ptr_page_table != NULL && (ptr_page_table[PTX(cur_va)] & PERM_PRESENT))
+			return -1;
+	}
+	//allocate the frames & map them in one go
+	if (map_range(page_directory, start_va, num_of_pages, perms, 0) != 0)
+		return -1;
+	return 0;
 }
 
 
@@ -137,9 +191,55 @@ uint32 calculate_required_frames(uint32* page_directory, uint32 sva, uint32 size
 /* DYNAMIC ALLOCATOR SYSTEM CALLS */
 //=====================================
 /*2024*/
+//The pages of [USER_HEAP_PAGE_ALLOC_START, break) belong to sys_sbrk() & the ones above it to
+//the page allocator of the user heap: the break is only moved over pages that are neither
+//mapped nor marked, and the page allocator can't allocate/free/move below it
+//[see sys_allocate_user_mem()].
+static bool is_user_range_unused(struct Env* e, uint32 virtual_address, uint32 num_of_pages)
+{
+	for (uint32 i = 0; i < num_of_pages; ++i)
+	{
+		uint32 *ptr_page_table = NULL;
+		uint32 va = virtual_address + i * PAGE_SIZE;
+		get_page_table(e->env_page_directory, va, &ptr_page_table);
+		if (ptr_page_table != NULL && (ptr_page_table[PTX(va)] & (PERM_PRESENT | PERM_UHPAGE)))
+			return 0;
+	}
+	return 1;
+}
+
+bool overlaps_user_break(struct Env* e, uint32 virtual_address, uint32 size)
+{
+	return virtual_address < e->uheap_break && virtual_address + size > USER_HEAP_PAGE_ALLOC_START;
+}
+
+//Move the user heap break of the current env by numOfPages (may be -ve) & return its
+//previous value, or -1 if the new break is out of [USER_HEAP_PAGE_ALLOC_START, USER_HEAP_MAX]
+//or if it'd grow over pages of the page allocator.
+//The new pages are only marked: they're allocated on their first access.
 void* sys_sbrk(int numOfPages)
 {
-	panic("not implemented function");
+	struct Env* e = get_cpu_proc();
+	assert(e != NULL);
+
+	uint32 old_break = e->uheap_break;
+	//unsigned: -numOfPages doesn't fit in an int for INT_MIN
+	uint32 num_of_pages = numOfPages < 0 ? 0U - (uint32)numOfPages : (uint32)numOfPages;
+	if (numOfPages > 0)
+	{
+		if (num_of_pages > (USER_HEAP_MAX - old_break) / PAGE_SIZE || !is_user_range_unused(e, old_break, num_of_pages))
+			return (void*)-1;
+		allocate_user_mem(e, old_break, num_of_pages * PAGE_SIZE);
+		e->uheap_break = old_break + num_of_pages * PAGE_SIZE;
+	}
+	else if (numOfPages < 0)
+	{
+		if (num_of_pages > (old_break - USER_HEAP_PAGE_ALLOC_START) / PAGE_SIZE)
+			return (void*)-1;
+		e->uheap_break = old_break - num_of_pages * PAGE_SIZE;
+		free_user_mem(e, e->uheap_break, num_of_pages * PAGE_SIZE);
+	}
+	return (void*)old_break;
 }
 
 //=====================================
@@ -178,8 +278,8 @@ void allocate_user_mem(struct Env* e, uint32 virtual_address, uint32 size)
 
 //		map_frame(ptr_page_directory, frame_info, v, PERM_USER | PERM_WRITEABLE | PERM_UHPAGE);
 
-		// assign in its permissions the three flags
-		pt_set_page_permissions(ptr_page_directory ,v, PERM_UHPAGE | PERM_AVAILABLE, 0);
+		// mark it as a user heap page that's zero-filled on its first touch
+		pt_set_page_permissions(ptr_page_directory ,v, PERM_UHPAGE | PERM_NEVER_SWAPPED, 0);
 
 	}
 
@@ -207,6 +307,8 @@ void free_user_mem(struct Env* e, uint32 virtual_address, uint32 size)
 
 	uint32 Range = virtual_address + rounded_size;
 
+	//one TLB flush for the whole range instead of an invlpg per page
+	tlb_batch_begin(ptr_page_directory);
 	for (uint32 v = virtual_address; v < Range; v += PAGE_SIZE) {
 
 		env_page_ws_invalidate(e, v);
@@ -215,6 +317,7 @@ void free_user_mem(struct Env* e, uint32 virtual_address, uint32 size)
 
 		pf_remove_env_page(e, v);
 	}
+	tlb_batch_end();
 
 	//Comment the following line
     //panic("free_user_mem() is not implemented yet...!!");
@@ -233,9 +336,145 @@ void __free_user_mem_with_buffering(struct Env* e, uint32 virtual_address, uint3
 //=====================================
 // 3) MOVE USER MEMORY:
 //=====================================
+//Move the pages of [src, src + size) to [dst, dst + size) without copying them: the page
+//table entries (incl. the marks of the not yet accessed pages), the page file slots and the
+//WS elements follow the pages. The ranges DO NOT overlap & the destination should be free.
 void move_user_mem(struct Env* e, uint32 src_virtual_address, uint32 dst_virtual_address, uint32 size)
 {
-	panic("move_user_mem() is not implemented yet...!!");
+	uint32 num_of_pages = ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE;
+
+	if (cut_paste_pages(e->env_page_directory, src_virtual_address, dst_virtual_address, num_of_pages) < 0)
+	{
+		cprintf("\nmove_user_mem(): DESTINATION IS IN USE! Process will be terminated...\n");
+		env_exit();
+	}
+	for (uint32 i = 0; i < num_of_pages; ++i)
+	{
+		pf_move_env_page(e, src_virtual_address + i * PAGE_SIZE, dst_virtual_address + i * PAGE_SIZE);
+	}
+	env_page_ws_move(e, src_virtual_address, dst_virtual_address, num_of_pages * PAGE_SIZE);
+}
+
+//=====================================
+// 5) SHARE USER SPACE COPY-ON-WRITE:
+//=====================================
+#if USE_KHEAP
+//Append a copy of each element of src to dst & return the copy of "mark" (if any)
+static struct WorkingSetElement* copy_ws_list(struct Env* dst_env, struct WS_List* dst, struct WS_List* src, struct WorkingSetElement* mark)
+{
+	struct WorkingSetElement *wse, *copy, *mark_copy = NULL;
+	LIST_FOREACH(wse, src)
+	{
+		copy = env_page_ws_list_create_element(dst_env, wse->virtual_address);
+		copy->time_stamp = wse->time_stamp;
+		copy->sweeps_counter = wse->sweeps_counter;
+		LIST_INSERT_TAIL(dst, copy);
+		if (wse == mark)
+			mark_copy = copy;
+	}
+	return mark_copy;
+}
+#endif
+
+//Share the whole user space of src_env with dst_env [see env_fork()]:
+//	every page that has a frame is shared by both envs (its references is incremented) &
+//	the writable ones are made read-only & marked PERM_COW in both of them, so the first
+//	write by any of them gets a private copy [see cow_fault_handler()].
+//	The pages of the shared objects stay shared as they are.
+//	The marks of the not yet accessed pages & the WS are copied as they are.
+//	dst_env should have an empty user space.
+//	Return E_NO_MEM if there's no memory for the reverse mappings of dst_env: the pages shared
+//	so far should be given back by unshare_user_space().
+int cow_share_user_space(struct Env* src_env, struct Env* dst_env)
+{
+	uint32 *src_dir = src_env->env_page_directory;
+	uint32 *dst_dir = dst_env->env_page_directory;
+	uint32 *ptr_src_table, *ptr_dst_table;
+
+	for (uint32 pdx = 0; pdx < PDX(USER_TOP); ++pdx)
+	{
+		if ((src_dir[pdx] & PERM_PRESENT) == 0)
+			continue;
+		uint32 va = pdx << PDXSHIFT;
+		get_page_table(src_dir, va, &ptr_src_table);
+		get_page_table(dst_dir, va, &ptr_dst_table);
+		if (ptr_dst_table == NULL)
+			ptr_dst_table = create_page_table(dst_dir, va);
+
+		for (uint32 ptx = 0; ptx < NPTENTRIES; ++ptx)
+		{
+			uint32 entry = ptr_src_table[ptx];
+			if (EXTRACT_ADDRESS(entry) != 0)
+			{
+				struct FrameInfo *ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(entry));
+				if ((entry & PERM_PRESENT) && rmap_add(ptr_frame_info, dst_dir, va + (ptx << PTXSHIFT)) != 0)
+				{
+					tlbflush();
+					return E_NO_MEM;
+				}
+				if ((entry & PERM_PRESENT) && (entry & (PERM_WRITEABLE | PERM_COW)) && !ptr_frame_info->isShared)
+				{
+					entry = (entry & ~PERM_WRITEABLE) | PERM_COW;
+					ptr_src_table[ptx] = entry;
+				}
+				ptr_frame_info->references++;
+			}
+			ptr_dst_table[ptx] = entry;
+		}
+	}
+	//the src_env may be the running one: drop its writable TLB entries
+	tlbflush();
+
+#if USE_KHEAP
+	dst_env->page_last_WS_element = copy_ws_list(dst_env, &(dst_env->page_WS_list), &(src_env->page_WS_list), src_env->page_last_WS_element);
+	copy_ws_list(dst_env, &(dst_env->ActiveList), &(src_env->ActiveList), NULL);
+	copy_ws_list(dst_env, &(dst_env->SecondList), &(src_env->SecondList), NULL);
+#endif
+	return 0;
+}
+
+//Undo cow_share_user_space() for an env that won't run [see env_fork()]: give back its
+//references on the frames, its reverse mappings, its page tables & its WS elements.
+//The pages stay marked PERM_COW in the other env(s): their next write just takes them back.
+void unshare_user_space(struct Env* e)
+{
+	uint32 *dir = e->env_page_directory;
+	uint32 *ptr_table;
+
+	for (uint32 pdx = 0; pdx < PDX(USER_TOP); ++pdx)
+	{
+		if ((dir[pdx] & PERM_PRESENT) == 0)
+			continue;
+		uint32 va = pdx << PDXSHIFT;
+		get_page_table(dir, va, &ptr_table);
+		for (uint32 ptx = 0; ptx < NPTENTRIES; ++ptx)
+		{
+			uint32 entry = ptr_table[ptx];
+			if (EXTRACT_ADDRESS(entry) != 0)
+			{
+				struct FrameInfo *ptr_frame_info = to_frame_info(EXTRACT_ADDRESS(entry));
+				if (entry & PERM_PRESENT)
+					rmap_remove(ptr_frame_info, dir, va + (ptx << PTXSHIFT));
+				decrement_references(ptr_frame_info);
+			}
+		}
+		dir[pdx] = 0;
+		kfree(ptr_table);
+	}
+
+#if USE_KHEAP
+	struct WS_List* ws_lists[3] = {&(e->page_WS_list), &(e->ActiveList), &(e->SecondList)};
+	for (int i = 0; i < 3; ++i)
+	{
+		struct WorkingSetElement *wse;
+		while ((wse = LIST_FIRST(ws_lists[i])) != NULL)
+		{
+			LIST_REMOVE(ws_lists[i], wse);
+			env_page_ws_list_free_element(e, wse);
+		}
+	}
+	e->page_last_WS_element = NULL;
+#endif
 }
 
 //=================================================================================//
@@ -27,9 +27,12 @@ uint32 calculate_required_frames(uint32* page_directory, uint32 sva, uint32 size
 /*[2] USER CHUNKS MANIPULATION */
 /*******************************/
 void* sys_sbrk(int numOfPages);
+bool overlaps_user_break(struct Env* e, uint32 virtual_address, uint32 size);
 void free_user_mem(struct Env* e, uint32 virtual_address, uint32 size);
 void allocate_user_mem(struct Env* e, uint32 virtual_address, uint32 size);
 void move_user_mem(struct Env* e, uint32 src_virtual_address, uint32 dst_virtual_address, uint32 size);
 void __free_user_mem_with_buffering(struct Env* e, uint32 virtual_address, uint32 size);
+int cow_share_user_space(struct Env* src_env, struct Env* dst_env);
+void unshare_user_space(struct Env* e);
 
 #endif /* KERN_MEM_CHUNK_OPERATIONS_H_ */
@@ -4,6 +4,8 @@
 #include <kern/conc/sleeplock.h>
 #include <kern/proc/user_environment.h>
 #include <kern/mem/memory_manager.h>
+#include <kern/cpu/cpu.h>
+#include <kern/cpu/sched.h>
 #include "../conc/kspinlock.h"
 #include <inc/queue.h>
 #include <inc/environment_definitions.h>
@@ -37,14 +39,20 @@ struct SegmentInfoElement_List segments_list;
 LIST_HEAD(SegmentfreeElement_List, Segment);
 struct SegmentfreeElement_List free_segments_list;
 
-struct empty_linked_list elist;
-struct empty_linked_list alist;
-
 LIST_HEAD(empty_linked_list, Segment);
 
-struct Segment Segments_array[1000000];
+//Segment descriptors are carved from slabs of one max-size block of the dynamic
+//allocator. Free descriptors of all slabs are kept in seg_free_descriptors and a
+//slab is given back once all of its descriptors are free, so the memory used by
+//the descriptors follows the number of live segments.
+#define SEGMENTS_PER_SLAB	((DYN_ALLOC_MAX_BLOCK_SIZE - sizeof(uint32)) / sizeof(struct Segment))
+struct SegmentSlab {
+	struct Segment segments[SEGMENTS_PER_SLAB];
+	uint32 num_of_used;
+};
 
-uint32 counter = 0;
+struct empty_linked_list seg_free_descriptors;
+uint32 num_of_segment_slabs = 0;
 
 struct kspinlock lk;
 
@@ -52,13 +60,464 @@ struct kspinlock lk;
 //el array de mtnf3sh feh araay built in esmha frames_info[] ast5dmha 3ltool bdl de
 struct FrameInfo* reverse_hashmap[2^32] ;
 
+//==============================================
+// PAGE ALLOCATOR INDEX:
+//==============================================
+//Free segments are kept in size-segregated bins: bins [1..KHEAP_EXACT_BINS-1] hold
+//segments of exactly that number of pages, the rest hold power-of-2 ranges
+//[2^k, 2^(k+1)). A bitmap of the non-empty bins gives the first/largest usable
+//bin in O(1).
+//Each bin is indexed by address (a page map of the first pages of its segments) for
+//the first/next fit, and the free segments are also listed by their exact size with
+//a page map of the non-empty sizes for the exact/best/worst fit.
+//Every segment (free or used) is also tagged at its first & last page in
+//kheap_seg_tags[] so that kfree() finds its segment and both of its neighbors
+//in O(1) instead of walking the lists.
+#define KHEAP_EXACT_BINS	16
+#define KHEAP_NUM_BINS		32
+#define KHEAP_NUM_PAGES		((KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE)
+
+//Two-level bitmap of KHEAP_NUM_PAGES bits: a bit of summary[] is set if the
+//corresponding word of words[] is not zero, so a set bit is found in at most
+//KHEAP_MAP_SUMMARY_WORDS steps
+#define KHEAP_MAP_WORDS			((KHEAP_NUM_PAGES + 31) / 32)
+#define KHEAP_MAP_SUMMARY_WORDS	((KHEAP_MAP_WORDS + 31) / 32)
+struct KHeapPageMap {
+	uint32 summary[KHEAP_MAP_SUMMARY_WORDS];
+	uint32 words[KHEAP_MAP_WORDS];
+};
+
+uint32 kheap_bins_bitmap = 0;
+uint32 kheap_bin_counts[KHEAP_NUM_BINS];
+struct KHeapPageMap kheap_bin_maps[KHEAP_NUM_BINS];	//first page index of the free segments of each bin
+struct KHeapPageMap kheap_size_map;						//sizes that have a free segment
+struct Segment* kheap_size_lists[KHEAP_NUM_PAGES];		//free segments of each size
+struct Segment* kheap_seg_tags[KHEAP_NUM_PAGES];
+uint32 kheap_next_fit_va = 0;
+
+//Counters of the page allocator & of the kmalloc/kfree calls, kept up to date
+//under the kheap lock [see get_kheap_stats()]
+struct
+{
+	uint32 num_of_used_pages, num_of_used_segments;
+	uint32 num_of_free_pages, num_of_free_segments;
+	uint32 num_of_kmallocs, num_of_kfrees, num_of_failed_kmallocs;
+} kheap_counters;
+
+static inline uint32 kheap_page_index(uint32 va)
+{
+	return (va - KERNEL_HEAP_START) >> PGSHIFT;
+}
+
+static inline uint32 segment_end(struct Segment* seg)
+{
+	return seg->base_address + seg->size_in_number_of_pages * PAGE_SIZE;
+}
+
+static inline uint32 kheap_bin_of(uint32 num_of_pages)
+{
+	if (num_of_pages < KHEAP_EXACT_BINS)
+		return num_of_pages;
+	//log2(num_of_pages) >= 4 here
+	return KHEAP_EXACT_BINS + (31 - __builtin_clz(num_of_pages)) - 4;
+}
+
+static inline void set_segment_tags(struct Segment* seg)
+{
+	kheap_seg_tags[kheap_page_index(seg->base_address)] = seg;
+	kheap_seg_tags[kheap_page_index(segment_end(seg) - PAGE_SIZE)] = seg;
+}
+
+//Only the first & last pages of the live segments are tagged: tags are cleared
+//before a segment is resized, merged or released (its descriptor may be reused)
+static inline void clear_segment_tags(struct Segment* seg)
+{
+	kheap_seg_tags[kheap_page_index(seg->base_address)] = NULL;
+	kheap_seg_tags[kheap_page_index(segment_end(seg) - PAGE_SIZE)] = NULL;
+}
+
+static inline struct Segment* segment_starting_at(uint32 va)
+{
+	if (va < kheapPageAllocStart || va >= kheapPageAllocBreak)
+		return NULL;
+	struct Segment* seg = kheap_seg_tags[kheap_page_index(va)];
+	if (seg == NULL || seg->size_in_number_of_pages == 0 || seg->base_address != va)
+		return NULL;
+	return seg;
+}
+
+static inline struct Segment* segment_ending_at(uint32 va)
+{
+	if (va <= kheapPageAllocStart || va > kheapPageAllocBreak)
+		return NULL;
+	struct Segment* seg = kheap_seg_tags[kheap_page_index(va - PAGE_SIZE)];
+	if (seg == NULL || seg->size_in_number_of_pages == 0 || segment_end(seg) != va)
+		return NULL;
+	return seg;
+}
+
+//The slab of a descriptor is found from its index inside the slab
+static inline struct SegmentSlab* slab_of(struct Segment* seg)
+{
+	return (struct SegmentSlab*)(seg - seg->index);
+}
+
+static struct Segment* new_segment(uint32 base_address, uint32 num_of_pages)
+{
+	if (LIST_SIZE(&seg_free_descriptors) == 0)
+	{
+		struct SegmentSlab *slab = alloc_block(DYN_ALLOC_MAX_BLOCK_SIZE);
+		if (slab == NULL)
+			panic("new_segment() in kern: no memory for the segment descriptors");
+		slab->num_of_used = 0;
+		for (uint32 i = 0; i < SEGMENTS_PER_SLAB; ++i)
+		{
+			slab->segments[i].index = i;
+			slab->segments[i].size_in_number_of_pages = 0;
+			LIST_INSERT_TAIL(&seg_free_descriptors, &slab->segments[i]);
+		}
+		num_of_segment_slabs++;
+	}
+	struct Segment *seg = LIST_FIRST(&seg_free_descriptors);
+	LIST_REMOVE(&seg_free_descriptors, seg);
+	slab_of(seg)->num_of_used++;
+
+	seg->base_address = base_address;
+	seg->size_in_number_of_pages = num_of_pages;
+	seg->is_used = 1;
+	return seg;
+}
+
+static void release_segment(struct Segment* seg)
+{
+	seg->is_used = 0;
+	seg->base_address = 0;
+	seg->size_in_number_of_pages = 0;
+	LIST_INSERT_TAIL(&seg_free_descriptors, seg);
+
+	struct SegmentSlab *slab = slab_of(seg);
+	if (--slab->num_of_used == 0)
+	{
+		for (uint32 i = 0; i < SEGMENTS_PER_SLAB; ++i)
+			LIST_REMOVE(&seg_free_descriptors, &slab->segments[i]);
+		free_block(slab);
+		num_of_segment_slabs--;
+	}
+}
+
+static inline void page_map_set(struct KHeapPageMap* map, uint32 i)
+{
+	map->words[i / 32] |= 1 << (i % 32);
+	map->summary[i / 1024] |= 1 << ((i / 32) % 32);
+}
+
+static inline void page_map_clear(struct KHeapPageMap* map, uint32 i)
+{
+	map->words[i / 32] &= ~(1 << (i % 32));
+	if (map->words[i / 32] == 0)
+		map->summary[i / 1024] &= ~(1 << ((i / 32) % 32));
+}
+
+//Smallest set bit >= from (-1 if none)
+static int page_map_next(struct KHeapPageMap* map, uint32 from)
+{
+	uint32 w = from / 32;
+	if (w >= KHEAP_MAP_WORDS)
+		return -1;
+	uint32 bits = map->words[w] & (~0U << (from % 32));
+	if (bits)
+		return w * 32 + __builtin_ctz(bits);
+	//the next non-empty word after w from the summary
+	w++;
+	for (uint32 s = w / 32; s < KHEAP_MAP_SUMMARY_WORDS; ++s)
+	{
+		uint32 summary = map->summary[s];
+		if (s == w / 32)
+			summary &= ~0U << (w % 32);
+		if (summary)
+		{
+			w = s * 32 + __builtin_ctz(summary);
+			return w * 32 + __builtin_ctz(map->words[w]);
+		}
+	}
+	return -1;
+}
+
+//Largest set bit (-1 if none)
+static int page_map_last(struct KHeapPageMap* map)
+{
+	for (int s = KHEAP_MAP_SUMMARY_WORDS - 1; s >= 0; --s)
+	{
+		if (map->summary[s])
+		{
+			uint32 w = s * 32 + 31 - __builtin_clz(map->summary[s]);
+			return w * 32 + 31 - __builtin_clz(map->words[w]);
+		}
+	}
+	return -1;
+}
+
+//The size lists are linked through prev_next_info (a free segment is in no other list).
+//The le_prev of the head is the tail, so that the segments of a size are taken in
+//the order they were freed.
+static void insert_free_segment(struct Segment* seg)
+{
+	uint32 size = seg->size_in_number_of_pages;
+	uint32 bin = kheap_bin_of(size);
+	seg->is_used = 0;
+	page_map_set(&kheap_bin_maps[bin], kheap_page_index(seg->base_address));
+	kheap_bin_counts[bin]++;
+	kheap_bins_bitmap |= (1 << bin);
+
+	struct Segment *head = kheap_size_lists[size];
+	seg->prev_next_info.le_next = NULL;
+	if (head == NULL)
+	{
+		seg->prev_next_info.le_prev = seg;
+		kheap_size_lists[size] = seg;
+	}
+	else
+	{
+		seg->prev_next_info.le_prev = head->prev_next_info.le_prev;
+		head->prev_next_info.le_prev->prev_next_info.le_next = seg;
+		head->prev_next_info.le_prev = seg;
+	}
+	page_map_set(&kheap_size_map, size);
+
+	set_segment_tags(seg);
+	kheap_counters.num_of_free_pages += size;
+	kheap_counters.num_of_free_segments++;
+}
+
+static void remove_free_segment(struct Segment* seg)
+{
+	uint32 size = seg->size_in_number_of_pages;
+	uint32 bin = kheap_bin_of(size);
+	page_map_clear(&kheap_bin_maps[bin], kheap_page_index(seg->base_address));
+	if (--kheap_bin_counts[bin] == 0)
+		kheap_bins_bitmap &= ~(1 << bin);
+
+	struct Segment *head = kheap_size_lists[size];
+	struct Segment *prev = seg->prev_next_info.le_prev, *next = seg->prev_next_info.le_next;
+	if (seg == head)
+		kheap_size_lists[size] = next;
+	else
+		prev->prev_next_info.le_next = next;
+	if (next != NULL)
+		next->prev_next_info.le_prev = prev;
+	else if (seg != head)
+		head->prev_next_info.le_prev = prev;
+	if (kheap_size_lists[size] == NULL)
+		page_map_clear(&kheap_size_map, size);
+
+	clear_segment_tags(seg);
+	kheap_counters.num_of_free_pages -= size;
+	kheap_counters.num_of_free_segments--;
+}
+
+//Return the bitmap of the non-empty bins that MAY contain a segment of num_of_pages
+static inline uint32 candidate_bins(uint32 num_of_pages)
+{
+	return kheap_bins_bitmap & ~((1 << kheap_bin_of(num_of_pages)) - 1);
+}
+
+//Lowest-addressed free segment >= num_of_pages with base >= min_va (NULL if none).
+//Each candidate bin gives its lowest segment from its address map. All segments of
+//the bins above the bin of num_of_pages fit; in that bin itself (if it's a range),
+//the smaller segments are skipped in address order.
+static struct Segment* lowest_fit(uint32 num_of_pages, uint32 min_va)
+{
+	struct Segment *seg, *found = NULL;
+	uint32 from = min_va > KERNEL_HEAP_START ? kheap_page_index(min_va) : 0;
+	uint32 bins = candidate_bins(num_of_pages);
+	while (bins)
+	{
+		uint32 bin = __builtin_ctz(bins);
+		bins &= bins - 1;
+		int i = page_map_next(&kheap_bin_maps[bin], from);
+		while (i >= 0)
+		{
+			seg = kheap_seg_tags[i];
+			if (found != NULL && seg->base_address > found->base_address)
+				break;
+			if (seg->size_in_number_of_pages >= num_of_pages)
+			{
+				found = seg;
+				break;
+			}
+			i = page_map_next(&kheap_bin_maps[bin], i + 1);
+		}
+	}
+	return found;
+}
+
+//Smallest free segment >= num_of_pages: the next non-empty size
+static struct Segment* best_fit(uint32 num_of_pages)
+{
+	int size = page_map_next(&kheap_size_map, num_of_pages);
+	return size < 0 ? NULL : kheap_size_lists[size];
+}
+
+//Largest free segment if it fits
+static struct Segment* worst_fit(uint32 num_of_pages)
+{
+	int size = page_map_last(&kheap_size_map);
+	return size < (int)num_of_pages ? NULL : kheap_size_lists[size];
+}
+
+static struct Segment* exact_fit(uint32 num_of_pages)
+{
+	return num_of_pages < KHEAP_NUM_PAGES ? kheap_size_lists[num_of_pages] : NULL;
+}
+
+//Select a free segment for num_of_pages according to the current placement strategy
+static struct Segment* find_free_segment(uint32 num_of_pages)
+{
+	struct Segment* seg = NULL;
+	switch (get_kheap_strategy())
+	{
+	case KHP_PLACE_CONTALLOC:
+		//always allocate at the break
+		return NULL;
+	case KHP_PLACE_FIRSTFIT:
+		return lowest_fit(num_of_pages, 0);
+	case KHP_PLACE_NEXTFIT:
+		seg = lowest_fit(num_of_pages, kheap_next_fit_va);
+		if (seg == NULL)
+			seg = lowest_fit(num_of_pages, 0);
+		return seg;
+	case KHP_PLACE_BESTFIT:
+		return best_fit(num_of_pages);
+	case KHP_PLACE_WORSTFIT:
+		return worst_fit(num_of_pages);
+	default:
+		//CUSTOM FIT: exact fit, else worst fit
+		seg = exact_fit(num_of_pages);
+		if (seg == NULL)
+			seg = worst_fit(num_of_pages);
+		return seg;
+	}
+}
+
+
+static inline void acquire_kheap_lock()
+{
+	acquire_kspinlock(&lk);
+	kheapNumOfLockAcquires++;
+}
+
+//==============================================
+// PER-CPU BLOCK MAGAZINES:
+//==============================================
+//Each CPU keeps a small stack (magazine) of free blocks per block size. kmalloc/kfree
+//of small sizes are served from it with interrupts disabled only, and the kheap lock
+//is taken once per KHEAP_MAGAZINE_BATCH blocks to refill it from / flush it to the
+//free block lists of the dynamic allocator.
+#define KHEAP_MAGAZINE_SIZE		16
+#define KHEAP_MAGAZINE_BATCH	(KHEAP_MAGAZINE_SIZE / 2)
+
+struct BlockMagazine {
+	uint32 count;
+	void* blocks[KHEAP_MAGAZINE_SIZE];
+};
+struct BlockMagazine kheap_magazines[NCPUS][DYN_ALLOC_NUM_OF_SIZES];
+
+static inline struct BlockMagazine* my_magazine(uint32 size_idx)
+{
+	return &kheap_magazines[mycpu() - CPUS][size_idx];
+}
+
+static void* magazine_alloc(uint32 size)
+{
+	uint32 block_size = get_size_class(size);
+	uint32 size_idx = get_block_list_idx(block_size);
+
+	pushcli();
+	struct BlockMagazine *mag = my_magazine(size_idx);
+	if (mag->count == 0)
+	{
+		//refill: the 1st block may need a new page (or a larger size), the others are
+		//taken only if they're already free in this size. They're stacked in reverse to
+		//be handed out in the same order as the dynamic allocator gives them.
+		//If the 1st block can't be allocated, the magazine is left empty & NULL is returned.
+		void* batch[KHEAP_MAGAZINE_BATCH];
+		uint32 n = 0;
+		acquire_kheap_lock();
+		batch[n++] = alloc_block(block_size);
+		if (batch[0] == NULL)
+		{
+			kheap_counters.num_of_failed_kmallocs++;
+			release_kspinlock(&lk);
+			popcli();
+			return NULL;
+		}
+		while (n < KHEAP_MAGAZINE_BATCH && LIST_SIZE(&freeBlockLists[size_idx]) > 0)
+			batch[n++] = alloc_block(block_size);
+		release_kspinlock(&lk);
+		for (uint32 i = 0; i < n; ++i)
+			mag->blocks[n - 1 - i] = batch[i];
+		mag->count = n;
+	}
+	void* va = mag->blocks[--mag->count];
+	kheap_counters.num_of_kmallocs++;
+	popcli();
+	return va;
+}
+
+static void magazine_free(void* va)
+{
+	uint32 size_idx = get_block_list_idx(get_block_size(va));
+
+	pushcli();
+	struct BlockMagazine *mag = my_magazine(size_idx);
+	if (mag->count == KHEAP_MAGAZINE_SIZE)
+	{
+		//flush the older half back to the dynamic allocator
+		acquire_kheap_lock();
+		for (uint32 i = 0; i < KHEAP_MAGAZINE_BATCH; ++i)
+			free_block(mag->blocks[i]);
+		release_kspinlock(&lk);
+		for (uint32 i = KHEAP_MAGAZINE_BATCH; i < KHEAP_MAGAZINE_SIZE; ++i)
+			mag->blocks[i - KHEAP_MAGAZINE_BATCH] = mag->blocks[i];
+		mag->count -= KHEAP_MAGAZINE_BATCH;
+	}
+	mag->blocks[mag->count++] = va;
+	kheap_counters.num_of_kfrees++;
+	popcli();
+}
+
+void set_kheap_magazines(uint32 enable)
+{
+	pushcli();
+	kheapMagazinesEnabled = enable;
+	if (!enable)
+	{
+		acquire_kheap_lock();
+		for (int c = 0; c < NCPUS; ++c)
+		{
+			for (int i = 0; i < DYN_ALLOC_NUM_OF_SIZES; ++i)
+			{
+				struct BlockMagazine *mag = &kheap_magazines[c][i];
+				while (mag->count > 0)
+					free_block(mag->blocks[--mag->count]);
+			}
+		}
+		release_kspinlock(&lk);
+	}
+	popcli();
+}
 
 void kheap_init()
 {
 
 	init_kspinlock(&lk, "kname");
-	LIST_INIT(&elist);
-	LIST_INIT(&alist);
+	memset(kheap_bin_counts, 0, sizeof(kheap_bin_counts));
+	memset(kheap_bin_maps, 0, sizeof(kheap_bin_maps));
+	memset(&kheap_size_map, 0, sizeof(kheap_size_map));
+	memset(kheap_size_lists, 0, sizeof(kheap_size_lists));
+	kheap_bins_bitmap = 0;
+	LIST_INIT(&seg_free_descriptors);
+	set_dyn_alloc_size_classes(KHEAP_SIZE_CLASSES);
 
 	//==================================================================================
 	// DON'T CHANGE THESE LINES==========================================================
@@ -71,6 +530,9 @@ void kheap_init()
 	}
 	//==================================================================================
 	//==================================================================================
+	memset(&kheap_counters, 0, sizeof(kheap_counters));
+	kheapMagazinesEnabled = 1;
+	kheapLargePagesEnabled = 1;
 }
 
 
@@ -79,7 +541,7 @@ void kheap_init()
 //==============================================
 int get_page(void* va)
 {
-	int ret = alloc_page(ptr_page_directory, ROUNDDOWN((uint32)va, PAGE_SIZE), PERM_WRITEABLE, 1);
+	int ret = alloc_page(ptr_page_directory, ROUNDDOWN((uint32)va, PAGE_SIZE), PERM_WRITEABLE | KERNEL_GLOBAL_PERM, 1);
 	// RAGHEB CODE //
 	//handling the physical address frame
 //	uint32 pa = kheap_physical_address((uint32) va);
@@ -133,6 +595,124 @@ static inline uint32 calculate_number_of_pages(uint32 size)
 //}
 
 uint32 max_free_index = 0;
+
+//Map new frames at [va, va + num_of_pages * PAGE_SIZE). Each 4 MB aligned part of the range
+//is mapped by a single 4 MB page if enabled & there're enough contiguous free frames for it.
+//The rest is mapped by 4 KB pages, one map_range() per 4 MB.
+static void map_pages(uint32 va, uint32 num_of_pages)
+{
+	uint32 end = va + num_of_pages * PAGE_SIZE;
+	while (va < end)
+	{
+		struct FrameInfo *ptr_first_frame_info;
+		if (kheapLargePagesEnabled && pse_enabled && va % PTSIZE == 0 && end - va >= PTSIZE &&
+				allocate_contiguous_frames(NPTENTRIES, NPTENTRIES, &ptr_first_frame_info) == 0)
+		{
+			map_kernel_large_page(ptr_first_frame_info, va, PERM_WRITEABLE | KERNEL_GLOBAL_PERM);
+			va += PTSIZE;
+		}
+		else
+		{
+			uint32 run_end = MIN(ROUNDDOWN(va, PTSIZE) + PTSIZE, end);
+			if (map_range(ptr_page_directory, va, (run_end - va) / PAGE_SIZE, PERM_WRITEABLE | KERNEL_GLOBAL_PERM, 1) != 0)
+				panic("kmalloc: failed to allocate frames for the kernel heap");
+			va = run_end;
+		}
+	}
+}
+
+//The pages of the range are handled one by one, so break any 4 MB page of it first
+static void split_large_pages(uint32 va, uint32 num_of_pages)
+{
+	for (uint32 pt_va = ROUNDDOWN(va, PTSIZE); pt_va < va + num_of_pages * PAGE_SIZE; pt_va += PTSIZE)
+		split_kernel_large_page(pt_va);
+}
+
+static void unmap_pages(uint32 va, uint32 num_of_pages)
+{
+	split_large_pages(va, num_of_pages);
+	for (uint32 i = 0; i < num_of_pages; ++i)
+		return_page((void*)(va + i * PAGE_SIZE));
+}
+
+//Move the frames mapped at [src_va, src_va + num_of_pages * PAGE_SIZE) to dst_va (no copy)
+static void remap_pages(uint32 src_va, uint32 dst_va, uint32 num_of_pages)
+{
+	uint32 *ptr_page_table = NULL;
+	split_large_pages(src_va, num_of_pages);
+	for (uint32 i = 0; i < num_of_pages; ++i)
+	{
+		struct FrameInfo *ptr_frame_info = get_frame_info(ptr_page_directory, src_va + i * PAGE_SIZE, &ptr_page_table);
+		map_frame(ptr_page_directory, ptr_frame_info, dst_va + i * PAGE_SIZE, PERM_WRITEABLE | KERNEL_GLOBAL_PERM);
+		unmap_frame(ptr_page_directory, src_va + i * PAGE_SIZE);
+	}
+}
+
+//Reserve (without mapping) num_pages from a free hole or from the break. NULL if no space.
+static struct Segment* reserve_segment(uint32 num_pages)
+{
+	struct Segment *seg = find_free_segment(num_pages);
+	if (seg != NULL)
+	{
+		/* allocate from the beginning of the hole and keep the rest (if any) free */
+		remove_free_segment(seg);
+		if (seg->size_in_number_of_pages > num_pages)
+		{
+			struct Segment *rest = new_segment(seg->base_address + num_pages * PAGE_SIZE,
+					seg->size_in_number_of_pages - num_pages);
+			insert_free_segment(rest);
+			seg->size_in_number_of_pages = num_pages;
+		}
+		seg->is_used = 1;
+	}
+	else
+	{
+		/* no suitable free hole, expand the heap (kheapPageAllocBreak) */
+		if (num_pages > (KERNEL_HEAP_MAX - kheapPageAllocBreak) / PAGE_SIZE)
+			return NULL;
+		seg = new_segment(kheapPageAllocBreak, num_pages);
+		kheapPageAllocBreak += num_pages * PAGE_SIZE;
+	}
+	set_segment_tags(seg);
+	kheap_next_fit_va = segment_end(seg);
+	kheap_counters.num_of_used_pages += num_pages;
+	kheap_counters.num_of_used_segments++;
+	return seg;
+}
+
+//Give back the space of an allocated segment whose pages are already unmapped:
+//merge it with its free neighbors, or shrink the break if it reaches it
+static void unreserve_segment(struct Segment *target)
+{
+    target->is_used = 0;
+    clear_segment_tags(target);
+    kheap_counters.num_of_used_pages -= target->size_in_number_of_pages;
+    kheap_counters.num_of_used_segments--;
+
+    /* merge with the free neighbors (if any) */
+    struct Segment *left = segment_ending_at(target->base_address);
+    if (left != NULL && !left->is_used) {
+        remove_free_segment(left);
+        left->size_in_number_of_pages += target->size_in_number_of_pages;
+        release_segment(target);
+        target = left;
+    }
+    struct Segment *right = segment_starting_at(segment_end(target));
+    if (right != NULL && !right->is_used) {
+        remove_free_segment(right);
+        target->size_in_number_of_pages += right->size_in_number_of_pages;
+        release_segment(right);
+    }
+
+    /* If the freed hole reaches the top of the heap, shrink the break instead of keeping it
+       (all the holes below it are already merged into it) */
+    if (segment_end(target) == kheapPageAllocBreak) {
+        kheapPageAllocBreak = target->base_address;
+        release_segment(target);
+    } else {
+        insert_free_segment(target);
+    }
+}
 //==================================================================================//
 //============================ REQUIRED FUNCTIONS ==================================//
 //==================================================================================//
@@ -141,187 +721,70 @@ uint32 max_free_index = 0;
 //===================================
 void *kmalloc(unsigned int size)
 {
-	acquire_kspinlock(&lk);
-
 	if (size == 0)
-	{
-		release_kspinlock(&lk);
 		return NULL;
-	}
 
 	// Use dynamic allocator for small sizes
 	if (size <= DYN_ALLOC_MAX_BLOCK_SIZE)
 	{
+		if (kheapMagazinesEnabled)
+			return magazine_alloc(size);
+		acquire_kheap_lock();
 		uint32 *al = alloc_block(size);
+		if (al == NULL)
+			kheap_counters.num_of_failed_kmallocs++;
+		else
+			kheap_counters.num_of_kmallocs++;
 		release_kspinlock(&lk);
 		return al;
 	}
 
+	acquire_kheap_lock();
+
 	uint32 num_pages = calculate_number_of_pages(size);
 
-	// Quick OOM check
-	if (kheapPageAllocBreak == KERNEL_HEAP_MAX)
+	struct Segment *seg = reserve_segment(num_pages);
+	if (seg == NULL)
 	{
+		kheap_counters.num_of_failed_kmallocs++;
 		release_kspinlock(&lk);
 		return NULL;
 	}
+	map_pages(seg->base_address, num_pages);
+	kheap_counters.num_of_kmallocs++;
 
-    /* 1) Try exact fit in free list (elist) */
-    struct Segment *free_seg = LIST_FIRST(&elist);
-    for (; free_seg != 0; free_seg = LIST_NEXT(free_seg)) {
-        if (free_seg->size_in_number_of_pages == num_pages) {
-            uint32 alloc_base = free_seg->base_address;
-
-            /* allocate pages */
-            for (uint32 i = 0; i < num_pages; ++i)
-                get_page((void*)(alloc_base + i * PAGE_SIZE));
-
-            /* remove free segment from free list */
-            LIST_REMOVE(&elist, free_seg);
-
-            /* create allocated segment record from pool */
-            struct Segment *new_alloc = &Segments_array[counter];
-            new_alloc->base_address = alloc_base;
-            new_alloc->size_in_number_of_pages = num_pages;
-            new_alloc->is_used = 1;
-            new_alloc->index = counter;
-
-            LIST_INSERT_TAIL(&alist, new_alloc);
-            counter++;
-
-            release_kspinlock(&lk);
-            return (void*)alloc_base;
-        }
-    }
-
-    /* 2) Worst-fit: find largest free segment that can fit */
-    uint32 biggest = 0;
-    struct Segment *worst = NULL;
-    free_seg = LIST_FIRST(&elist);
-    for (; free_seg != 0; free_seg = LIST_NEXT(free_seg)) {
-        if (free_seg->size_in_number_of_pages >= num_pages
-            && free_seg->size_in_number_of_pages > biggest) {
-            biggest = free_seg->size_in_number_of_pages;
-            worst = free_seg;
-        }
-    }
-
-    if (worst != NULL) {
-        /* allocate from the beginning of worst (keep deterministic) */
-        uint32 alloc_base = worst->base_address;
-
-        /* allocate pages */
-        for (uint32 i = 0; i < num_pages; ++i)
-            get_page((void*)(alloc_base + i * PAGE_SIZE));
-
-        /* adjust the free segment in-place:
-           if exact match, remove it; otherwise move its base forward and shrink size */
-        if (worst->size_in_number_of_pages == num_pages) {
-            LIST_REMOVE(&elist, worst);
-        } else {
-            worst->base_address += num_pages * PAGE_SIZE;
-            worst->size_in_number_of_pages -= num_pages;
-        }
-
-        /* create allocated segment record */
-        struct Segment *new_alloc = &Segments_array[counter];
-        new_alloc->base_address = alloc_base;
-        new_alloc->size_in_number_of_pages = num_pages;
-        new_alloc->is_used = 1;
-        new_alloc->index = counter;
-
-        LIST_INSERT_TAIL(&alist, new_alloc);
-        counter++;
-
-        release_kspinlock(&lk);
-        return (void*)alloc_base;
-    }
-
-    /* 3) If no suitable free hole, expand the heap (kheapPageAllocBreak) */
-    /* check space */
-    uint32 holdkbead = kheapPageAllocBreak;
-
-        //check insufficient space
-        for(uint32 i = 0; i < num_pages; i++){
-        	if(holdkbead == KERNEL_HEAP_MAX){
-        		release_kspinlock(&lk);
-        		return NULL;
-        	}
-        	holdkbead += PAGE_SIZE;
-        }
-
-    uint32 alloc_base = kheapPageAllocBreak;
-    for (uint32 i = 0; i < num_pages; ++i) {
-        get_page((void*)(kheapPageAllocBreak));
-        kheapPageAllocBreak += PAGE_SIZE;
-    }
-
-    struct Segment *new_alloc = &Segments_array[counter];
-    new_alloc->base_address = alloc_base;
-    new_alloc->size_in_number_of_pages = num_pages;
-    new_alloc->is_used = 1;
-    new_alloc->index = counter;
-
-    LIST_INSERT_TAIL(&alist, new_alloc);
-    counter++;
-
-    release_kspinlock(&lk);
-    return (void*)alloc_base;
+	release_kspinlock(&lk);
+	return (void*)seg->base_address;
 }
 
 
-static void shrink_heap_if_possible(void)
-{
-    /* keep looping because removing one hole may reveal another that now touches the break */
-    struct Segment *f;
-    int changed = 1;
-    while (changed) {
-        changed = 0;
-        for (f = LIST_FIRST(&elist); f != NULL; f = LIST_NEXT(f)) {
-            uint32 f_end = f->base_address + f->size_in_number_of_pages * PAGE_SIZE;
-            if (f_end == kheapPageAllocBreak) {
-                /* shrink the break */
-                kheapPageAllocBreak -= f->size_in_number_of_pages * PAGE_SIZE;
-
-                /* remove this free hole from the free list and clear the entry */
-                LIST_REMOVE(&elist, f);
-                f->is_used = 0;
-                f->base_address = 0;
-                f->size_in_number_of_pages = 0;
-
-                /* we changed something; restart scan */
-                changed = 1;
-                break;
-            }
-        }
-    }
-}
-
-
-
-
 //=================================
 // [2] FREE SPACE FROM KERNEL HEAP:
 //=================================
 void kfree(void* virtual_address)
 {
     //TODO: [PROJECT'25.GM#2] KERNEL HEAP - #2 kfree
-    acquire_kspinlock(&lk);
-
     uint32 va = (uint32)virtual_address;
 
     if (virtual_address == NULL || (uint32)virtual_address == 0) {
-        release_kspinlock(&lk);
         return;
     }
 
     /* Dynamic allocator region? */
     if (va >= KERNEL_HEAP_START && va < (KERNEL_HEAP_START + DYN_ALLOC_MAX_SIZE)) {
+        if (kheapMagazinesEnabled) {
+            magazine_free(virtual_address);
+            return;
+        }
+        acquire_kheap_lock();
         free_block(virtual_address);
+        kheap_counters.num_of_kfrees++;
         release_kspinlock(&lk);
         return;
     }
 
+    acquire_kheap_lock();
+
 
     /* validity check */
     if (va < kheapPageAllocStart || va >= KERNEL_HEAP_MAX) {
@@ -330,136 +793,19 @@ void kfree(void* virtual_address)
         return;
     }
 
-    /* find the allocated segment in alist by base address */
-    struct Segment *seg;
-    struct Segment *target = NULL;
-
-    for (seg = LIST_FIRST(&alist); seg != NULL; seg = LIST_NEXT(seg)) {
-        if (seg->base_address == va) {
-            target = seg;
-            break;
-        }
-    }
-
-    if (target == NULL) {
+    /* find the allocated segment by its base address */
+    struct Segment *target = segment_starting_at(va);
+    if (target == NULL || !target->is_used) {
         release_kspinlock(&lk);
         kpanic_into_prompt("no address found");
         return;
     }
 
-    /* unmap pages */
-    uint32 free_base = target->base_address;
-    for (uint32 i = 0; i < target->size_in_number_of_pages; ++i) {
-        return_page((void*)(free_base + i * PAGE_SIZE));
-    }
-
-    /* If the freed block is at the top of the heap (just below kheapPageAllocBreak),
-       shrink the break instead of keeping it as a free hole */
-    uint32 block_end = target->base_address + target->size_in_number_of_pages * PAGE_SIZE;
-    if (block_end == kheapPageAllocBreak) {
-        /* remove target from allocated list */
-        LIST_REMOVE(&alist, target);
-
-        kheapPageAllocBreak -= target->size_in_number_of_pages * PAGE_SIZE;
-
-        /* mark target entry free */
-        target->is_used = 0;
-        target->size_in_number_of_pages = 0;
-        target->base_address = 0;
-
-        /* after shrinking the break, there still may be other free holes touching the break */
-        shrink_heap_if_possible();
-
-        release_kspinlock(&lk);
-        return;
-    }
-
-    /* Otherwise, prepare to insert/merge into elist (reuse target as freed node marker) */
-    target->is_used = 0;
-
-    /* find neighbors in elist by addresses */
-    struct Segment *left = NULL;
-    struct Segment *right = NULL;
-    struct Segment *f = LIST_FIRST(&elist);
-
-    for (; f != NULL; f = LIST_NEXT(f)) {
-        uint32 f_base = f->base_address;
-        uint32 f_end = f_base + f->size_in_number_of_pages * PAGE_SIZE;
-
-        if (f_end == target->base_address) {
-            left = f;
-        }
-        if (target->base_address + target->size_in_number_of_pages * PAGE_SIZE == f_base) {
-            right = f;
-        }
-        if (left && right) break;
-    }
-
-    /* Merge cases */
-    if (left && right) {
-        /* left + target + right -> merge into left */
-        left->size_in_number_of_pages = left->size_in_number_of_pages
-                                      + target->size_in_number_of_pages
-                                      + right->size_in_number_of_pages;
-
-        /* remove right from free list */
-        LIST_REMOVE(&elist, right);
-        right->is_used = 0;
-        right->base_address = 0;
-        right->size_in_number_of_pages = 0;
-
-        /* remove target from allocated list (its storage now represented by left) */
-        LIST_REMOVE(&alist, target);
-        target->is_used = 0;
-        target->base_address = 0;
-        target->size_in_number_of_pages = 0;
-
-        /* Now check whether left touches the break and shrink if needed */
-        shrink_heap_if_possible();
-
-        release_kspinlock(&lk);
-        return;
-    } else if (left) {
-        /* left + target -> extend left */
-        left->size_in_number_of_pages += target->size_in_number_of_pages;
-
-        LIST_REMOVE(&alist, target);
-        target->is_used = 0;
-        target->base_address = 0;
-        target->size_in_number_of_pages = 0;
-
-        /* left may now touch the break */
-        shrink_heap_if_possible();
-
-        release_kspinlock(&lk);
-        return;
-    } else if (right) {
-        /* target + right -> move right base down and expand it */
-        right->base_address = target->base_address;
-        right->size_in_number_of_pages += target->size_in_number_of_pages;
-
-        LIST_REMOVE(&alist, target);
-        target->is_used = 0;
-        target->base_address = 0;
-        target->size_in_number_of_pages = 0;
-
-        /* right (now shifted) may touch the break */
-        shrink_heap_if_possible();
-
-        release_kspinlock(&lk);
-        return;
-    } else {
-        /* no neighbors: move target from alist to elist */
-        LIST_REMOVE(&alist, target);
-        LIST_INSERT_TAIL(&elist, target);
+    unmap_pages(target->base_address, target->size_in_number_of_pages);
+    unreserve_segment(target);
+    kheap_counters.num_of_kfrees++;
 
-        /* new free hole might touch the break */
-        shrink_heap_if_possible();
-
-        release_kspinlock(&lk);
-        return;
-    }
-    //	panic("kfree() is not implemented yet...!!");
+    release_kspinlock(&lk);
 }
 
 
@@ -493,6 +839,11 @@ unsigned int kheap_physical_address(unsigned int virtual_address)
 	uint32* ptr_Page_Table = NULL;
 	uint32  phyAddress = 0;
 
+	//4 MB page [PSE]: the frame is in the directory entry itself
+	uint32 page_directory_entry = ptr_page_directory[PDX(virtual_address)];
+	if ((page_directory_entry & (PERM_PRESENT | PTE_PS)) == (PERM_PRESENT | PTE_PS))
+		return ROUNDDOWN(page_directory_entry, PTSIZE) + (virtual_address % PTSIZE);
+
 	//(get page table) btlf 3la kol row fe gadwl el directories tshof ae el address
 	//ele 2osad el PDX ll Virtual Address w t7oto fel ptrPageTable
 	uint32 checkPage = get_page_table(ptr_page_directory, virtual_address, &ptr_Page_Table);
@@ -522,6 +873,52 @@ unsigned int kheap_physical_address(unsigned int virtual_address)
 
 
 
+//=================================
+// [5] STATISTICS:
+//=================================
+//Largest free hole: the highest non-empty size
+static uint32 largest_free_segment()
+{
+	int size = page_map_last(&kheap_size_map);
+	return size < 0 ? 0 : size;
+}
+
+//Take a snapshot of the kernel heap counters
+void get_kheap_stats(struct KHeapStats* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	pushcli();	//to freeze the magazines of this CPU
+	acquire_kheap_lock();
+	{
+		for (int i = 0; i < DYN_ALLOC_NUM_OF_SIZES; ++i)
+		{
+			stats->block_size[i] = get_block_class_size(i);
+			stats->num_of_live_blocks[i] = dynAllocStats.num_of_live_blocks[i];
+			stats->num_of_free_blocks[i] = LIST_SIZE(&freeBlockLists[i]);
+			stats->num_of_pages[i] = dynAllocStats.num_of_pages[i];
+			for (int c = 0; c < NCPUS; ++c)
+				stats->num_of_cached_blocks[i] += kheap_magazines[c][i].count;
+		}
+		stats->num_of_free_block_pages = LIST_SIZE(&freePagesList);
+
+		stats->num_of_used_pages = kheap_counters.num_of_used_pages;
+		stats->num_of_used_segments = kheap_counters.num_of_used_segments;
+		stats->num_of_free_pages = kheap_counters.num_of_free_pages;
+		stats->num_of_free_segments = kheap_counters.num_of_free_segments;
+		stats->largest_free_segment = largest_free_segment();
+		stats->break_address = kheapPageAllocBreak;
+		stats->max_address = KERNEL_HEAP_MAX;
+
+		stats->num_of_kmallocs = kheap_counters.num_of_kmallocs;
+		stats->num_of_kfrees = kheap_counters.num_of_kfrees;
+		stats->num_of_failed_kmallocs = kheap_counters.num_of_failed_kmallocs;
+	}
+	release_kspinlock(&lk);
+	popcli();
+	stats->ticks = (uint32)timer_ticks();
+}
+
 //=================================================================================//
 //============================== BONUS FUNCTION ===================================//
 //=================================================================================//
@@ -537,10 +934,135 @@ unsigned int kheap_physical_address(unsigned int virtual_address)
 
 extern __inline__ uint32 get_block_size(void *va);
 
+//Shrink an allocated segment in place: its tail pages are unmapped & given back
+static void shrink_segment(struct Segment *seg, uint32 new_num_of_pages)
+{
+	uint32 tail_va = seg->base_address + new_num_of_pages * PAGE_SIZE;
+	uint32 tail_pages = seg->size_in_number_of_pages - new_num_of_pages;
+
+	unmap_pages(tail_va, tail_pages);
+	clear_segment_tags(seg);
+	seg->size_in_number_of_pages = new_num_of_pages;
+	set_segment_tags(seg);
+
+	struct Segment *tail = new_segment(tail_va, tail_pages);
+	set_segment_tags(tail);
+	//the tail is still counted in the used pages, count it as a used segment too till it's unreserved
+	kheap_counters.num_of_used_segments++;
+	unreserve_segment(tail);
+}
+
+//Grow an allocated segment in place, either into its free right neighbor or by
+//moving the break. Return 0 if there's no room after it.
+static int expand_segment(struct Segment *seg, uint32 new_num_of_pages)
+{
+	uint32 extra = new_num_of_pages - seg->size_in_number_of_pages;
+	uint32 seg_end = segment_end(seg);
+	struct Segment *right = segment_starting_at(seg_end);
+
+	if (right != NULL && !right->is_used && right->size_in_number_of_pages >= extra)
+	{
+		remove_free_segment(right);
+		if (right->size_in_number_of_pages > extra)
+		{
+			right->base_address += extra * PAGE_SIZE;
+			right->size_in_number_of_pages -= extra;
+			insert_free_segment(right);
+		}
+		else
+			release_segment(right);
+	}
+	else if (seg_end == kheapPageAllocBreak && extra <= (KERNEL_HEAP_MAX - kheapPageAllocBreak) / PAGE_SIZE)
+	{
+		kheapPageAllocBreak += extra * PAGE_SIZE;
+	}
+	else
+		return 0;
+
+	clear_segment_tags(seg);
+	seg->size_in_number_of_pages = new_num_of_pages;
+	set_segment_tags(seg);
+	map_pages(seg_end, extra);
+	kheap_counters.num_of_used_pages += extra;
+	return 1;
+}
+
 void *krealloc(void *virtual_address, uint32 new_size)
 {
 	//TODO: [PROJECT'25.BONUS#2] KERNEL REALLOC - krealloc
-	//Your code is here
-	//Comment the following line
-	panic("krealloc() is not implemented yet...!!");
+	if (virtual_address == NULL)
+		return kmalloc(new_size);
+	if (new_size == 0)
+	{
+		kfree(virtual_address);
+		return NULL;
+	}
+
+	uint32 va = (uint32)virtual_address;
+	void *new_va = NULL;
+
+	/* BLOCK allocation: keep it if it's still in the same size class, else move it to a new
+	   block or to the page allocator. The moves go through kmalloc/kfree to be served by the
+	   magazines & counted like any other allocation. */
+	if (va >= KERNEL_HEAP_START && va < (KERNEL_HEAP_START + DYN_ALLOC_MAX_SIZE))
+	{
+		uint32 old_size = get_block_size(virtual_address);
+		if (new_size <= DYN_ALLOC_MAX_BLOCK_SIZE && get_size_class(new_size) == old_size)
+			return virtual_address;
+		new_va = kmalloc(new_size);
+		if (new_va != NULL)
+		{
+			memcpy(new_va, virtual_address, MIN(old_size, new_size));
+			kfree(virtual_address);
+		}
+		return new_va;
+	}
+
+	acquire_kheap_lock();
+
+	/* PAGE allocation */
+	struct Segment *seg = segment_starting_at(va);
+	if (seg == NULL || !seg->is_used)
+	{
+		release_kspinlock(&lk);
+		kpanic_into_prompt("krealloc: no address found");
+		return NULL;
+	}
+	uint32 old_pages = seg->size_in_number_of_pages;
+
+	/* small enough for a block: copy the kept part & give back the pages */
+	if (new_size <= DYN_ALLOC_MAX_BLOCK_SIZE)
+	{
+		release_kspinlock(&lk);
+		new_va = kmalloc(new_size);
+		if (new_va != NULL)
+		{
+			memcpy(new_va, virtual_address, new_size);
+			kfree(virtual_address);
+		}
+		return new_va;
+	}
+
+	uint32 new_pages = calculate_number_of_pages(new_size);
+	if (new_pages < old_pages)
+	{
+		shrink_segment(seg, new_pages);
+	}
+	else if (new_pages > old_pages && !expand_segment(seg, new_pages))
+	{
+		/* no room in place: move the existing frames to the new space instead of copying them */
+		struct Segment *new_seg = reserve_segment(new_pages);
+		if (new_seg == NULL)
+		{
+			release_kspinlock(&lk);
+			return NULL;
+		}
+		remap_pages(va, new_seg->base_address, old_pages);
+		map_pages(new_seg->base_address + old_pages * PAGE_SIZE, new_pages - old_pages);
+		unreserve_segment(seg);
+		va = new_seg->base_address;
+	}
+
+	release_kspinlock(&lk);
+	return (void*)va;
 }
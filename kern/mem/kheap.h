@@ -6,6 +6,7 @@
 #endif
 
 #include <inc/types.h>
+#include <inc/kheap_stats.h>
 
 
 /*2017*/
@@ -26,6 +27,21 @@ uint32 kheapPlacementStrategy;
 static inline void set_kheap_strategy(uint32 strategy){kheapPlacementStrategy = strategy;}
 static inline uint32 get_kheap_strategy(){return kheapPlacementStrategy ;}
 
+//Per-CPU magazines of free blocks in front of the dynamic allocator
+uint32 kheapMagazinesEnabled;
+uint32 kheapNumOfLockAcquires;		//number of times the kheap lock is taken
+void set_kheap_magazines(uint32 enable);	//disabling it gives back all the cached blocks
+static inline uint32 get_kheap_magazines(){return kheapMagazinesEnabled ;}
+
+//Size classes of the kernel block allocator [the kheap tests expect the power of 2 blocks,
+//they print how much DA_SIZE_CLASSES_FINE would have saved on their allocations]
+#define KHEAP_SIZE_CLASSES DA_SIZE_CLASSES_POW2
+
+//Map the 4 MB aligned parts of big allocations by 4 MB pages [if the CPU supports PSE]
+uint32 kheapLargePagesEnabled;
+static inline void set_kheap_large_pages(uint32 enable){kheapLargePagesEnabled = enable;}
+static inline uint32 get_kheap_large_pages(){return kheapLargePagesEnabled ;}
+
 //***********************************
 void kheap_init();
 
@@ -36,6 +52,8 @@ void *krealloc(void *virtual_address, unsigned int new_size);
 unsigned int kheap_virtual_address(unsigned int physical_address);
 unsigned int kheap_physical_address(unsigned int virtual_address);
 
+void get_kheap_stats(struct KHeapStats* stats);
+
 int numOfKheapVACalls ;
 
 
@@ -0,0 +1,271 @@
+/*
+ * kmem_cache.c
+ *
+ *  Typed object caches for the hot kernel objects (WS elements, page references, shares, user kernel stacks).
+ *  Small objects are carved from one-page slabs taken from kmalloc(), so allocating one is a pop
+ *  from a per-cache free list under the cache's own lock instead of a walk of the dynamic allocator.
+ *  Large objects are kmalloc'd one by one and kept constructed on a small per-cache stack when freed.
+ */
+
+#include "kmem_cache.h"
+
+#include <inc/memlayout.h>
+#include <inc/string.h>
+#include <inc/assert.h>
+#include "kheap.h"
+
+//==================================================================================//
+//============================== HELPER FUNCTIONS ==================================//
+//==================================================================================//
+static inline void** obj_link(struct kmem_cache* cache, void* obj)
+{
+	return (void**)((uint32)obj + cache->link_offset);
+}
+
+static inline struct kmem_slab* slab_of_obj(void* obj)
+{
+	return (struct kmem_slab*)ROUNDDOWN((uint32)obj, PAGE_SIZE);
+}
+
+//Take a new slab from kheap and construct all its objects
+//Return NULL if kheap is full
+static struct kmem_slab* grow_cache(struct kmem_cache* cache)
+{
+	struct kmem_slab* slab = kmalloc(PAGE_SIZE);
+	if (slab == NULL)
+		return NULL;
+	assert(((uint32)slab % PAGE_SIZE) == 0);
+
+	slab->cache = cache;
+	slab->num_of_used = 0;
+	slab->free_list = NULL;
+	//link them in reverse so that the first object is handed out first
+	for (int i = cache->objs_per_slab - 1; i >= 0; --i)
+	{
+		void* obj = (void*)((uint32)slab + cache->first_obj_offset + i * cache->obj_stride);
+		if (cache->ctor)
+			cache->ctor(obj);
+		*obj_link(cache, obj) = slab->free_list;
+		slab->free_list = obj;
+	}
+	LIST_INSERT_TAIL(&cache->empty_slabs, slab);
+	cache->stats.num_of_slabs++;
+	cache->stats.num_of_grows++;
+	return slab;
+}
+
+static void reap_slab(struct kmem_cache* cache, struct kmem_slab* slab)
+{
+	LIST_REMOVE(&cache->empty_slabs, slab);
+	slab->cache = NULL;
+	kfree(slab);
+	cache->stats.num_of_slabs--;
+	cache->stats.num_of_reaps++;
+}
+
+//Give back all the empty slabs & the free large objects of the cache (cache lock is held)
+static void reap_free_objs(struct kmem_cache* cache)
+{
+	while (LIST_FIRST(&cache->empty_slabs) != NULL)
+		reap_slab(cache, LIST_FIRST(&cache->empty_slabs));
+	while (cache->num_of_large_free > 0)
+	{
+		kfree(cache->large_free[--cache->num_of_large_free]);
+		cache->stats.num_of_slabs--;
+		cache->stats.num_of_reaps++;
+	}
+}
+
+//==================================================================================//
+//================================ CREATE/DESTROY ==================================//
+//==================================================================================//
+//Create a cache of objects of the given "size".
+//	align: power of 2 [0 means KMEM_CACHE_LINE_SIZE]
+//	ctor : called once on each object when it's first brought into the cache (may be NULL).
+//		   A freed object should be returned in its constructed state.
+//No memory is taken from kheap until the first allocation.
+struct kmem_cache* kmem_cache_create(char* name, uint32 size, uint32 align, void (*ctor)(void*))
+{
+	if (size == 0)
+		panic("kmem_cache_create: size of \"%s\" objects is zero", name);
+	if (align == 0)
+		align = KMEM_CACHE_LINE_SIZE;
+	if ((align & (align - 1)) != 0)
+		panic("kmem_cache_create: alignment %d of \"%s\" is not a power of 2", align, name);
+
+	struct kmem_cache* cache = NULL;
+	for (int i = 0; i < KMEM_MAX_CACHES; ++i)
+	{
+		if (!kmem_caches[i].is_used)
+		{
+			cache = &kmem_caches[i];
+			break;
+		}
+	}
+	if (cache == NULL)
+		panic("kmem_cache_create: no free cache descriptor for \"%s\"", name);
+
+	memset(cache, 0, sizeof(struct kmem_cache));
+	strncpy(cache->name, name, KMEM_CACHE_NAME_LEN - 1);
+	cache->is_used = 1;
+	cache->obj_size = size;
+	cache->align = align;
+	cache->ctor = ctor;
+	cache->link_offset = ROUNDUP(size, sizeof(void*));
+	cache->obj_stride = ROUNDUP(cache->link_offset + sizeof(void*), align);
+	cache->first_obj_offset = ROUNDUP(sizeof(struct kmem_slab), align);
+	if (cache->first_obj_offset < PAGE_SIZE)
+		cache->objs_per_slab = (PAGE_SIZE - cache->first_obj_offset) / cache->obj_stride;
+	cache->is_large = (cache->objs_per_slab < KMEM_MIN_OBJS_PER_SLAB);
+	LIST_INIT(&cache->partial_slabs);
+	LIST_INIT(&cache->full_slabs);
+	LIST_INIT(&cache->empty_slabs);
+	init_kspinlock(&cache->lk, cache->name);
+	return cache;
+}
+
+//Give back all the memory of the cache. All its objects should be freed first.
+void kmem_cache_destroy(struct kmem_cache* cache)
+{
+	acquire_kspinlock(&cache->lk);
+	if (cache->stats.num_of_active_objs != 0)
+		panic("kmem_cache_destroy: cache \"%s\" still has %d active objects", cache->name, cache->stats.num_of_active_objs);
+	reap_free_objs(cache);
+	cache->is_used = 0;
+	release_kspinlock(&cache->lk);
+}
+
+//==================================================================================//
+//================================== ALLOC/FREE ====================================//
+//==================================================================================//
+//Return a constructed object, NULL if kheap is full
+void* kmem_cache_alloc(struct kmem_cache* cache)
+{
+	void* obj = NULL;
+	acquire_kspinlock(&cache->lk);
+	if (cache->is_large)
+	{
+		if (cache->num_of_large_free > 0)
+			obj = cache->large_free[--cache->num_of_large_free];
+		else
+		{
+			obj = kmalloc(cache->obj_size);
+			if (obj != NULL)
+			{
+				if (cache->ctor)
+					cache->ctor(obj);
+				cache->stats.num_of_slabs++;
+				cache->stats.num_of_grows++;
+			}
+		}
+	}
+	else
+	{
+		struct kmem_slab* slab = LIST_FIRST(&cache->partial_slabs);
+		if (slab == NULL)
+		{
+			slab = LIST_FIRST(&cache->empty_slabs);
+			if (slab == NULL)
+				slab = grow_cache(cache);
+			if (slab != NULL)
+			{
+				LIST_REMOVE(&cache->empty_slabs, slab);
+				LIST_INSERT_HEAD(&cache->partial_slabs, slab);
+			}
+		}
+		if (slab != NULL)
+		{
+			obj = slab->free_list;
+			slab->free_list = *obj_link(cache, obj);
+			slab->num_of_used++;
+			if (slab->free_list == NULL)
+			{
+				LIST_REMOVE(&cache->partial_slabs, slab);
+				LIST_INSERT_HEAD(&cache->full_slabs, slab);
+			}
+		}
+	}
+	if (obj != NULL)
+	{
+		cache->stats.num_of_allocs++;
+		cache->stats.num_of_active_objs++;
+	}
+	release_kspinlock(&cache->lk);
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache* cache, void* obj)
+{
+	if (obj == NULL)
+		return;
+	acquire_kspinlock(&cache->lk);
+	if (cache->is_large)
+	{
+		if (cache->num_of_large_free < KMEM_LARGE_CACHE_DEPTH)
+			cache->large_free[cache->num_of_large_free++] = obj;
+		else
+		{
+			kfree(obj);
+			cache->stats.num_of_slabs--;
+			cache->stats.num_of_reaps++;
+		}
+	}
+	else
+	{
+		struct kmem_slab* slab = slab_of_obj(obj);
+		if (slab->cache != cache || ((uint32)obj - (uint32)slab - cache->first_obj_offset) % cache->obj_stride != 0)
+			panic("kmem_cache_free: %x is not an object of cache \"%s\"", obj, cache->name);
+
+		if (slab->free_list == NULL)
+		{
+			LIST_REMOVE(&cache->full_slabs, slab);
+			LIST_INSERT_HEAD(&cache->partial_slabs, slab);
+		}
+		*obj_link(cache, obj) = slab->free_list;
+		slab->free_list = obj;
+		slab->num_of_used--;
+		if (slab->num_of_used == 0)
+		{
+			LIST_REMOVE(&cache->partial_slabs, slab);
+			LIST_INSERT_HEAD(&cache->empty_slabs, slab);
+			if (LIST_SIZE(&cache->empty_slabs) > KMEM_MAX_EMPTY_SLABS)
+				reap_slab(cache, LIST_LAST(&cache->empty_slabs));
+		}
+	}
+	cache->stats.num_of_frees++;
+	cache->stats.num_of_active_objs--;
+	release_kspinlock(&cache->lk);
+}
+
+//Give back the memory kept by all the caches for their future allocations.
+//Called when the free memory becomes scarce [see refill_zeroed_frames()].
+void kmem_cache_reap_all()
+{
+	for (int i = 0; i < KMEM_MAX_CACHES; ++i)
+	{
+		struct kmem_cache* cache = &kmem_caches[i];
+		if (!cache->is_used)
+			continue;
+		acquire_kspinlock(&cache->lk);
+		reap_free_objs(cache);
+		release_kspinlock(&cache->lk);
+	}
+}
+
+//==================================================================================//
+//=================================== STATISTICS ===================================//
+//==================================================================================//
+void kmem_cache_print_stats()
+{
+	cprintf("%-20s %6s %6s %6s %8s %8s %8s %6s %6s\n", "cache", "size", "stride", "active", "allocs", "frees", "slabs", "grows", "reaps");
+	for (int i = 0; i < KMEM_MAX_CACHES; ++i)
+	{
+		struct kmem_cache* cache = &kmem_caches[i];
+		if (!cache->is_used)
+			continue;
+		cprintf("%-20s %6d %6d %6d %8d %8d %8d %6d %6d\n", cache->name, cache->obj_size,
+				cache->is_large ? cache->obj_size : cache->obj_stride,
+				cache->stats.num_of_active_objs, cache->stats.num_of_allocs, cache->stats.num_of_frees,
+				cache->stats.num_of_slabs, cache->stats.num_of_grows, cache->stats.num_of_reaps);
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * kmem_cache.h
+ *
+ *  Typed object caches on top of kmalloc():
+ *  each cache hands out fixed-size, cache-line-aligned objects of one kernel type
+ */
+
+#ifndef FOS_KERN_KMEM_CACHE_H_
+#define FOS_KERN_KMEM_CACHE_H_
+
+#ifndef FOS_KERNEL
+# error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/queue.h>
+#include <kern/conc/kspinlock.h>
+
+#define KMEM_MAX_CACHES			16
+#define KMEM_CACHE_NAME_LEN		32
+#define KMEM_CACHE_LINE_SIZE	64		//default alignment of the objects
+#define KMEM_MAX_EMPTY_SLABS	2		//empty slabs kept per cache before giving them back to kheap
+#define KMEM_MIN_OBJS_PER_SLAB	8		//objects with less per page are "large" (no slab, one kmalloc each)
+#define KMEM_LARGE_CACHE_DEPTH	4		//max number of free constructed large objects kept per cache
+
+//Header of a one-page slab. It's kept at the start of its page,
+//so the slab of an object is ROUNDDOWN(obj, PAGE_SIZE)
+struct kmem_slab
+{
+	struct kmem_cache* cache;
+	void* free_list;			//free objects, each one is linked to the next at [obj + link_offset]
+	uint32 num_of_used;
+	LIST_ENTRY(kmem_slab) prev_next_info;
+};
+LIST_HEAD(kmem_slab_list, kmem_slab);
+
+struct kmem_cache_stats
+{
+	uint32 num_of_allocs;
+	uint32 num_of_frees;
+	uint32 num_of_active_objs;
+	uint32 num_of_slabs;		//current number of slabs [large caches: number of kmalloc'd objects]
+	uint32 num_of_grows;		//number of slabs/objects taken from kheap
+	uint32 num_of_reaps;		//number of slabs/objects given back to kheap
+};
+
+struct kmem_cache
+{
+	char name[KMEM_CACHE_NAME_LEN];
+	uint8 is_used;
+	uint8 is_large;
+	uint32 obj_size;
+	uint32 align;
+	uint32 link_offset;			//where the free-list link is kept (just after the object, so the ctor state survives)
+	uint32 obj_stride;
+	uint32 first_obj_offset;
+	uint32 objs_per_slab;
+	void (*ctor)(void*);
+
+	struct kmem_slab_list partial_slabs;
+	struct kmem_slab_list full_slabs;
+	struct kmem_slab_list empty_slabs;
+
+	//large objects: stack of free (already constructed) objects
+	void* large_free[KMEM_LARGE_CACHE_DEPTH];
+	uint32 num_of_large_free;
+
+	struct kmem_cache_stats stats;
+	struct kspinlock lk;
+};
+
+struct kmem_cache kmem_caches[KMEM_MAX_CACHES];
+
+//***********************************
+struct kmem_cache* kmem_cache_create(char* name, uint32 size, uint32 align, void (*ctor)(void*));
+void kmem_cache_destroy(struct kmem_cache* cache);
+void* kmem_cache_alloc(struct kmem_cache* cache);
+void kmem_cache_free(struct kmem_cache* cache, void* obj);
+void kmem_cache_reap_all();
+void kmem_cache_print_stats();
+
+#endif // FOS_KERN_KMEM_CACHE_H_
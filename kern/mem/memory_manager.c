@@ -25,17 +25,148 @@ FUNCTIONS:	to_physical_address, get_frame_info, tlb_invalidate
 #include <kern/cpu/sched.h>
 #include <kern/disk/pagefile_manager.h>
 #include "kheap.h"
+#include "kmem_cache.h"
 
 
 
 
+static bool tlb_batch_add(uint32 *ptr_page_directory, uint32 virtual_address);
+
 void tlb_invalidate(uint32 *ptr_page_directory, void *virtual_address)
 {
 	// Flush the entry only if we're modifying the current address space.
 	/*2025*/ //check is added
+	// The kernel space is shared by all the address spaces [& its entries are global: see PERM_GLOBAL]
 	struct Env* e = get_cpu_proc();
-	if (!e || e->env_page_directory == ptr_page_directory)
+	if (!e || e->env_page_directory == ptr_page_directory || CHECK_IF_KERNEL_ADDRESS(virtual_address))
+	{
+		// A user page of a batched address space waits for the flush of its batch
+		if (!CHECK_IF_KERNEL_ADDRESS(virtual_address) && tlb_batch_add(ptr_page_directory, (uint32)virtual_address))
+			return;
 		invlpg(virtual_address);
+	}
+}
+
+///****************************** BATCHED TLB INVALIDATIONS ******************************
+// A loop that unmaps (or changes the permissions of) many user pages of an address space is
+// wrapped by tlb_batch_begin()/tlb_batch_end(): its invalidations [see tlb_invalidate()] are
+// collected by the CPU & issued by a single flush at the end of the batch: an invlpg per page
+// if they're at most TLB_BATCH_MAX_PAGES, otherwise a CR3 reload [the kernel entries are global].
+// The kernel SHOULD NOT access the pending pages by their VAs till the end of the batch.
+// Mapping a frame in the batched address space flushes the pending pages first [see map_frame()].
+
+//Issue the pending invalidations of the batch
+static void tlb_batch_flush(struct tlb_batch *b)
+{
+	if (b->num_of_pages > TLB_BATCH_MAX_PAGES)
+		tlbflush();
+	else
+	{
+		for (uint32 i = 0; i < b->num_of_pages; ++i)
+			invlpg((void*)b->virtual_addresses[i]);
+	}
+	b->num_of_pages = 0;
+}
+
+//Record a pending invalidation.
+//RETURNS: 1 if it's batched, 0 if no batch is open on the given address space
+static bool tlb_batch_add(uint32 *ptr_page_directory, uint32 virtual_address)
+{
+	bool batched = 0;
+	pushcli();
+	struct tlb_batch *b = &mycpu()->tlb_batch;
+	if (b->depth > 0 && b->page_directory == ptr_page_directory)
+	{
+		if (b->num_of_pages < TLB_BATCH_MAX_PAGES)
+			b->virtual_addresses[b->num_of_pages] = virtual_address;
+		b->num_of_pages++;
+		batched = 1;
+	}
+	popcli();
+	return batched;
+}
+
+//Flush the pending invalidations of the given address space now (its batch remains open)
+static void tlb_batch_sync(uint32 *ptr_page_directory)
+{
+	pushcli();
+	struct tlb_batch *b = &mycpu()->tlb_batch;
+	if (b->num_of_pages > 0 && b->page_directory == ptr_page_directory)
+		tlb_batch_flush(b);
+	popcli();
+}
+
+//
+// Start batching the TLB invalidations of the user pages of the given address space.
+// Batches may be nested on the same address space: the flush is done by the outermost end.
+//
+void tlb_batch_begin(uint32 *ptr_page_directory)
+{
+	pushcli();
+	struct tlb_batch *b = &mycpu()->tlb_batch;
+	if (b->depth == 0)
+	{
+		b->page_directory = ptr_page_directory;
+		b->num_of_pages = 0;
+	}
+	else if (b->page_directory != ptr_page_directory)
+		panic("tlb_batch_begin: a batch of another address space is already open");
+	b->depth++;
+	popcli();
+}
+
+//
+// End the batch opened by tlb_batch_begin(): the pending invalidations are issued by a single flush.
+//
+void tlb_batch_end()
+{
+	pushcli();
+	struct tlb_batch *b = &mycpu()->tlb_batch;
+	if (b->depth == 0)
+		panic("tlb_batch_end: no open batch");
+	if (--b->depth == 0)
+		tlb_batch_flush(b);
+	popcli();
+}
+
+///****************************** KERNEL TEMPORARY MAPPINGS ******************************
+// With the kernel heap, the kernel direct map covers the boot allocations only [see
+// initialize_kernel_VM()], so the content of any other frame is accessed through a temp. mapping
+// at one of the KMAP_SLOTS pages of the CPU at KMAP_BASE. The slots of a CPU are used as a stack:
+// the interrupts remain disabled while a frame is mapped & kunmap_frame() is called in reverse order.
+
+static inline uint32 kmap_slot_va(struct cpu *c, int slot)
+{
+	return KMAP_BASE + ((c - CPUS) * KMAP_SLOTS + slot) * PAGE_SIZE;
+}
+
+//
+// Map the given frame at the next free slot of this CPU (kernel RW).
+// RETURNS: its kernel VA [till kunmap_frame()]
+//
+void* kmap_frame(struct FrameInfo *ptr_frame_info)
+{
+	pushcli();
+	struct cpu *c = mycpu();
+	if (c->kmap_depth == KMAP_SLOTS)
+		panic("kmap_frame: all the KMAP_SLOTS of the CPU are used");
+	uint32 va = kmap_slot_va(c, c->kmap_depth++);
+	ptr_kmap_page_table[PTX(va)] = CONSTRUCT_ENTRY(to_physical_address(ptr_frame_info), PERM_PRESENT | PERM_WRITEABLE);
+	return (void*)va;
+}
+
+//
+// Remove the last mapping of kmap_frame() on this CPU [its VA is given] & flush it from the TLB.
+//
+void kunmap_frame(void *virtual_address)
+{
+	struct cpu *c = mycpu();
+	if (c->kmap_depth == 0 || (uint32)virtual_address != kmap_slot_va(c, c->kmap_depth - 1))
+		panic("kunmap_frame: %x is not the last temp. mapping of the CPU", virtual_address);
+	c->kmap_depth--;
+	ptr_kmap_page_table[PTX(virtual_address)] = 0;
+	invlpg(virtual_address);
+	popcli();
 }
 
 ///******************************* MAPPING USER SPACE *******************************
@@ -43,9 +174,139 @@ void tlb_invalidate(uint32 *ptr_page_directory, void *virtual_address)
 // --------------------------------------------------------------
 // Tracking of physical frames.
 // The 'frames_info' array has one 'struct Frame_Info' entry per physical frame.
-// frames_info are reference counted, and free frames are kept on a linked list.
+// frames_info are reference counted, and free frames are kept by a binary buddy allocator:
+// in blocks of 2^order contiguous frames (order 0..MAX_FRAME_ORDER), each aligned to its size.
+// The buddy of the block of order "o" at frame # "fn" is the block at frame # (fn ^ 2^o).
+// When both are free, they are merged into a single block of order "o+1".
+// Free single frames [order 0] are kept in free_frame_list, so allocate_frame() just pops
+// its head when it's not empty [fast path], otherwise it splits the smallest larger block.
 // --------------------------------------------------------------
 
+//The following helpers should be called while holding MemFrameLists.mfllock
+static inline struct FrameInfo_List* free_list_of_order(uint32 order)
+{
+	return order == 0 ? &MemFrameLists.free_frame_list : &MemFrameLists.free_block_lists[order];
+}
+
+//# free frames counter that a block belongs to [see calculate_available_frames()]
+static inline uint32* free_counter_of(struct FrameInfo *block)
+{
+	return block->isBuffered ? &MemFrameLists.num_of_free_buffered : &MemFrameLists.num_of_free_not_buffered;
+}
+
+static inline void insert_free_block(struct FrameInfo *block, uint32 order)
+{
+	block->isFreeBlock = 1;
+	block->order = order;
+	LIST_INSERT_HEAD(free_list_of_order(order), block);
+	*free_counter_of(block) += 1 << order;
+}
+
+static inline void remove_free_block(struct FrameInfo *block)
+{
+	LIST_REMOVE(free_list_of_order(block->order), block);
+	block->isFreeBlock = 0;
+	*free_counter_of(block) -= 1 << block->order;
+}
+
+//Take a free block of 2^order frames, splitting the smallest larger one if there's no block of this order.
+//Its frames are NOT initialized. Return NULL if there's no free block of this order or larger.
+static struct FrameInfo* take_free_block(uint32 order)
+{
+	uint32 cur_order = order;
+	while (cur_order <= MAX_FRAME_ORDER && LIST_FIRST(free_list_of_order(cur_order)) == NULL)
+		cur_order++;
+	if (cur_order > MAX_FRAME_ORDER)
+		return NULL;
+
+	struct FrameInfo *block = LIST_FIRST(free_list_of_order(cur_order));
+	remove_free_block(block);
+	//keep the lower half & give back the upper one till reaching the required order
+	while (cur_order > order)
+	{
+		cur_order--;
+		insert_free_block(block + (1 << cur_order), cur_order);
+	}
+	return block;
+}
+
+//Take a single free frame: from the buddy allocator, else from the pre-zeroed pool (so its
+//frames are never lost for the normal allocations). Its frame info is NOT initialized.
+static struct FrameInfo* take_free_frame()
+{
+	struct FrameInfo *ptr_frame_info = take_free_block(0);
+	if (ptr_frame_info == NULL && (ptr_frame_info = LIST_FIRST(&MemFrameLists.zeroed_frame_list)) != NULL)
+		LIST_REMOVE(&MemFrameLists.zeroed_frame_list, ptr_frame_info);
+	return ptr_frame_info;
+}
+
+static void give_back_block(struct FrameInfo *block, uint32 order);
+
+//Move up to FRAME_CACHE_BATCH free frames from the global lists to the cache of the given CPU.
+//The frame lists lock should be held.
+static void refill_frame_cache(struct cpu *c)
+{
+	int i;
+	for (i = 0; i < FRAME_CACHE_BATCH; ++i)
+	{
+		struct FrameInfo *ptr_frame_info = take_free_frame();
+		if (ptr_frame_info == NULL)
+			break;
+		LIST_INSERT_TAIL(&c->frame_cache, ptr_frame_info);
+	}
+	atomic_add(&MemFrameLists.num_of_cached, i);
+}
+
+//Give back up to num_of_frames frames of the cache of the given CPU to the global lists (the
+//least recently freed ones first). The frame lists lock should be held.
+static void drain_frame_cache(struct cpu *c, uint32 num_of_frames)
+{
+	struct FrameInfo *ptr_frame_info;
+	uint32 i;
+	for (i = 0; i < num_of_frames && (ptr_frame_info = LIST_LAST(&c->frame_cache)) != NULL; ++i)
+	{
+		LIST_REMOVE(&c->frame_cache, ptr_frame_info);
+		give_back_block(ptr_frame_info, 0);
+	}
+	atomic_add(&MemFrameLists.num_of_cached, -(int32)i);
+}
+
+//Like take_free_block(), but if there's no such block, the frames cached by this CPU are
+//given back first (as they may complete a larger block) then it tries again.
+//The frame lists lock should be held.
+static struct FrameInfo* take_free_block_or_drain(uint32 order)
+{
+	struct FrameInfo *block = take_free_block(order);
+	if (block == NULL)
+	{
+		pushcli();
+		struct cpu *c = mycpu();
+		drain_frame_cache(c, LIST_SIZE(&c->frame_cache));
+		popcli();
+		block = take_free_block(order);
+	}
+	return block;
+}
+
+//Give back the block of 2^order frames starting at "block" & merge it with its free buddies
+static void give_back_block(struct FrameInfo *block, uint32 order)
+{
+	uint32 frame_number = to_frame_number(block);
+	while (order < MAX_FRAME_ORDER)
+	{
+		uint32 buddy_number = frame_number ^ (1 << order);
+		if (buddy_number >= number_of_frames)
+			break;
+		struct FrameInfo *buddy = &frames_info[buddy_number];
+		if (!buddy->isFreeBlock || buddy->order != order)
+			break;
+		remove_free_block(buddy);
+		frame_number &= ~(1 << order);
+		order++;
+	}
+	insert_free_block(&frames_info[frame_number], order);
+}
+
 // Initialize paging structure and free_frame_list.
 // After this point, ONLY use the functions below
 // to allocate and deallocate physical memory via the free_frame_list,
@@ -70,7 +331,16 @@ void initialize_paging()
 	// Change the code to reflect this.
 	int i;
 	LIST_INIT(&MemFrameLists.free_frame_list);
+	for (i = 1; i <= MAX_FRAME_ORDER; i++)
+	{
+		LIST_INIT(&MemFrameLists.free_block_lists[i]);
+	}
 	LIST_INIT(&MemFrameLists.modified_frame_list);
+	LIST_INIT(&MemFrameLists.zeroed_frame_list);
+	MemFrameLists.num_of_free_buffered = 0;
+	MemFrameLists.num_of_free_not_buffered = 0;
+	MemFrameLists.num_of_cached = 0;
+	MemFrameLists.num_of_zeroing = 0;
 
 	//Initialize the corresponding lock
 	init_kspinlock(&MemFrameLists.mfllock, "Frame Info Lock");
@@ -95,7 +365,7 @@ void initialize_paging()
 		initialize_frame_info(&(frames_info[i]));
 		//frames_info[i].references = 0;
 
-		LIST_INSERT_HEAD(&MemFrameLists.free_frame_list, &frames_info[i]);
+		give_back_block(&frames_info[i], 0);
 	}
 
 	for (i = PHYS_IO_MEM/PAGE_SIZE ; i < PHYS_EXTENDED_MEM/PAGE_SIZE; i++)
@@ -115,7 +385,7 @@ void initialize_paging()
 		initialize_frame_info(&(frames_info[i]));
 
 		//frames_info[i].references = 0;
-		LIST_INSERT_HEAD(&MemFrameLists.free_frame_list, &frames_info[i]);
+		give_back_block(&frames_info[i], 0);
 	}
 
 	initialize_disk_page_file();
@@ -146,37 +416,42 @@ void initialize_frame_info(struct FrameInfo *ptr_frame_info)
 // Hint: references should not be incremented
 int allocate_frame(struct FrameInfo **ptr_frame_info)
 {
-	bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
-
-	if (!lock_already_held)
+	//pops the head of the frame cache of this CPU. If it's empty, refill it by a batch from
+	//the global lists (the head of free_frame_list if any, else split a larger block)
+	pushcli();
+	struct cpu *c = mycpu();
+	if (LIST_FIRST(&c->frame_cache) == NULL)
 	{
-		acquire_kspinlock(&MemFrameLists.mfllock);
+		bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
+		if (!lock_already_held)
+			acquire_kspinlock(&MemFrameLists.mfllock);
+		refill_frame_cache(c);
+		if (!lock_already_held)
+			release_kspinlock(&MemFrameLists.mfllock);
 	}
-
-	*ptr_frame_info = LIST_FIRST(&MemFrameLists.free_frame_list);
-	int c = 0;
+	*ptr_frame_info = LIST_FIRST(&c->frame_cache);
+	if (*ptr_frame_info != NULL)
+	{
+		LIST_REMOVE(&c->frame_cache, *ptr_frame_info);
+		atomic_add(&MemFrameLists.num_of_cached, -1);
+	}
+	popcli();
 
 	if (*ptr_frame_info == NULL)
 	{
 		panic("ERROR: Kernel run out of memory... allocate_frame cannot find a free frame.\n");
 	}
 
-	LIST_REMOVE(&MemFrameLists.free_frame_list,*ptr_frame_info);
-//	//ragheb
-//	struct freeFramesCounters ffc;
-//		ffc.freeNotBuffered--;
-//
-
-
-	MemFrameLists.free_frame_list.size--;
-
 	/******************* PAGE BUFFERING CODE *******************
 	 ***********************************************************/
 
 	if((*ptr_frame_info)->isBuffered)
 	{
-		/*MUST UN-COMMENT THIS LINE*/
-		//pt_clear_page_table_entry((*ptr_frame_info)->proc->env_page_directory,(*ptr_frame_info)->va);
+		//drop all the entries that still refer to the reused frame [see unmap_frame_all()]. Each one
+		//drops a reference: hold one more meanwhile so that the frame is not freed by the last one
+		(*ptr_frame_info)->isBuffered = 0;
+		(*ptr_frame_info)->references = rmap_count(*ptr_frame_info) + 1;
+		unmap_frame_all(*ptr_frame_info);
 	}
 
 	/**********************************************************
@@ -184,57 +459,286 @@ int allocate_frame(struct FrameInfo **ptr_frame_info)
 
 	initialize_frame_info(*ptr_frame_info);
 
-	if (!lock_already_held)
-	{
-		release_kspinlock(&MemFrameLists.mfllock);
-	}
-
 	return 0;
 }
 //
 //
-// Return a frame to the free_frame_list.
+// Return a frame to the frame cache of this CPU. Once the cache exceeds its high watermark,
+// a batch of its frames is given back to the buddy allocator [merging them with their free buddies].
 // (This function should only be called when ptr_frame_info->references reaches 0.)
 //
 void free_frame(struct FrameInfo *ptr_frame_info)
+{
+	//release the reverse mappings left (if any) before they're cleared
+	while (ptr_frame_info->mappings != NULL)
+		rmap_remove(ptr_frame_info, ptr_frame_info->mappings->page_directory, ptr_frame_info->mappings->virtual_address);
+
+	/*2012: clear it to ensure that its members (env, isBuffered, ...) become NULL*/
+	initialize_frame_info(ptr_frame_info);
+	/*=============================================================================*/
+
+	pushcli();
+	struct cpu *c = mycpu();
+	LIST_INSERT_HEAD(&c->frame_cache, ptr_frame_info);
+	atomic_add(&MemFrameLists.num_of_cached, 1);
+	if (LIST_SIZE(&c->frame_cache) > FRAME_CACHE_HIGH)
+	{
+		bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
+		if (!lock_already_held)
+			acquire_kspinlock(&MemFrameLists.mfllock);
+		drain_frame_cache(c, FRAME_CACHE_BATCH);
+		if (!lock_already_held)
+			release_kspinlock(&MemFrameLists.mfllock);
+	}
+	popcli();
+	//LOG_STATMENT(cprintf("FN # %d FREED",to_frame_number(ptr_frame_info)));
+}
+
+//
+// Decrement the reference count on a frame
+// freeing it if there are no more references.
+//
+void decrement_references(struct FrameInfo* ptr_frame_info)
+{
+	if (--(ptr_frame_info->references) == 0)
+		free_frame(ptr_frame_info);
+}
+
+///****************************************************************************************///
+///*********************************** PRE-ZEROED FRAMES **********************************///
+///****************************************************************************************///
+// A pool of free frames that are cleared ahead of time, while the CPU is idle [see fos_scheduler()],
+// so that a zero page can be handed out without clearing its 4 KB on the hot path. Its frames are
+// still counted as free [see calculate_available_frames()] & are given to allocate_frame() when
+// the buddy allocator runs out of frames.
+
+//
+// Allocates a physical frame whose content is set to zero. Like allocate_frame(), its references is 0.
+// It pops a frame from the pre-zeroed pool if any, else it clears a newly allocated one.
+// RETURNS:
+//   0 -- on success
+//   If failed, it panic.
+//
+int allocate_zeroed_frame(struct FrameInfo **ptr_frame_info)
 {
 	bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
+	if (!lock_already_held)
+		acquire_kspinlock(&MemFrameLists.mfllock);
+
+	*ptr_frame_info = LIST_FIRST(&MemFrameLists.zeroed_frame_list);
+	if (*ptr_frame_info != NULL)
+	{
+		LIST_REMOVE(&MemFrameLists.zeroed_frame_list, *ptr_frame_info);
+		initialize_frame_info(*ptr_frame_info);
+	}
 
 	if (!lock_already_held)
+		release_kspinlock(&MemFrameLists.mfllock);
+
+	if (*ptr_frame_info == NULL)
 	{
-		acquire_kspinlock(&MemFrameLists.mfllock);
+		allocate_frame(ptr_frame_info);
+		void *va = kmap_frame(*ptr_frame_info);
+		memset(va, 0, PAGE_SIZE);
+		kunmap_frame(va);
 	}
+	return 0;
+}
+
+//
+// Clear up to ZEROED_FRAMES_REFILL_BATCH free frames & add them to the pre-zeroed pool.
+// The pool never exceeds MAX_ZEROED_FRAMES, and it's only refilled while the rest of the free
+// frames stays above the scarce memory threshold [memory_scarce_threshold_percentage].
+// Called from the idle loop of the scheduler. Each frame is cleared outside the lock [through a
+// temp. mapping] & it's counted as free meanwhile [num_of_zeroing]. Only the single free frames
+// are taken: the larger buddy blocks are not split for the pool.
+// Once the free frames are scarce, the memory kept by the object caches & the shared program frames
+// that no env maps [see reclaim_program_frames()] are given back instead.
+//
+void refill_zeroed_frames()
+{
+	uint32 scarce_frames = (number_of_frames * memory_scarce_threshold_percentage) / 100;
+	for (int i = 0; i < ZEROED_FRAMES_REFILL_BATCH; ++i)
 	{
-		/*2012: clear it to ensure that its members (env, isBuffered, ...) become NULL*/
-		initialize_frame_info(ptr_frame_info);
-		/*=============================================================================*/
-		// Fill this function in
-		LIST_INSERT_HEAD(&MemFrameLists.free_frame_list, ptr_frame_info);
-		//LOG_STATMENT(cprintf("FN # %d FREED",to_frame_number(ptr_frame_info)));
+		struct FrameInfo *ptr_frame_info = NULL;
+		bool is_scarce;
+		acquire_kspinlock(&MemFrameLists.mfllock);
+		{
+			//recomputed for each frame: the other CPUs may allocate meanwhile
+			uint32 num_of_zeroed = LIST_SIZE(&MemFrameLists.zeroed_frame_list) + MemFrameLists.num_of_zeroing;
+			uint32 free_frames = MemFrameLists.num_of_free_buffered + MemFrameLists.num_of_free_not_buffered
+					+ num_of_zeroed + MemFrameLists.num_of_cached;
+			is_scarce = (free_frames <= scarce_frames);
+			if (!is_scarce && num_of_zeroed < MAX_ZEROED_FRAMES && free_frames - num_of_zeroed > scarce_frames)
+				ptr_frame_info = LIST_FIRST(&MemFrameLists.free_frame_list);
+			if (ptr_frame_info != NULL)
+			{
+				remove_free_block(ptr_frame_info);
+				initialize_frame_info(ptr_frame_info);
+				MemFrameLists.num_of_zeroing++;
+			}
+		}
+		release_kspinlock(&MemFrameLists.mfllock);
+		if (is_scarce)
+		{
+			kmem_cache_reap_all();
+			reclaim_program_frames();
+		}
+		if (ptr_frame_info == NULL)
+			return;
 
-		//ragheb
-//		MemFrameLists.free_frame_list.size++;
+		void *va = kmap_frame(ptr_frame_info);
+		memset(va, 0, PAGE_SIZE);
+		kunmap_frame(va);
+
+		acquire_kspinlock(&MemFrameLists.mfllock);
+		LIST_INSERT_HEAD(&MemFrameLists.zeroed_frame_list, ptr_frame_info);
+		MemFrameLists.num_of_zeroing--;
+		release_kspinlock(&MemFrameLists.mfllock);
 	}
+}
+
+//
+// Give back all the frames cached by this CPU to the buddy allocator [see free_frame()].
+//
+void flush_frame_cache()
+{
+	acquire_kspinlock(&MemFrameLists.mfllock);
+	pushcli();
+	struct cpu *c = mycpu();
+	drain_frame_cache(c, LIST_SIZE(&c->frame_cache));
+	popcli();
+	release_kspinlock(&MemFrameLists.mfllock);
+}
+
+//
+// Allocates a block of 2^order physically contiguous frames whose first frame number
+// is a multiple of 2^order (order: 0..MAX_FRAME_ORDER). Like allocate_frame(), their references are 0.
+// RETURNS:
+//   0 -- on success, *ptr_first_frame_info is set to the first frame of the block
+//   E_NO_MEM -- if there's no free block of this order or larger
+//
+int allocate_frame_block(uint32 order, struct FrameInfo **ptr_first_frame_info)
+{
+	if (order > MAX_FRAME_ORDER)
+		return E_NO_MEM;
+
+	bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
 	if (!lock_already_held)
+		acquire_kspinlock(&MemFrameLists.mfllock);
+
+	struct FrameInfo *block = take_free_block_or_drain(order);
+	if (block != NULL)
 	{
+		for (uint32 i = 0; i < (1 << order); ++i)
+			initialize_frame_info(&block[i]);
+	}
+
+	if (!lock_already_held)
 		release_kspinlock(&MemFrameLists.mfllock);
+
+	if (block == NULL)
+		return E_NO_MEM;
+	*ptr_first_frame_info = block;
+	return 0;
+}
+
+//
+// Return a block that's allocated by allocate_frame_block() with the same order.
+// (All its frames should have no references.)
+//
+void free_frame_block(struct FrameInfo *ptr_first_frame_info, uint32 order)
+{
+	assert(order <= MAX_FRAME_ORDER && to_frame_number(ptr_first_frame_info) % (1 << order) == 0);
+
+	bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
+	if (!lock_already_held)
+		acquire_kspinlock(&MemFrameLists.mfllock);
+
+	for (uint32 i = 0; i < (1 << order); ++i)
+		initialize_frame_info(&ptr_first_frame_info[i]);
+	give_back_block(ptr_first_frame_info, order);
+
+	if (!lock_already_held)
+		release_kspinlock(&MemFrameLists.mfllock);
+}
+
+//
+// Allocates "num_of_frames" physically contiguous frames whose first frame number is
+// a multiple of "align_in_frames" (power of 2). Like allocate_frame(), their references are 0.
+// It takes the smallest buddy block that fits both & gives back its unneeded tail frames,
+// so they can be freed one by one later (by free_frame()).
+// RETURNS:
+//   0 -- on success, *ptr_first_frame_info is set to the first frame of them
+//   E_NO_MEM -- if there's no such free run of frames
+//
+int allocate_contiguous_frames(uint32 num_of_frames, uint32 align_in_frames, struct FrameInfo **ptr_first_frame_info)
+{
+	uint32 order = 0;
+	while ((1 << order) < num_of_frames || (1 << order) < align_in_frames)
+		order++;
+	if (order > MAX_FRAME_ORDER)
+		return E_NO_MEM;
+
+	bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
+	if (!lock_already_held)
+		acquire_kspinlock(&MemFrameLists.mfllock);
+
+	struct FrameInfo *block = take_free_block_or_drain(order);
+	if (block != NULL)
+	{
+		for (uint32 i = 0; i < (1 << order); ++i)
+			initialize_frame_info(&block[i]);
+		for (uint32 i = num_of_frames; i < (1 << order); ++i)
+			give_back_block(&block[i], 0);
 	}
 
-	//RAGHEB CODE
-	uint32 physical_address = to_physical_address(ptr_frame_info);
-	uint32 pa_frame = physical_address >> 12;
-	frames_info[pa_frame].base_virual_address = 0;
+	if (!lock_already_held)
+		release_kspinlock(&MemFrameLists.mfllock);
 
+	if (block == NULL)
+		return E_NO_MEM;
+	*ptr_first_frame_info = block;
+	return 0;
 }
 
 //
-// Decrement the reference count on a frame
-// freeing it if there are no more references.
+// Print the free blocks of each order of the buddy allocator. For each order, the "unusable"
+// percentage is the part of the free memory that can't serve an allocation of this order
+// (i.e. it's in smaller blocks): 0% means no fragmentation at all for this order.
 //
-void decrement_references(struct FrameInfo* ptr_frame_info)
+void print_frames_fragmentation()
 {
-	if (--(ptr_frame_info->references) == 0)
-		free_frame(ptr_frame_info);
+	uint32 num_of_blocks[MAX_FRAME_ORDER + 1];
+	uint32 total_free = 0;
+
+	acquire_kspinlock(&MemFrameLists.mfllock);
+	{
+		for (int order = 0; order <= MAX_FRAME_ORDER; ++order)
+		{
+			num_of_blocks[order] = LIST_SIZE(free_list_of_order(order));
+			total_free += num_of_blocks[order] << order;
+		}
+	}
+	release_kspinlock(&MemFrameLists.mfllock);
+
+	cprintf("%5s %10s %10s %10s %8s\n", "order", "block(KB)", "blocks", "frames", "unusable");
+	uint32 free_in_smaller_blocks = 0;
+	int largest_order = -1;
+	for (int order = 0; order <= MAX_FRAME_ORDER; ++order)
+	{
+		uint32 unusable = total_free == 0 ? 100 : (free_in_smaller_blocks * 100) / total_free;
+		cprintf("%5d %10d %10d %10d %7d%%\n", order, (PAGE_SIZE << order) / 1024,
+				num_of_blocks[order], num_of_blocks[order] << order, unusable);
+		free_in_smaller_blocks += num_of_blocks[order] << order;
+		if (num_of_blocks[order] > 0)
+			largest_order = order;
+	}
+	cprintf("Total free frames = %d, largest free block = ", total_free);
+	if (largest_order < 0)
+		cprintf("NONE\n");
+	else
+		cprintf("%d KB [order %d]\n", (PAGE_SIZE << largest_order) / 1024, largest_order);
 }
 
 //
@@ -254,6 +758,12 @@ int get_page_table(uint32 *ptr_page_directory, const uint32 virtual_address, uin
 	//2022: check PERM_PRESENT of the table first before calculating its PA
 	if ( (page_directory_entry & PERM_PRESENT) == PERM_PRESENT)
 	{
+		//PSE: the va is mapped by a 4 MB page in the directory entry itself, so there's no table
+		if (page_directory_entry & PTE_PS)
+		{
+			*ptr_page_table = 0;
+			return TABLE_IN_MEMORY;
+		}
 		//	cprintf("gpt .07, page_directory_entry= %x \n",page_directory_entry);
 		if(USE_KHEAP && !CHECK_IF_KERNEL_ADDRESS(virtual_address))
 		{
@@ -366,6 +876,7 @@ void __static_cpt(uint32 *ptr_directory, const uint32 virtual_address, uint32 **
 //
 // RETURNS:
 //   0 on success
+//   E_NO_MEM if there's no memory for its reverse mapping [see rmap_add()] (nothing is changed then)
 //
 // Hint: implement using get_page_table() and unmap_frame().
 //
@@ -409,6 +920,9 @@ int map_frame(uint32 *ptr_page_directory, struct FrameInfo *ptr_frame_info, uint
 	//cprintf("NOW .. map add = %x ptr_page_table = %x PTX(virtual_address) = %d\n", virtual_address, ptr_page_table,PTX(virtual_address));
 	uint32 page_table_entry = ptr_page_table[PTX(virtual_address)];
 
+	//the va may be pending in a batch [e.g. a temp page that's unmapped & mapped again]
+	tlb_batch_sync(ptr_page_directory);
+
 	/*OLD WRONG SOLUTION
 	if( EXTRACT_ADDRESS(page_table_entry) != physical_address)
 	{
@@ -422,22 +936,22 @@ int map_frame(uint32 *ptr_page_directory, struct FrameInfo *ptr_frame_info, uint
 	}*/
 
 	/*NEW'15 CORRECT SOLUTION*/
-	//If already mapped
+	//If already mapped on this pa, then do nothing
+	if ((page_table_entry & PERM_PRESENT) == PERM_PRESENT && EXTRACT_ADDRESS(page_table_entry) == physical_address)
+		return 0;
+	//the reverse mapping is allocated first: nothing is changed if there's no memory for it
+	if (rmap_add(ptr_frame_info, ptr_page_directory, virtual_address) != 0)
+		return E_NO_MEM;
+	//If already mapped on another pa, then unmap it
 	if ((page_table_entry & PERM_PRESENT) == PERM_PRESENT)
-	{
-		//on this pa, then do nothing
-		if (EXTRACT_ADDRESS(page_table_entry) == physical_address)
-			return 0;
-		//on another pa, then unmap it
-		else
-			unmap_frame(ptr_page_directory , virtual_address);
-	}
+		unmap_frame(ptr_page_directory , virtual_address);
 	ptr_frame_info->references++;
 
 	/*********************************************************************************/
 	/*NEW'23 el7:)
 	 * map_frame(): KEEP THE VALUES OF THE AVAILABLE BITS*/
-	uint32 pte_available_bits = ptr_page_table[PTX(virtual_address)] & PERM_AVAILABLE;
+	//[except PERM_NEVER_SWAPPED: it's PERM_COW on a present page]
+	uint32 pte_available_bits = ptr_page_table[PTX(virtual_address)] & PERM_AVAILABLE & ~PERM_NEVER_SWAPPED;
 	ptr_page_table[PTX(virtual_address)] = CONSTRUCT_ENTRY(physical_address , pte_available_bits | perm | PERM_PRESENT);
 	/*********************************************************************************/
 	// Ragheb CODE
@@ -500,12 +1014,16 @@ void unmap_frame(uint32 *ptr_page_directory, uint32 virtual_address)
 	{
 		if (ptr_frame_info->isBuffered && !CHECK_IF_KERNEL_ADDRESS((uint32)virtual_address))
 			cprintf("WARNING: Freeing BUFFERED frame at va %x!!!\n", virtual_address) ;
+		rmap_remove(ptr_frame_info, ptr_page_directory, virtual_address);
 		decrement_references(ptr_frame_info);
 
 		/*********************************************************************************/
 		/*NEW'23 el7:)
 		 * unmap_frame(): KEEP THE VALUES OF THE AVAILABLE BITS*/
 		uint32 pte_available_bits = ptr_page_table[PTX(virtual_address)] & PERM_AVAILABLE;
+		//[except PERM_COW of a present page: it's PERM_NEVER_SWAPPED once not present]
+		if (ptr_page_table[PTX(virtual_address)] & PERM_PRESENT)
+			pte_available_bits &= ~PERM_COW;
 		ptr_page_table[PTX(virtual_address)] = pte_available_bits;
 		/*********************************************************************************/
 
@@ -527,7 +1045,7 @@ void unmap_frame(uint32 *ptr_page_directory, uint32 virtual_address)
 //
 // RETURNS:
 //   0 on success
-//
+//   E_NO_MEM if there's no memory for its reverse mapping [see rmap_add()]
 //
 int loadtime_map_frame(uint32 *ptr_page_directory, struct FrameInfo *ptr_frame_info, uint32 virtual_address, int perm)
 {
@@ -559,17 +1077,387 @@ int loadtime_map_frame(uint32 *ptr_page_directory, struct FrameInfo *ptr_frame_i
 #endif
 	}
 
+	if (rmap_add(ptr_frame_info, ptr_page_directory, virtual_address) != 0)
+		return E_NO_MEM;
 	ptr_frame_info->references++;
 	ptr_page_table[PTX(virtual_address)] = CONSTRUCT_ENTRY(physical_address , perm | PERM_PRESENT);
 
 	return 0;
 }
 
+//
+// Take "num_of_frames" frames from the buddy allocator under a single hold of its lock
+// and put them in the given "frames" list. Like allocate_frame(), their references are 0.
+// RETURNS:
+//   0 -- on success
+//   E_NO_MEM -- if there're less free frames (none is taken then)
+//
+int allocate_frames(uint32 num_of_frames, struct FrameInfo_List *frames)
+{
+	LIST_INIT(frames);
+	bool lock_already_held = holding_kspinlock(&MemFrameLists.mfllock);
+	if (!lock_already_held)
+		acquire_kspinlock(&MemFrameLists.mfllock);
+
+	struct FrameInfo *ptr_frame_info;
+	for (uint32 i = 0; i < num_of_frames; ++i)
+	{
+		ptr_frame_info = take_free_frame();
+		if (ptr_frame_info == NULL)
+			break;
+		initialize_frame_info(ptr_frame_info);
+		LIST_INSERT_TAIL(frames, ptr_frame_info);
+	}
+	int ret = 0;
+	if (LIST_SIZE(frames) < num_of_frames)
+	{
+		//undo
+		while ((ptr_frame_info = LIST_FIRST(frames)) != NULL)
+		{
+			LIST_REMOVE(frames, ptr_frame_info);
+			initialize_frame_info(ptr_frame_info);
+			give_back_block(ptr_frame_info, 0);
+		}
+		ret = E_NO_MEM;
+	}
+
+	if (!lock_already_held)
+		release_kspinlock(&MemFrameLists.mfllock);
+	return ret;
+}
+
+static inline void rmap_link(struct FrameInfo *ptr_frame_info, struct FrameMapping *m, uint32 *ptr_page_directory, uint32 virtual_address);
+
+//
+// Allocate & map "num_of_pages" new frames at the page-aligned range starting at "virtual_address"
+// with the permissions perm|PERM_PRESENT, in one operation instead of a map_frame() per page:
+//	- all the frames are taken from the free list at once [see allocate_frames()],
+//	- the page table is looked up (or created) once per 4 MB of the range,
+//	- if set_to_zero, the pages are cleared after being mapped. In this case, the directory
+//	  should be the current one (or the range is in the kernel space) as they're cleared by their VAs.
+// A page that's already mapped in the range is unmapped first (as in map_frame()).
+// RETURNS:
+//   0 on success
+//   E_NO_MEM if there're not enough free frames or no memory for their reverse mappings (nothing is mapped then)
+//
+int map_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 num_of_pages, int perm, bool set_to_zero)
+{
+	struct FrameInfo_List frames;
+	if (allocate_frames(num_of_pages, &frames) != 0)
+		return E_NO_MEM;
+
+	//the reverse mappings of the user pages are allocated before any page is mapped
+	struct FrameMapping *mappings = NULL;
+#if USE_KHEAP
+	if (virtual_address < USER_TOP && rmapCache != NULL)
+	{
+		for (uint32 i = 0; i < num_of_pages; ++i)
+		{
+			struct FrameMapping *m = kmem_cache_alloc(rmapCache);
+			if (m == NULL)
+			{
+				//undo
+				while ((m = mappings) != NULL)
+				{
+					mappings = m->next;
+					kmem_cache_free(rmapCache, m);
+				}
+				struct FrameInfo *ptr_frame_info;
+				while ((ptr_frame_info = LIST_FIRST(&frames)) != NULL)
+				{
+					LIST_REMOVE(&frames, ptr_frame_info);
+					free_frame(ptr_frame_info);
+				}
+				return E_NO_MEM;
+			}
+			m->next = mappings;
+			mappings = m;
+		}
+	}
+#endif
+	tlb_batch_sync(ptr_page_directory);
+
+	uint32 *ptr_page_table = NULL;
+	uint32 va = virtual_address;
+	for (uint32 i = 0; i < num_of_pages; ++i, va += PAGE_SIZE)
+	{
+		if (i == 0 || va % PTSIZE == 0)
+		{
+			if (get_page_table(ptr_page_directory, va, &ptr_page_table) == TABLE_NOT_EXIST)
+			{
+#if USE_KHEAP
+				ptr_page_table = create_page_table(ptr_page_directory, va);
+#else
+				__static_cpt(ptr_page_directory, va, &ptr_page_table);
+#endif
+			}
+		}
+		struct FrameInfo *ptr_frame_info = LIST_FIRST(&frames);
+		LIST_REMOVE(&frames, ptr_frame_info);
+
+		if (ptr_page_table[PTX(va)] & PERM_PRESENT)
+			unmap_frame(ptr_page_directory, va);
+		ptr_frame_info->references++;
+		uint32 pte_available_bits = ptr_page_table[PTX(va)] & PERM_AVAILABLE;
+		ptr_page_table[PTX(va)] = CONSTRUCT_ENTRY(to_physical_address(ptr_frame_info), pte_available_bits | perm | PERM_PRESENT);
+		ptr_frame_info->base_virual_address = va;
+		if (mappings != NULL)
+		{
+			struct FrameMapping *m = mappings;
+			mappings = m->next;
+			rmap_link(ptr_frame_info, m, ptr_page_directory, va);
+		}
+	}
+	if (set_to_zero)
+		memset((void*)virtual_address, 0, num_of_pages * PAGE_SIZE);
+	return 0;
+}
+
+
+///****************************************************************************************///
+///************************************ REVERSE MAPPING ***********************************///
+///****************************************************************************************///
+// Each frame keeps the list of its user mappings (directory, va), so it can be unmapped or
+// write-protected in all the address spaces that map it by walking its mappers only, instead of
+// scanning the page tables of all the envs. The kernel space mappings are not tracked.
+
+static inline void rmap_link(struct FrameInfo *ptr_frame_info, struct FrameMapping *m, uint32 *ptr_page_directory, uint32 virtual_address)
+{
+	m->page_directory = ptr_page_directory;
+	m->virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	m->next = ptr_frame_info->mappings;
+	ptr_frame_info->mappings = m;
+}
+
+//
+// Record that the frame is mapped at virtual_address of the given directory.
+// Called by the functions that set a user page table entry to the frame [e.g. map_frame()]
+// BEFORE they set it, so that they can fail without changing it.
+// RETURNS:
+//   0 on success
+//   E_NO_MEM if there's no memory for the new mapping
+//
+int rmap_add(struct FrameInfo *ptr_frame_info, uint32 *ptr_page_directory, uint32 virtual_address)
+{
+#if USE_KHEAP
+	if (virtual_address >= USER_TOP || rmapCache == NULL)
+		return 0;
+	struct FrameMapping *m = kmem_cache_alloc(rmapCache);
+	if (m == NULL)
+		return E_NO_MEM;
+	rmap_link(ptr_frame_info, m, ptr_page_directory, virtual_address);
+#endif
+	return 0;
+}
+
+//
+// Record that the mapping of the frame at old_va of the given directory is moved to new_va
+// [see move_user_mem()]
+//
+void rmap_move(struct FrameInfo *ptr_frame_info, uint32 *ptr_page_directory, uint32 old_va, uint32 new_va)
+{
+	old_va = ROUNDDOWN(old_va, PAGE_SIZE);
+	for (struct FrameMapping *m = ptr_frame_info->mappings; m != NULL; m = m->next)
+	{
+		if (m->page_directory == ptr_page_directory && m->virtual_address == old_va)
+		{
+			m->virtual_address = ROUNDDOWN(new_va, PAGE_SIZE);
+			return;
+		}
+	}
+}
+
+//
+// Forget the mapping of the frame at virtual_address of the given directory (if recorded).
+// Called BEFORE the reference of this mapping is dropped [see unmap_frame()].
+//
+void rmap_remove(struct FrameInfo *ptr_frame_info, uint32 *ptr_page_directory, uint32 virtual_address)
+{
+#if USE_KHEAP
+	virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	struct FrameMapping **link = &ptr_frame_info->mappings;
+	while (*link != NULL)
+	{
+		struct FrameMapping *m = *link;
+		if (m->page_directory == ptr_page_directory && m->virtual_address == virtual_address)
+		{
+			*link = m->next;
+			kmem_cache_free(rmapCache, m);
+			return;
+		}
+		link = &m->next;
+	}
+#endif
+}
+
+//
+// Return the number of the user mappings of the frame
+//
+uint32 rmap_count(struct FrameInfo *ptr_frame_info)
+{
+	uint32 count = 0;
+	for (struct FrameMapping *m = ptr_frame_info->mappings; m != NULL; m = m->next)
+		++count;
+	return count;
+}
+
+//
+// Unmap the frame from all the user address spaces that map it [see unmap_frame()].
+// The frame is freed once its last reference is dropped.
+// RETURNS: the number of the removed mappings
+//
+int unmap_frame_all(struct FrameInfo *ptr_frame_info)
+{
+	int count = 0;
+	struct FrameMapping *m;
+	while ((m = ptr_frame_info->mappings) != NULL)
+	{
+		uint32 *ptr_page_directory = m->page_directory;
+		uint32 virtual_address = m->virtual_address;
+		//a stale mapping (its entry no longer refers to this frame) is just dropped
+		uint32 *ptr_page_table = NULL;
+		if (get_frame_info(ptr_page_directory, virtual_address, &ptr_page_table) != ptr_frame_info)
+		{
+			rmap_remove(ptr_frame_info, ptr_page_directory, virtual_address);
+			continue;
+		}
+		//the frame may be freed by the last unmap: don't touch it afterwards
+		bool last = (m->next == NULL);
+		unmap_frame(ptr_page_directory, virtual_address);
+		++count;
+		if (last)
+			break;
+	}
+	return count;
+}
+
+//
+// Clear PERM_WRITEABLE in all the user page table entries that map the frame.
+// RETURNS: the number of the write-protected mappings
+//
+int write_protect_frame_all(struct FrameInfo *ptr_frame_info)
+{
+	int count = 0;
+	for (struct FrameMapping *m = ptr_frame_info->mappings; m != NULL; m = m->next)
+	{
+		uint32 *ptr_page_table = NULL;
+		get_page_table(m->page_directory, m->virtual_address, &ptr_page_table);
+		if (ptr_page_table == NULL)
+			continue;
+		uint32 *entry = &ptr_page_table[PTX(m->virtual_address)];
+		if ((*entry & PERM_PRESENT) && EXTRACT_ADDRESS(*entry) == to_physical_address(ptr_frame_info))
+		{
+			*entry &= ~PERM_WRITEABLE;
+			tlb_invalidate(m->page_directory, (void*)m->virtual_address);
+			++count;
+		}
+	}
+	return count;
+}
 
 ///****************************************************************************************///
 ///******************************* END OF MAPPING USER SPACE ******************************///
 ///****************************************************************************************///
 
+///****************************************************************************************///
+///************************** 4 MB PAGES IN KERNEL SPACE [PSE] ****************************///
+///****************************************************************************************///
+// A 4 MB page is set in the kernel directory entry itself. The page table that was linked to
+// this entry (kernel tables are all created at boot) is kept aside in saved_kernel_tables to be
+// restored on split. The boot direct map uses them as well [see boot_map_range()].
+
+//The directories of the environments took a copy of the kernel entries when they were created
+static void sync_kernel_pde(uint32 pdx)
+{
+	for (int i = 0; i < NENV; ++i)
+	{
+		if (envs[i].env_status != ENV_FREE && envs[i].env_page_directory != NULL)
+			envs[i].env_page_directory[pdx] = ptr_page_directory[pdx];
+	}
+}
+
+//
+// Map the 1024 contiguous frames starting at "ptr_first_frame_info" at the 4 MB aligned
+// kernel "virtual_address" by a single 4 MB page. The range should be unmapped.
+// Each frame gets 1 reference, exactly as if it's mapped by map_frame().
+//
+void map_kernel_large_page(struct FrameInfo *ptr_first_frame_info, uint32 virtual_address, int perm)
+{
+	uint32 pdx = PDX(virtual_address);
+	assert(pse_enabled && virtual_address % PTSIZE == 0 && CHECK_IF_KERNEL_ADDRESS(virtual_address));
+	assert((ptr_page_directory[pdx] & PTE_PS) == 0);
+	assert(to_frame_number(ptr_first_frame_info) % NPTENTRIES == 0);
+
+	for (int i = 0; i < NPTENTRIES; ++i)
+	{
+		ptr_first_frame_info[i].references = 1;
+		ptr_first_frame_info[i].base_virual_address = virtual_address + i * PAGE_SIZE;
+	}
+	saved_kernel_tables[pdx] = ptr_page_directory[pdx];
+	ptr_page_directory[pdx] = CONSTRUCT_ENTRY(to_physical_address(ptr_first_frame_info), perm | PERM_PRESENT | PTE_PS);
+	sync_kernel_pde(pdx);
+	tlbflush_global();
+}
+
+//
+// Turn the 4 MB page at kernel "virtual_address" (if any) back into 1024 pages in its
+// original page table, mapped to the same frames, so that they can be unmapped one by one.
+//
+void split_kernel_large_page(uint32 virtual_address)
+{
+	uint32 pdx = PDX(virtual_address);
+	uint32 page_directory_entry = ptr_page_directory[pdx];
+	if ((page_directory_entry & (PERM_PRESENT | PTE_PS)) != (PERM_PRESENT | PTE_PS))
+		return;
+	assert(saved_kernel_tables[pdx] != 0);
+
+	uint32 physical_address = ROUNDDOWN(page_directory_entry, PTSIZE);
+	uint32 perm = page_directory_entry & (PERM_PRESENT | PERM_WRITEABLE | PERM_USER | PERM_GLOBAL);
+	uint32 *ptr_page_table = STATIC_KERNEL_VIRTUAL_ADDRESS(EXTRACT_ADDRESS(saved_kernel_tables[pdx]));
+	for (int i = 0; i < NPTENTRIES; ++i, physical_address += PAGE_SIZE)
+		ptr_page_table[i] = CONSTRUCT_ENTRY(physical_address, perm);
+
+	ptr_page_directory[pdx] = saved_kernel_tables[pdx];
+	saved_kernel_tables[pdx] = 0;
+	sync_kernel_pde(pdx);
+	tlbflush_global();
+}
+
+//
+// The reverse of split_kernel_large_page(): if the table of the 4 MB aligned kernel
+// "virtual_address" maps 1024 contiguous frames of a 4 MB aligned block with the same
+// permissions, they're mapped back by a single 4 MB page (the table is kept aside).
+// RETURNS: 1 if it's mapped by a 4 MB page afterwards, 0 otherwise
+//
+bool merge_kernel_large_page(uint32 virtual_address)
+{
+	uint32 pdx = PDX(virtual_address);
+	uint32 page_directory_entry = ptr_page_directory[pdx];
+	if (!pse_enabled || !CHECK_IF_KERNEL_ADDRESS(virtual_address) || (page_directory_entry & PERM_PRESENT) == 0)
+		return 0;
+	if (page_directory_entry & PTE_PS)
+		return 1;
+
+	uint32 *ptr_page_table = STATIC_KERNEL_VIRTUAL_ADDRESS(EXTRACT_ADDRESS(page_directory_entry));
+	uint32 perm = ptr_page_table[0] & (PERM_PRESENT | PERM_WRITEABLE | PERM_USER | PERM_GLOBAL);
+	uint32 physical_address = EXTRACT_ADDRESS(ptr_page_table[0]);
+	if ((perm & PERM_PRESENT) == 0 || physical_address % PTSIZE != 0)
+		return 0;
+	for (int i = 0; i < NPTENTRIES; ++i)
+	{
+		if (EXTRACT_ADDRESS(ptr_page_table[i]) != physical_address + i * PAGE_SIZE ||
+				(ptr_page_table[i] & (PERM_PRESENT | PERM_WRITEABLE | PERM_USER | PERM_GLOBAL)) != perm)
+			return 0;
+	}
+
+	saved_kernel_tables[pdx] = page_directory_entry;
+	ptr_page_directory[pdx] = CONSTRUCT_ENTRY(physical_address, perm | PTE_PS);
+	sync_kernel_pde(pdx);
+	tlbflush_global();
+	return 1;
+}
+///****************************************************************************************///
+
 
 //==================================================================================================
 //==================================================================================================
@@ -577,10 +1465,10 @@ int loadtime_map_frame(uint32 *ptr_page_directory, struct FrameInfo *ptr_frame_i
 
 
 
-// calculate_available_frames:
+// calculate_available_frames: in O(1), from the counters & the list sizes. The frames move between
+// the CPU caches & the global lists under the lock & leave the caches by an atomic update, so the total is exact.
 struct freeFramesCounters calculate_available_frames()
 {
-	struct FrameInfo *ptr;
 	uint32 totalFreeUnBuffered = 0 ;
 	uint32 totalFreeBuffered = 0 ;
 	uint32 totalModified = 0 ;
@@ -590,15 +1478,13 @@ struct freeFramesCounters calculate_available_frames()
 		acquire_kspinlock(&MemFrameLists.mfllock);
 	}
 	{
-		//calculate the free frames from the free frame list
+		//the free frames in the free blocks of all orders are counted by insert/remove_free_block()
+		totalFreeBuffered = MemFrameLists.num_of_free_buffered ;
+		totalFreeUnBuffered = MemFrameLists.num_of_free_not_buffered ;
 
-		LIST_FOREACH(ptr, &MemFrameLists.free_frame_list)
-		{
-			if (ptr->isBuffered)
-				totalFreeBuffered++ ;
-			else
-				totalFreeUnBuffered++ ;
-		}
+		//the pre-zeroed frames [incl. the ones being cleared] & the ones cached by the CPUs are free as well
+		totalFreeUnBuffered += LIST_SIZE(&MemFrameLists.zeroed_frame_list) + MemFrameLists.num_of_zeroing;
+		totalFreeUnBuffered += MemFrameLists.num_of_cached;
 
 		/*2023: UPDATE based on suggestion from T112 2023.Term1*/
 		totalModified= LIST_SIZE(&MemFrameLists.modified_frame_list);
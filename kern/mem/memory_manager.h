@@ -40,6 +40,17 @@ uint32 memory_scarce_threshold_percentage;	// Memory remains plentiful till the
 #define DEFAULT_MEM_SCARCE_PERCENTAGE 25	// Default threshold % of free memory to indicate scarce MEM
 //***********************************
 
+//***********************************
+//Pre-zeroed frames pool [see allocate_zeroed_frame()]
+#define MAX_ZEROED_FRAMES 128			// Max # of frames that are kept cleared in the pool
+#define ZEROED_FRAMES_REFILL_BATCH 8	// Max # of frames cleared in one idle iteration of the scheduler
+//***********************************
+
+//***********************************
+//Object cache of the reverse mappings [created in fault_handler_init()]
+struct kmem_cache* rmapCache;
+//***********************************
+
 //***********************************
 /*DATA*/
 struct freeFramesCounters
@@ -62,6 +73,31 @@ struct FrameInfo *get_frame_info(uint32 *ptr_page_directory, uint32 virtual_addr
 void decrement_references(struct FrameInfo* ptr_frame_info);
 void initialize_frame_info(struct FrameInfo *ptr_frame_info);
 
+int allocate_frames(uint32 num_of_frames, struct FrameInfo_List *frames);
+int allocate_zeroed_frame(struct FrameInfo **ptr_frame_info);
+void* kmap_frame(struct FrameInfo *ptr_frame_info);
+void kunmap_frame(void *virtual_address);
+void flush_frame_cache();
+void refill_zeroed_frames();
+int allocate_frame_block(uint32 order, struct FrameInfo **ptr_first_frame_info);
+void free_frame_block(struct FrameInfo *ptr_first_frame_info, uint32 order);
+int allocate_contiguous_frames(uint32 num_of_frames, uint32 align_in_frames, struct FrameInfo **ptr_first_frame_info);
+void print_frames_fragmentation();
+int map_range(uint32 *ptr_page_directory, uint32 virtual_address, uint32 num_of_pages, int perm, bool set_to_zero);
+
+//REVERSE MAPPING [USER SPACE]
+int rmap_add(struct FrameInfo *ptr_frame_info, uint32 *ptr_page_directory, uint32 virtual_address);
+void rmap_move(struct FrameInfo *ptr_frame_info, uint32 *ptr_page_directory, uint32 old_va, uint32 new_va);
+void rmap_remove(struct FrameInfo *ptr_frame_info, uint32 *ptr_page_directory, uint32 virtual_address);
+uint32 rmap_count(struct FrameInfo *ptr_frame_info);
+int unmap_frame_all(struct FrameInfo *ptr_frame_info);
+int write_protect_frame_all(struct FrameInfo *ptr_frame_info);
+
+//4 MB PAGES [KERNEL SPACE]
+void map_kernel_large_page(struct FrameInfo *ptr_first_frame_info, uint32 virtual_address, int perm);
+void split_kernel_large_page(uint32 virtual_address);
+bool merge_kernel_large_page(uint32 virtual_address);
+
 static inline uint32 to_frame_number(struct FrameInfo *ptr_frame_info)
 {
 	return ptr_frame_info - frames_info;
@@ -80,6 +116,8 @@ static inline struct FrameInfo* to_frame_info(uint32 physical_address)
 }
 
 void tlb_invalidate(uint32 *pgdir, void *ptr);
+void tlb_batch_begin(uint32 *ptr_page_directory);
+void tlb_batch_end();
 
 struct freeFramesCounters calculate_available_frames();
 
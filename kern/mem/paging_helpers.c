@@ -17,9 +17,13 @@
 //	1. Set to 1 all "permissions_to_set"
 //	2. Set to 0 all "permissions_to_reset"
 //It's expected that the page table already exist. If not, the function should panic
+//A kernel 4 MB page [PSE] is split back into its page table first.
 //REMEMBER: to invalidate the TLB cache
 inline void pt_set_page_permissions(uint32* directory, uint32 virtual_address, uint32 permissions_to_set, uint32 permissions_to_clear)
 {
+	if (CHECK_IF_KERNEL_ADDRESS(virtual_address))
+		split_kernel_large_page(virtual_address);
+
 	//[1] Get the table
 	uint32* ptr_page_table ;
 	int ret = get_page_table(directory, virtual_address, &ptr_page_table);
@@ -49,15 +53,20 @@ inline void pt_set_page_permissions(uint32* directory, uint32 virtual_address, u
 //===============================
 //Should get ALL page permissions of the given VA
 //If the page table not exist, return -1
+//For a 4 MB page [PSE], they're taken from its directory entry (without PTE_PS)
 inline int pt_get_page_permissions(uint32* page_directory, uint32 virtual_address )
 {
+ uint32 page_directory_entry = page_directory[PDX(virtual_address)];
+ if ((page_directory_entry & (PERM_PRESENT | PTE_PS)) == (PERM_PRESENT | PTE_PS))
+  return (page_directory_entry & 0x00000FFF & ~PTE_PS);
+
  //[1] Get the table
  uint32* ptr_page_table ;
  int ret = get_page_table(page_directory, virtual_address, &ptr_page_table);
- int perm = (ptr_page_table[PTX(virtual_address)] & 0x00000FFF);
  //[2] If exists, return the permissions
  if (ptr_page_table != NULL)
  {
+  int perm = (ptr_page_table[PTX(virtual_address)] & 0x00000FFF);
   //cprintf("va=%x perm = %x\n", virtual_address, ptr_page_table[PTX(virtual_address)] & 0x00000FFF);
   return (perm);
  }
@@ -150,7 +159,8 @@ inline int alloc_page(uint32* directory, uint32 va, uint32 perms, bool set_to_ze
 		return 1;
 	}
 	else {
-		int ret = allocate_frame(&ptr_fi);
+		//a zero page is taken already cleared [see allocate_zeroed_frame()]
+		int ret = set_to_zero ? allocate_zeroed_frame(&ptr_fi) : allocate_frame(&ptr_fi);
 		if (ret == E_NO_MEM) {
 			return E_NO_MEM;
 		}
@@ -160,7 +170,8 @@ inline int alloc_page(uint32* directory, uint32 va, uint32 perms, bool set_to_ze
 			return E_NO_MEM;
 		}
 		if (set_to_zero) {
-			memset((void*)va, 0, PAGE_SIZE);
+			//as if it's cleared by its va: it has no copy in the page file yet
+			pt_set_page_permissions(directory, va, PERM_MODIFIED, 0);
 		}
 		return 0;
 	}
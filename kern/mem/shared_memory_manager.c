@@ -11,6 +11,7 @@
 #include <kern/proc/user_environment.h>
 #include <kern/trap/syscall.h>
 #include "kheap.h"
+#include "kmem_cache.h"
 #include "memory_manager.h"
 
 //==================================================================================//
@@ -21,11 +22,14 @@
 // [1] INITIALIZE SHARES:
 //===========================
 // Initialize the list and the corresponding lock
+static struct kmem_cache *shareCache;
+
 void sharing_init()
 {
 #if USE_KHEAP
     LIST_INIT(&AllShares.shares_list);
     init_kspinlock(&AllShares.shareslock, "shares lock");
+    shareCache = kmem_cache_create("shares", sizeof(struct Share), 0, NULL);
     // init_sleeplock(&AllShares.sharessleeplock, "shares sleep lock");
 #else
     panic("not handled when KERN HEAP is disabled");
@@ -123,7 +127,7 @@ struct Share *alloc_share(int32 ownerID, char *shareName, uint32 size, uint8 isW
     //		return NULL;
     //	}
 
-    struct Share *obj = (struct Share *)kmalloc(sizeof(struct Share));
+    struct Share *obj = (struct Share *)kmem_cache_alloc(shareCache);
     if (!obj)
     {
         return NULL;
@@ -141,7 +145,7 @@ struct Share *alloc_share(int32 ownerID, char *shareName, uint32 size, uint8 isW
     // check allocation
     if (!obj->framesStorage)
     {
-        kfree(obj);
+        kmem_cache_free(shareCache, obj);
         return NULL;
     }
     // init frames
@@ -222,11 +226,12 @@ int create_shared_object(int32 ownerID, char *shareName, uint32 size, uint8 isWr
                 free_frame(shared_obj->framesStorage[j]);
             }
             kfree(shared_obj->framesStorage);
-            kfree(shared_obj);
+            kmem_cache_free(shareCache, shared_obj);
             return E_NO_SHARE;
         }
 
         shared_obj->framesStorage[i] = frame;
+        frame->isShared = 1;
         uint32 *ptr_page_table;
         get_page_table(myenv->env_page_directory, current_VA, &ptr_page_table);
 
@@ -247,7 +252,7 @@ int create_shared_object(int32 ownerID, char *shareName, uint32 size, uint8 isWr
                 free_frame(shared_obj->framesStorage[j]);
             }
             kfree(shared_obj->framesStorage);
-            kfree(shared_obj);
+            kmem_cache_free(shareCache, shared_obj);
             return E_NO_SHARE;
         }
         // go to next page
@@ -8,6 +8,7 @@
 #include <kern/trap/fault_handler.h>
 #include <kern/disk/pagefile_manager.h>
 #include "kheap.h"
+#include "kmem_cache.h"
 #include "memory_manager.h"
 
 ///============================================================================================
@@ -20,7 +21,7 @@
 inline struct WorkingSetElement* env_page_ws_list_create_element(struct Env* e, uint32 virtual_address)
 {
 	assert(virtual_address >= 0 && virtual_address < USER_TOP);
-	struct WorkingSetElement *wse = kmalloc(sizeof(struct WorkingSetElement)) ;
+	struct WorkingSetElement *wse = kmem_cache_alloc(wsElementCache) ;
 	if (wse == NULL)
 	{
 		panic("can't create a new WS element");
@@ -30,6 +31,14 @@ inline struct WorkingSetElement* env_page_ws_list_create_element(struct Env* e,
 	wse->time_stamp = 0x00000000;
 	return wse;
 }
+//==============================
+// [2] DELETE A WS ELEMENT
+//==============================
+//Give back a WS element that's already removed from the lists of env "e"
+inline void env_page_ws_list_free_element(struct Env* e, struct WorkingSetElement* wse)
+{
+	kmem_cache_free(wsElementCache, wse);
+}
 inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
 {
 	if (isPageReplacmentAlgorithmLRU(PG_REP_LRU_LISTS_APPROX))
@@ -45,7 +54,7 @@ inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
 
 				LIST_REMOVE(&(e->ActiveList), ptr_WS_element);
 
-				/*EDIT*/kfree(ptr_WS_element);
+				/*EDIT*/env_page_ws_list_free_element(e, ptr_WS_element);
 
 				if(ptr_tmp_WS_element != NULL)
 				{
@@ -68,7 +77,7 @@ inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
 					unmap_frame(e->env_page_directory, ptr_WS_element->virtual_address);
 					LIST_REMOVE(&(e->SecondList), ptr_WS_element);
 
-					kfree(ptr_WS_element);
+					env_page_ws_list_free_element(e, ptr_WS_element);
 
 					/*EDIT*/break;
 				}
@@ -90,13 +99,38 @@ inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
 				}
 				LIST_REMOVE(&(e->page_WS_list), wse);
 
-				kfree(wse);
+				env_page_ws_list_free_element(e, wse);
 
 				break;
 			}
 		}
 	}
 }
+
+static inline void ws_element_move(struct WorkingSetElement* wse, uint32 src_va, uint32 dst_va, uint32 size)
+{
+	if (wse->virtual_address >= src_va && wse->virtual_address < src_va + size)
+		wse->virtual_address = wse->virtual_address - src_va + dst_va;
+}
+
+//The WS elements of the pages of [src_va, src_va + size) follow them to dst_va [see move_user_mem()]
+void env_page_ws_move(struct Env* e, uint32 src_va, uint32 dst_va, uint32 size)
+{
+	struct WorkingSetElement *wse;
+	if (isPageReplacmentAlgorithmLRU(PG_REP_LRU_LISTS_APPROX))
+	{
+		LIST_FOREACH(wse, &(e->ActiveList))
+			ws_element_move(wse, src_va, dst_va, size);
+		LIST_FOREACH(wse, &(e->SecondList))
+			ws_element_move(wse, src_va, dst_va, size);
+	}
+	else
+	{
+		LIST_FOREACH(wse, &(e->page_WS_list))
+			ws_element_move(wse, src_va, dst_va, size);
+	}
+}
+
 void env_page_ws_print(struct Env *e)
 {
 	if (isPageReplacmentAlgorithmLRU(PG_REP_LRU_LISTS_APPROX))
@@ -169,6 +203,17 @@ inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
 	}
 }
 
+//The WS entries of the pages of [src_va, src_va + size) follow them to dst_va [see move_user_mem()]
+void env_page_ws_move(struct Env* e, uint32 src_va, uint32 dst_va, uint32 size)
+{
+	for (int i = 0; i < e->page_WS_max_size; i++)
+	{
+		uint32 va = e->ptr_pageWorkingSet[i].virtual_address;
+		if (!e->ptr_pageWorkingSet[i].empty && va >= src_va && va < src_va + size)
+			e->ptr_pageWorkingSet[i].virtual_address = va - src_va + dst_va;
+	}
+}
+
 inline void env_page_ws_set_entry(struct Env* e, uint32 entry_index, uint32 virtual_address)
 {
 	assert(entry_index >= 0 && entry_index < e->page_WS_max_size);
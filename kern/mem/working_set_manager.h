@@ -13,10 +13,12 @@
 // Page WS helper functions ===================================================
 void env_page_ws_print(struct Env *curenv);
 inline void env_page_ws_invalidate(struct Env* e, uint32 virtual_address);
+void env_page_ws_move(struct Env* e, uint32 src_va, uint32 dst_va, uint32 size);
 
 #if USE_KHEAP
 /*2024*/
 inline struct WorkingSetElement* env_page_ws_list_create_element(struct Env* e, uint32 virtual_address);
+inline void env_page_ws_list_free_element(struct Env* e, struct WorkingSetElement* wse);
 #else
 inline uint32 env_page_ws_get_size(struct Env *e);
 inline void env_page_ws_set_entry(struct Env* e, uint32 entry_index, uint32 virtual_address);
@@ -17,7 +17,9 @@
 #include <kern/cpu/cpu.h>
 #include "../disk/pagefile_manager.h"
 #include "../mem/kheap.h"
+#include "../mem/kmem_cache.h"
 #include "../mem/memory_manager.h"
+#include "../mem/chunk_operations.h"
 #include "../mem/shared_memory_manager.h"
 
 
@@ -37,11 +39,19 @@ struct ProgramSegment {
 	uint32 size_in_file;
 	uint32 size_in_memory;
 	uint8 *virtual_address;
+	uint32 flags;				//ELF_PROG_FLAG_xxx
 
 	// for use only with PROGRAM_SEGMENT_FOREACH
 	uint32 segment_id;
 };
 
+//A read-only segment [no ELF_PROG_FLAG_WRITE] is shared by all the envs of its program
+//[see map_shared_program_page()]
+static inline bool is_shared_segment(struct ProgramSegment* seg)
+{
+	return USE_KHEAP && !(seg->flags & ELF_PROG_FLAG_WRITE);
+}
+
 // Used inside the PROGRAM_SEGMENT_FOREACH macro to get the first program segment
 // and then iterate on the next ones
 struct ProgramSegment* PROGRAM_SEGMENT_NEXT(struct ProgramSegment* seg, uint8* ptr_program_start);
@@ -91,6 +101,12 @@ void set_environment_entry_point(struct Env* e, uint8* ptr_program_start);
 // Insert in reverse order, so that the first call to allocate_environment()
 // returns envs[0].
 //
+#if USE_KHEAP
+static struct kmem_cache* kstackCache;
+static void kstack_ctor(void* kstack);
+//Protects the segments of the programs, their shared frames & their # envs
+static struct kspinlock program_frames_lock;
+#endif
 void env_init(void)
 {
 	int iEnv = NENV-1;
@@ -100,8 +116,16 @@ void env_init(void)
 		envs[iEnv].env_id = 0;
 		LIST_INSERT_HEAD(&env_free_list, &envs[iEnv]);
 	}
+#if USE_KHEAP
+	kstackCache = kmem_cache_create("user kernel stacks", KERNEL_STACK_SIZE, PAGE_SIZE, kstack_ctor);
+	init_kspinlock(&program_frames_lock, "program frames lock");
+#endif
 }
 
+//2026
+void enableLazyProgramLoading(uint32 enableIt){_LazyProgramLoading = enableIt;}
+uint8 isLazyProgramLoadingEnabled(){ return USE_KHEAP && _LazyProgramLoading; }
+
 //===============================
 // 1) CREATE NEW ENV & LOAD IT:
 //===============================
@@ -173,6 +197,7 @@ struct Env* env_create(char* user_program_name, unsigned int page_WS_size, unsig
 		//[4] initialize the new environment by the virtual address of the page directory
 		// Hint: use "initialize_environment" function
 
+		attach_program(e, ptr_user_program_info);
 		//2016
 		e->page_WS_max_size = page_WS_size;
 
@@ -212,6 +237,10 @@ struct Env* env_create(char* user_program_name, unsigned int page_WS_size, unsig
 
 		PROGRAM_SEGMENT_FOREACH(seg, ptr_program_start)
 		{
+			//Lazy loading: nothing is loaded now, the pages are brought on fault from the
+			//program image & only the modified ones reach the page file [see load_program_page()]
+			if (isLazyProgramLoadingEnabled())
+				break;
 			segment_counter++;
 			/// 7.1) allocate space for current program segment and map it at seg->virtual_address then copy its content
 			// from seg->ptr_start to seg->virtual_address
@@ -230,6 +259,11 @@ struct Env* env_create(char* user_program_name, unsigned int page_WS_size, unsig
 			LOG_STATMENT(cprintf("SEGMENT: allocated pages in WS = %d",allocated_pages));
 			LOG_STATMENT(cprintf("SEGMENT: remaining WS pages after allocation = %d",remaining_ws_pages));
 
+			//the pages of a shared segment that don't fit in the WS are mapped on fault from
+			//the shared frames: nothing to write in the page file
+			if (is_shared_segment(seg))
+				continue;
+
 
 			/// 7.2) temporary initialize 1st page in memory then writing it on page file
 			uint32 dataSrc_va = (uint32) seg->ptr_start;
@@ -410,6 +444,18 @@ struct Env* env_create(char* user_program_name, unsigned int page_WS_size, unsig
 			//if(success == 0) LOG_STATMENT(cprintf("STACK Page added to page file successfully\n"));
 		}
 
+		//The rest of the stack pages in the same page table are never swapped yet:
+		//mark them to be zero-filled on their first touch without looking in the page file
+		{
+			uint32 *ptr_stack_table = NULL;
+			get_page_table(e->env_page_directory, ptr_user_stack_bottom, &ptr_stack_table);
+			uint32 stack_table_start = MAX(ROUNDDOWN(ptr_user_stack_bottom, PTSIZE), USTACKBOTTOM);
+			for (uint32 va = stack_table_start; va < ptr_user_stack_bottom; va += PAGE_SIZE)
+			{
+				ptr_stack_table[PTX(va)] |= PERM_NEVER_SWAPPED;
+			}
+		}
+
 		//2020
 		//LRU Lists: Reset PRESENT bit of all pages in Second List
 		if (isPageReplacmentAlgorithmLRU(PG_REP_LRU_LISTS_APPROX))
@@ -452,6 +498,73 @@ struct Env* env_create(char* user_program_name, unsigned int page_WS_size, unsig
 	return e;
 }
 
+//===============================
+// 1.5) FORK THE ENV:
+//===============================
+// Allocates a new env that's a copy of the given (running) parent: both share the frames
+// & page file slots of the user space copy-on-write [see cow_share_user_space()], and the
+// child resumes from the same trap frame as its parent with 0 as its syscall return value.
+// Returns NULL if there's no free env or no memory to share the user space.
+struct Env* env_fork(struct Env* parent)
+{
+	struct Env* e = NULL;
+
+	pushcli();
+	{
+		if(allocate_environment(&e) < 0)
+		{
+			popcli();
+			return NULL;
+		}
+		strcpy(e->prog_name, parent->prog_name);
+		attach_program(e, parent->program);
+
+		uint32* ptr_user_page_directory;
+		unsigned int phys_user_page_directory;
+#if USE_KHEAP
+		{
+			ptr_user_page_directory = create_user_directory();
+			phys_user_page_directory = kheap_physical_address((uint32)ptr_user_page_directory);
+		}
+#else
+		panic("env_fork: make sure to enable the kernel heap: USE_KHEAP=1");
+#endif
+		e->page_WS_max_size = parent->page_WS_max_size;
+		e->SecondListSize = parent->SecondListSize;
+		e->ActiveListSize = parent->ActiveListSize;
+		e->percentage_of_WS_pages_to_be_removed = parent->percentage_of_WS_pages_to_be_removed;
+
+		initialize_environment(e, ptr_user_page_directory, phys_user_page_directory);
+
+		e->initNumStackPages = parent->initNumStackPages;
+		e->uheap_break = parent->uheap_break;
+
+		if (cow_share_user_space(parent, e) != 0 || pf_share_env_pages(parent, e) != 0)
+		{
+			//no free memory to share the user space: undo what's shared & give back the child
+			unshare_user_space(e);
+			if (e->disk_env_pgdir != 0)
+				pf_free_env(e);
+			delete_user_kern_stack(e);
+			kfree(e->env_page_directory);
+			free_environment(e);
+			popcli();
+			return NULL;
+		}
+
+		//the child returns from the same syscall with 0
+		*(e->env_tf) = *(parent->env_tf);
+		e->env_tf->tf_regs.reg_eax = 0;
+	}
+	popcli();
+
+#if USE_KHEAP
+	e->numOfPrepagedVAs = 0;
+	e->prepagedVAs = NULL;
+#endif
+	return e;
+}
+
 //===============================
 // 2) START EXECUTING THE PROCESS:
 //===============================
@@ -692,8 +805,10 @@ void switchuvm(struct Env *proc)
 	// Load the TSS
 	ltr(GD_TSS);
 
-	//load the user page directory
-	lcr3(c->proc->env_cr3) ;
+	//load the user page directory, unless it's already loaded [e.g. the same env is dispatched again]:
+	//a reload flushes its TLB entries for nothing [the kernel ones are global: see PERM_GLOBAL]
+	if (rcr3() != c->proc->env_cr3)
+		lcr3(c->proc->env_cr3) ;
 
 	popcli();	//enable interrupt
 }
@@ -735,6 +850,7 @@ int allocate_environment(struct Env** e)
 // Free the given environment "e", simply by adding it to the free environment list.
 void free_environment(struct Env* e)
 {
+	detach_program(e);
 	memset(e, 0, sizeof(*e));
 	e->env_status = ENV_FREE;
 	LIST_INSERT_HEAD(&env_free_list, e);
@@ -760,7 +876,6 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 	uint32 iVA = ROUNDDOWN((uint32)vaddr,PAGE_SIZE) ;
 	int r ;
 	uint32 i = 0 ;
-	struct FrameInfo *p = NULL;
 
 	*allocated_pages = 0;
 	/*2015*/// Load max of 6 pages only for the segment that start with va = 200000 [EXCEPT tpp]
@@ -776,14 +891,21 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 			|| strcmp(e->prog_name, "tia_slave3") == 0 || strcmp(e->prog_name, "tia_slave4") == 0))
 		remaining_ws_pages = remaining_ws_pages < 9 ? remaining_ws_pages:9;
 	/*==========================================================================================*/
-	for (; iVA < end_vaddr && i<remaining_ws_pages; i++, iVA += PAGE_SIZE)
+	//Allocate & map all the pages of the segment that fit in the WS at once
+	//(a read-only segment is mapped read-only on the frames shared by the program envs)
+	uint32 num_of_pages = MIN((end_vaddr - iVA) / PAGE_SIZE, remaining_ws_pages);
+	bool shared = is_shared_segment(seg);
+	if (shared)
 	{
-		// Allocate a page
-		allocate_frame(&p) ;
+		for (uint32 va = iVA; va < iVA + num_of_pages * PAGE_SIZE; va += PAGE_SIZE)
+			map_shared_program_page(e, va);
+	}
+	else if (iVA < end_vaddr && map_range(e->env_page_directory, iVA, num_of_pages, PERM_USER | PERM_WRITEABLE, 0) != 0)
+		panic("env_create: no free frames to load the program segment at %x", iVA);
+	LOG_STRING("segment pages allocated & mapped");
 
-		LOG_STRING("segment page allocated");
-		loadtime_map_frame(e->env_page_directory, p, iVA, PERM_USER | PERM_WRITEABLE);
-		LOG_STRING("segment page mapped");
+	for (; iVA < end_vaddr && i<remaining_ws_pages; i++, iVA += PAGE_SIZE)
+	{
 
 #if USE_KHEAP
 		struct WorkingSetElement* wse = env_page_ws_list_create_element(e, iVA);
@@ -857,6 +979,8 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 		/// DON'T MAKE IT " *allocated_pages ++ " EVER !
 		(*allocated_pages) ++;
 	}
+	if (shared)
+		return 0;
 	uint8 *src_ptr = (uint8 *)(seg->ptr_start) ;
 	uint8 *dst_ptr = (uint8 *) seg->virtual_address;
 
@@ -882,6 +1006,199 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 }
 
 
+//==================================================
+// 4.5) LOAD PROGRAM PAGES ON FAULT:
+//==================================================
+#if USE_KHEAP
+//The program_frames_lock should be held
+static void load_program_segments(struct UserProgramInfo* prog)
+{
+	struct ProgramSegment* seg = NULL;
+	LIST_INIT(&(prog->segments));
+	PROGRAM_SEGMENT_FOREACH(seg, prog->ptr_start)
+	{
+		if (seg->size_in_memory == 0)
+			continue;
+		struct LoadableSegment* lseg = kmalloc(sizeof(struct LoadableSegment));
+		if (lseg == NULL)
+			panic("load_program_segments: no kernel heap space for program %s", prog->name);
+		lseg->virtual_address = (uint32)seg->virtual_address;
+		lseg->start_va = ROUNDDOWN(lseg->virtual_address, PAGE_SIZE);
+		lseg->num_of_pages = (ROUNDUP(lseg->virtual_address + seg->size_in_memory, PAGE_SIZE) - lseg->start_va) / PAGE_SIZE;
+		lseg->ptr_start = seg->ptr_start;
+		lseg->size_in_file = seg->size_in_file;
+		lseg->frames = NULL;
+		if (is_shared_segment(seg))
+		{
+			lseg->frames = kmalloc(lseg->num_of_pages * sizeof(struct FrameInfo*));
+			if (lseg->frames == NULL)
+				panic("load_program_segments: no kernel heap space for program %s", prog->name);
+			memset(lseg->frames, 0, lseg->num_of_pages * sizeof(struct FrameInfo*));
+		}
+		LIST_INSERT_TAIL(&(prog->segments), lseg);
+	}
+	prog->segments_loaded = 1;
+}
+
+static struct LoadableSegment* find_program_segment(struct Env* e, uint32 va)
+{
+	struct UserProgramInfo* prog = e->program;
+	if (prog == NULL || !prog->segments_loaded)
+		return NULL;
+
+	struct LoadableSegment* lseg;
+	LIST_FOREACH(lseg, &(prog->segments))
+	{
+		if (va >= lseg->start_va && va < lseg->start_va + lseg->num_of_pages * PAGE_SIZE)
+			return lseg;
+	}
+	return NULL;
+}
+
+//Fill the page at page_va from the content of the segment in the program image (zeros after
+//its content in file, i.e. bss) through the kernel address of its frame (kva)
+static void copy_program_page(struct LoadableSegment* lseg, uint32 page_va, uint8* kva)
+{
+	memset(kva, 0, PAGE_SIZE);
+	uint32 from = MAX(page_va, lseg->virtual_address);
+	uint32 to = MIN(page_va + PAGE_SIZE, lseg->virtual_address + lseg->size_in_file);
+	if (from < to)
+		memcpy(kva + (from - page_va), lseg->ptr_start + (from - lseg->virtual_address), to - from);
+}
+
+//Release the shared frames of the program that are mapped by no env [references == 1, i.e. the
+//program's only] or all of them. The program_frames_lock should be held
+static void release_program_frames(struct UserProgramInfo* prog, bool unused_only)
+{
+	struct LoadableSegment* lseg;
+	LIST_FOREACH(lseg, &(prog->segments))
+	{
+		if (lseg->frames == NULL)
+			continue;
+		for (uint32 i = 0; i < lseg->num_of_pages; ++i)
+		{
+			if (lseg->frames[i] != NULL && (!unused_only || lseg->frames[i]->references == 1))
+			{
+				decrement_references(lseg->frames[i]);
+				lseg->frames[i] = NULL;
+			}
+		}
+	}
+}
+#endif
+
+//Set the program of env e & count it as one of its envs (its segments are described on its
+//first env)
+void attach_program(struct Env* e, struct UserProgramInfo* prog)
+{
+	e->program = prog;
+#if USE_KHEAP
+	if (prog == NULL)
+		return;
+	acquire_kspinlock(&program_frames_lock);
+	if (!prog->segments_loaded)
+		load_program_segments(prog);
+	prog->num_of_envs++;
+	release_kspinlock(&program_frames_lock);
+#endif
+}
+
+//Uncount env e from the envs of its program: the shared frames of the program are released
+//by its last env
+void detach_program(struct Env* e)
+{
+#if USE_KHEAP
+	struct UserProgramInfo* prog = e->program;
+	e->program = NULL;
+	if (prog == NULL)
+		return;
+	acquire_kspinlock(&program_frames_lock);
+	if (--prog->num_of_envs == 0)
+		release_program_frames(prog, 0);
+	release_kspinlock(&program_frames_lock);
+#endif
+}
+
+//Release the shared program frames that are not mapped by any env [called once the free frames
+//are scarce, see refill_zeroed_frames()]. They're loaded again from the program image on fault.
+void reclaim_program_frames()
+{
+#if USE_KHEAP
+	acquire_kspinlock(&program_frames_lock);
+	for (int i = 0; i < NUM_USER_PROGS; ++i)
+	{
+		if (ptr_UserPrograms[i].segments_loaded)
+			release_program_frames(&ptr_UserPrograms[i], 1);
+	}
+	release_kspinlock(&program_frames_lock);
+#endif
+}
+
+//Map the read-only program page at va of env e on its frame shared by all the envs of the
+//program. Return 0 if va is not in a shared segment of its program (nothing is mapped).
+//The frame is loaded from the program image on its first use & kept afterwards (the program
+//holds 1 reference on it) till the last env of the program is freed or it's reclaimed.
+bool map_shared_program_page(struct Env* e, uint32 va)
+{
+#if USE_KHEAP
+	bool mapped = 0;
+	acquire_kspinlock(&program_frames_lock);
+	{
+		struct LoadableSegment* lseg = find_program_segment(e, va);
+		if (lseg != NULL && lseg->frames != NULL)
+		{
+			uint32 page_va = ROUNDDOWN(va, PAGE_SIZE);
+			uint32 i = (page_va - lseg->start_va) / PAGE_SIZE;
+			if (lseg->frames[i] == NULL)
+			{
+				struct FrameInfo* ptr_frame_info = NULL;
+				allocate_frame(&ptr_frame_info);
+				ptr_frame_info->references = 1;
+				//the frame may be outside the kernel direct map
+				uint8* kva = kmap_frame(ptr_frame_info);
+				copy_program_page(lseg, page_va, kva);
+				kunmap_frame(kva);
+				lseg->frames[i] = ptr_frame_info;
+			}
+			//if there's no memory to map it, the page is mapped on a private frame instead
+			mapped = (map_frame(e->env_page_directory, lseg->frames[i], page_va, PERM_USER) == 0);
+		}
+	}
+	release_kspinlock(&program_frames_lock);
+	return mapped;
+#else
+	return 0;
+#endif
+}
+
+//Fill the frame of the private program page at va of env e from the program image [lazy
+//program loading]. Return 0 if va is not in a segment of its program (nothing is filled)
+bool load_program_page(struct Env* e, uint32 va, struct FrameInfo* ptr_frame_info)
+{
+#if USE_KHEAP
+	struct LoadableSegment* lseg = find_program_segment(e, va);
+	if (lseg == NULL)
+		return 0;
+	//the frame may be outside the kernel direct map
+	uint8* kva = kmap_frame(ptr_frame_info);
+	copy_program_page(lseg, ROUNDDOWN(va, PAGE_SIZE), kva);
+	kunmap_frame(kva);
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+//Check whether va is in a loadable segment of the program of env e
+bool is_program_page(struct Env* e, uint32 va)
+{
+#if USE_KHEAP
+	return find_program_segment(e, va) != NULL;
+#else
+	return 0;
+#endif
+}
+
 //==================================================
 // 5) DYNAMICALLY ALLOCATE SPACE FOR USER DIRECTORY:
 //==================================================
@@ -914,18 +1231,25 @@ void* create_user_kern_stack(uint32* ptr_user_page_directory)
 	//Your code is here
 	//Comment the following line
 	//panic("create_user_kern_stack() is not implemented yet...!!");
-	 void *ptr_start_stack_va = kmalloc(KERNEL_STACK_SIZE);
+	 //the stacks cache keeps freed stacks with their GUARD PAGE already unmapped [see kstack_ctor()]
+	 void *ptr_start_stack_va = kmem_cache_alloc(kstackCache);
 	 if(ptr_start_stack_va == NULL)
 	 {
 		panic("Failed to allocate user kernel stack ");
 	 }
-	 uint32 guard_page_va= (uint32)ptr_start_stack_va;
-	 pt_set_page_permissions(ptr_user_page_directory,guard_page_va,0,PERM_PRESENT );
 	 return ptr_start_stack_va;
 	//allocate space for the user kernel stack.
 	//remember to leave its bottom page as a GUARD PAGE (i.e. not mapped)
 	//return a pointer to the start of the allocated space (including the GUARD PAGE)
 }
+#if USE_KHEAP
+//Constructor of the user kernel stacks cache: unmark the bottom GUARD PAGE once when the stack is first allocated.
+//The kernel heap page tables are shared by all directories, so clearing it in the kernel directory is enough.
+static void kstack_ctor(void* kstack)
+{
+	pt_set_page_permissions(ptr_page_directory, (uint32)kstack, 0, PERM_PRESENT);
+}
+#endif
 
 
 
@@ -937,8 +1261,8 @@ void delete_user_kern_stack(struct Env* e)
 {
 #if USE_KHEAP
 	//TODO: [PROJECT'25.BONUS#4] EXIT #1 & #2 - delete_user_kern_stack
-	// Write your code here, remove the panic and write your code
-	panic("delete_user_kern_stack() is not implemented yet...!!");
+	kmem_cache_free(kstackCache, e->kstack);
+	e->kstack = NULL;
 
 	//Delete the allocated space for the user kernel stack of this process "e"
 	//remember to delete the bottom GUARD PAGE (i.e. not mapped)
@@ -1062,6 +1386,7 @@ void initialize_environment(struct Env* e, uint32* ptr_user_page_directory, unsi
 
 	e->pageFaultsCounter=0;
 	e->tableFaultsCounter=0;
+	e->cowFaultsCounter=0;
 
 	e->freeingFullWSCounter = 0;
 	e->freeingScarceMemCounter = 0;
@@ -1074,8 +1399,13 @@ void initialize_environment(struct Env* e, uint32* ptr_user_page_directory, unsi
 	e->nPageIn = 0;
 	e->nPageOut = 0;
 	e->nNewPageAdded = 0;
+	e->nMinorFaults = 0;
+	e->nMajorFaults = 0;
+	e->minorFaultsCycles = 0;
+	e->majorFaultsCycles = 0;
 
 	//e->shared_free_address = USER_SHARED_MEM_START;
+	e->uheap_break = USER_HEAP_PAGE_ALLOC_START;
 
 	//Completes other environment initializations, (envID, status and most of registers)
 	complete_environment_initialization(e);
@@ -1178,6 +1508,7 @@ struct ProgramSegment* PROGRAM_SEGMENT_NEXT(struct ProgramSegment* seg, uint8* p
 		(*seg).size_in_memory =  ph[index].p_memsz;
 		(*seg).size_in_file = ph[index].p_filesz;
 		(*seg).virtual_address = (uint8*)ph[index].p_va;
+		(*seg).flags = ph[index].p_flags;
 		return seg;
 	}
 	return 0;
@@ -1205,6 +1536,7 @@ struct ProgramSegment PROGRAM_SEGMENT_FIRST( uint8* ptr_program_start)
 		(seg).size_in_memory =  ph[index].p_memsz;
 		(seg).size_in_file = ph[index].p_filesz;
 		(seg).virtual_address = (uint8*)ph[index].p_va;
+		(seg).flags = ph[index].p_flags;
 		return seg;
 	}
 	seg.segment_id = -1;
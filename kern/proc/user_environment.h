@@ -10,6 +10,10 @@
 #include "../conc/kspinlock.h"
 
 
+//========================================================
+//Loader mode: if set, env_create() doesn't load the program pages [see load_program_page()]
+uint32 _LazyProgramLoading;
+
 //========================================================
 extern struct UserProgramInfo* ptr_UserPrograms;
 extern struct Env *envs;		// All environments
@@ -25,6 +29,19 @@ int envid2env(int32  envid, struct Env **env_store, bool checkperm);
 void env_init(void);
 /*Create new environment, initialize it, load the EXE into its memory and adjust its address space*/
 struct Env* env_create(char* user_program_name, unsigned int page_WS_size, unsigned int LRU_second_list_size, unsigned int percent_WS_pages_to_remove);
+void enableLazyProgramLoading(uint32 enableIt);
+uint8 isLazyProgramLoadingEnabled();
+/*Set/unset the program of an env: the read-only program pages are shared by its envs*/
+void attach_program(struct Env* e, struct UserProgramInfo* prog);
+void detach_program(struct Env* e);
+/*Map a read-only program page on the frame shared by all the envs of the program*/
+bool map_shared_program_page(struct Env* e, uint32 va);
+void reclaim_program_frames();
+/*Load a private program page from the program image into the given frame [lazy loading]*/
+bool load_program_page(struct Env* e, uint32 va, struct FrameInfo* ptr_frame_info);
+bool is_program_page(struct Env* e, uint32 va);
+/*Create new environment as a copy-on-write copy of the given parent [see sys_fork()]*/
+struct Env* env_fork(struct Env* parent);
 /*Free (delete) the environment by freeing its allocated memory and other resources (if any)*/
 void env_free(struct Env *e);
 
@@ -71,6 +71,16 @@ struct UserProgramInfo userPrograms[] = {
 		{ "tf1_slave1", "tests free (1) slave1: try accessing values in freed spaces", PTR_START_OF(tst_free_1_slave1)},
 		{ "tf1_slave2", "tests free (1) slave2: try accessing values in freed spaces that is not accessed before", PTR_START_OF(tst_free_1_slave2)},
 		{ "tf2", "tests free (2): try accessing values in freed spaces", PTR_START_OF(tst_free_2)},
+		{ "trealloc", "tests realloc: growing in place, moving without copying & shrinking", PTR_START_OF(tst_realloc)},
+		{ "tsbrk", "tests sbrk & the BRK mode of the user heap", PTR_START_OF(tst_sbrk)},
+		{ "tcalloc", "tests calloc on demand-zero heap pages", PTR_START_OF(tst_calloc)},
+		{ "tfork", "tests fork: copy-on-write sharing of the parent's pages", PTR_START_OF(tst_fork)},
+		{ "tshtext", "tests sharing the read-only program pages among the envs of a program", PTR_START_OF(tst_shared_text)},
+		{ "tshtext_slave", "tests sharing the read-only program pages: slave", PTR_START_OF(tst_shared_text_slave)},
+		{ "tlazy", "tests lazy program loading: program pages are loaded on fault", PTR_START_OF(tst_lazy_load)},
+		{ "tua", "tests user heap arenas: batched allocation & release of the page allocator", PTR_START_OF(tst_uheap_arenas)},
+		{ "tpingpong", "benchmarks the context switch: ping-pong between 2 envs", PTR_START_OF(tst_ctxsw_pingpong)},
+		{ "tpingpong_slave", "benchmarks the context switch: slave", PTR_START_OF(tst_ctxsw_pingpong_slave)},
 		/********************************************/
 		{ "tcf1", "tests custom fit (1): page allocator", PTR_START_OF(tst_custom_fit_1)},
 		{ "tcf2", "tests custom fit (2): block allocator", PTR_START_OF(tst_custom_fit_2)},
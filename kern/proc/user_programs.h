@@ -11,6 +11,8 @@
 # error "This is a FOS kernel header; user programs should not #include it"
 #endif
 
+#include <inc/queue.h>
+
 extern int NUM_USER_PROGS;
 
 #define DECLARE_START_OF(binary_name)  \
@@ -21,10 +23,29 @@ extern int NUM_USER_PROGS;
 	)
 
 //=========================================================
+//A loadable segment of a program, used to load its pages on fault from the program image.
+//The pages of a read-only (text/rodata) segment are loaded once into frames that are
+//shared by all the envs of the program [see map_shared_program_page()]
+struct LoadableSegment {
+	uint32 start_va;				//page aligned
+	uint32 num_of_pages;
+	uint8 *ptr_start;				//segment content in the program image
+	uint32 virtual_address;
+	uint32 size_in_file;
+	struct FrameInfo** frames;		//shared segment: frame of each page (NULL if not loaded yet), else NULL
+	LIST_ENTRY(LoadableSegment) prev_next_info;
+};
+LIST_HEAD(LoadableSegment_List, LoadableSegment);
+
 struct UserProgramInfo {
 	const char *name;
 	const char *desc;
 	uint8* ptr_start;
+	//set on the first env_create() of the program
+	bool segments_loaded;
+	struct LoadableSegment_List segments;
+	//# live envs of the program: its shared frames are released by the last one [see detach_program()]
+	uint32 num_of_envs;
 };
 
 struct UserProgramInfo*  get_user_program_info(char* user_program_name);
@@ -96,6 +117,16 @@ DECLARE_START_OF(tst_free_1);
 /*2023*/DECLARE_START_OF(tst_free_1_slave1);
 /*2023*/DECLARE_START_OF(tst_free_1_slave2);
 DECLARE_START_OF(tst_free_2);
+DECLARE_START_OF(tst_realloc);
+DECLARE_START_OF(tst_sbrk);
+DECLARE_START_OF(tst_calloc);
+DECLARE_START_OF(tst_fork);
+DECLARE_START_OF(tst_shared_text);
+DECLARE_START_OF(tst_shared_text_slave);
+DECLARE_START_OF(tst_lazy_load);
+DECLARE_START_OF(tst_uheap_arenas);
+DECLARE_START_OF(tst_ctxsw_pingpong);
+DECLARE_START_OF(tst_ctxsw_pingpong_slave);
 /********************************************/
 DECLARE_START_OF(tst_custom_fit_1);
 DECLARE_START_OF(tst_custom_fit_2);
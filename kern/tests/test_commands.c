@@ -395,23 +395,24 @@ int test_pt_get_page_permissions()
 	}
 
 	//Case 3: Check getting a permission of an existing VA with an existing table
+	//[the kernel mappings are global if supported: see PERM_GLOBAL]
 	va = 0xf0000000;
 	ret = pt_get_page_permissions(ptr_page_directory, va);
-	if (ret != 3)
+	if (ret != (3 | KERNEL_GLOBAL_PERM))
 	{
 		panic("[EVAL] #3 Get Permission Failed.\n");
 	}
 
 	va = 0xF1000000;
 	ret = pt_get_page_permissions(ptr_page_directory, va);
-	if (ret != 3)
+	if (ret != (3 | KERNEL_GLOBAL_PERM))
 	{
 		panic("[EVAL] #4 Get Permission Failed.\n");
 	}
 
 	va = 0xF0001000;
 	ret = pt_get_page_permissions(ptr_page_directory, va);
-	if (ret != 99)
+	if (ret != (99 | KERNEL_GLOBAL_PERM))
 	{
 		panic("[EVAL] #5 Get Permission Failed.\n");
 	}
@@ -555,6 +556,133 @@ int test_virtual_to_physical()
 }
 //===============================================================================================
 
+//Number of free frames & of free blocks of each order of the buddy allocator
+//(the frames cached by the CPU are given back first to be merged with their buddies)
+static uint32 buddy_snapshot(uint32 num_of_blocks[])
+{
+	flush_frame_cache();
+	for (int order = 0; order <= MAX_FRAME_ORDER; ++order)
+		num_of_blocks[order] = (order == 0) ? LIST_SIZE(&MemFrameLists.free_frame_list) : LIST_SIZE(&MemFrameLists.free_block_lists[order]);
+	struct freeFramesCounters counters = calculate_available_frames();
+	return counters.freeBuffered + counters.freeNotBuffered;
+}
+
+static bool same_buddy_snapshot(uint32 num_of_blocks1[], uint32 num_of_blocks2[])
+{
+	for (int order = 0; order <= MAX_FRAME_ORDER; ++order)
+		if (num_of_blocks1[order] != num_of_blocks2[order])
+			return 0;
+	return 1;
+}
+
+int test_frame_blocks()
+{
+	uint32 blocks_before[MAX_FRAME_ORDER + 1], blocks_after[MAX_FRAME_ORDER + 1];
+	uint32 free_before = buddy_snapshot(blocks_before);
+	struct FrameInfo *ptr_block = NULL;
+
+	//============================
+	//Case 1: block of order 3 [8 frames]: aligned, not referenced & given back completely
+	if (allocate_frame_block(3, &ptr_block) != 0)
+		panic("[EVAL] #1 Test of frame blocks Failed: can't allocate a block of order 3.\n");
+	if (to_frame_number(ptr_block) % 8 != 0)
+		panic("[EVAL] #1 Test of frame blocks Failed: block is not aligned to its size.\n");
+	for (int i = 0; i < 8; ++i)
+		if (ptr_block[i].references != 0 || ptr_block[i].isFreeBlock)
+			panic("[EVAL] #1 Test of frame blocks Failed: frame %d of the block is not initialized.\n", i);
+	if (free_before - buddy_snapshot(blocks_after) != 8)
+		panic("[EVAL] #1 Test of frame blocks Failed: wrong number of allocated frames.\n");
+	free_frame_block(ptr_block, 3);
+	if (buddy_snapshot(blocks_after) != free_before || !same_buddy_snapshot(blocks_before, blocks_after))
+		panic("[EVAL] #1 Test of frame blocks Failed: block is not merged back with its buddies.\n");
+
+	//============================
+	//Case 2: 5 contiguous frames aligned to 4, freed one by one
+	if (allocate_contiguous_frames(5, 4, &ptr_block) != 0)
+		panic("[EVAL] #2 Test of frame blocks Failed: can't allocate 5 contiguous frames.\n");
+	if (to_frame_number(ptr_block) % 4 != 0)
+		panic("[EVAL] #2 Test of frame blocks Failed: frames are not aligned.\n");
+	if (free_before - buddy_snapshot(blocks_after) != 5)
+		panic("[EVAL] #2 Test of frame blocks Failed: wrong number of allocated frames.\n");
+	for (int i = 4; i >= 0; --i)
+		free_frame(&ptr_block[i]);
+	if (buddy_snapshot(blocks_after) != free_before || !same_buddy_snapshot(blocks_before, blocks_after))
+		panic("[EVAL] #2 Test of frame blocks Failed: frames are not merged back with their buddies.\n");
+
+	//============================
+	//Case 3: single frames split a larger block & are merged back when freed
+	struct FrameInfo *ptr_frames[3];
+	for (int i = 0; i < 3; ++i)
+		allocate_frame(&ptr_frames[i]);
+	if (free_before - buddy_snapshot(blocks_after) != 3)
+		panic("[EVAL] #3 Test of frame blocks Failed: wrong number of allocated frames.\n");
+	for (int i = 0; i < 3; ++i)
+		free_frame(ptr_frames[i]);
+	if (buddy_snapshot(blocks_after) != free_before || !same_buddy_snapshot(blocks_before, blocks_after))
+		panic("[EVAL] #3 Test of frame blocks Failed: frames are not merged back with their buddies.\n");
+
+	//============================
+	//Case 4: orders above the max should be refused
+	if (allocate_frame_block(MAX_FRAME_ORDER + 1, &ptr_block) != E_NO_MEM)
+		panic("[EVAL] #4 Test of frame blocks Failed: order %d is accepted.\n", MAX_FRAME_ORDER + 1);
+
+	//============================
+	cprintf("Congratulations!! test frame blocks [buddy allocator] completed successfully.\n");
+
+	return 0;
+}
+
+int test_frame_rmap()
+{
+#if !USE_KHEAP
+	panic("MUST ENABLE KHEAP");
+#endif
+	uint32 vas[3] = {0x80000000, 0x80001000, 0x80400000};
+	uint32 *ptr_table = NULL;
+	struct FrameInfo *ptr_frame = NULL;
+	allocate_frame(&ptr_frame);
+
+	//============================
+	//Case 1: each mapping of the frame is recorded
+	for (int i = 0; i < 3; ++i)
+		map_frame(ptr_page_directory, ptr_frame, vas[i], PERM_USER | PERM_WRITEABLE);
+	//mapping it again at the same va adds nothing
+	map_frame(ptr_page_directory, ptr_frame, vas[0], PERM_USER | PERM_WRITEABLE);
+	if (rmap_count(ptr_frame) != 3 || ptr_frame->references != 3)
+		panic("[EVAL] #1 Test of reverse mapping Failed: wrong # of mappings. Expected 3, Actual %d (refs %d).\n", rmap_count(ptr_frame), ptr_frame->references);
+	uint32 free_before = calculate_available_frames().freeNotBuffered;
+
+	//============================
+	//Case 2: write-protect the frame in all its mappings at once
+	if (write_protect_frame_all(ptr_frame) != 3)
+		panic("[EVAL] #2 Test of reverse mapping Failed: wrong # of write-protected mappings.\n");
+	for (int i = 0; i < 3; ++i)
+		if (pt_get_page_permissions(ptr_page_directory, vas[i]) & PERM_WRITEABLE)
+			panic("[EVAL] #2 Test of reverse mapping Failed: va %x is still writable.\n", vas[i]);
+
+	//============================
+	//Case 3: a single unmap drops its mapping only
+	unmap_frame(ptr_page_directory, vas[1]);
+	if (rmap_count(ptr_frame) != 2 || get_frame_info(ptr_page_directory, vas[0], &ptr_table) != ptr_frame)
+		panic("[EVAL] #3 Test of reverse mapping Failed: wrong mappings after a single unmap.\n");
+
+	//============================
+	//Case 4: unmap the frame from all its mappings at once: it's freed
+	if (unmap_frame_all(ptr_frame) != 2)
+		panic("[EVAL] #4 Test of reverse mapping Failed: wrong # of removed mappings.\n");
+	for (int i = 0; i < 3; ++i)
+		if (get_frame_info(ptr_page_directory, vas[i], &ptr_table) != NULL)
+			panic("[EVAL] #4 Test of reverse mapping Failed: va %x is still mapped.\n", vas[i]);
+	if (ptr_frame->mappings != NULL || calculate_available_frames().freeNotBuffered != free_before + 1)
+		panic("[EVAL] #4 Test of reverse mapping Failed: frame is not freed.\n");
+
+	//============================
+	cprintf("Congratulations!! test reverse mapping of frames completed successfully.\n");
+
+	return 0;
+}
+//===============================================================================================
+
 /*******************************/
 /*TESTs OF CHUNKS MANIPULATION */
 /*******************************/
@@ -34,5 +34,7 @@ int test_pt_get_page_permissions();
 int test_pt_clear_page_table_entry();
 int test_pt_clear_page_table_entry_invalid_va();
 int test_virtual_to_physical();
+int test_frame_blocks();
+int test_frame_rmap();
 
 #endif /* KERN_TESTS_TEST_COMMANDS_H_ */
@@ -653,6 +653,88 @@ void test_free_block()
 
 }
 
+//Expected block of a request under DA_SIZE_CLASSES_FINE: ROUNDUP to the quarter of its power of 2 range (min 8)
+static uint32 expected_fine_class(uint32 size)
+{
+	uint32 range_start = DYN_ALLOC_MIN_BLOCK_SIZE;
+	while (range_start * 2 < size)
+		range_start *= 2;
+	uint32 step = MAX(range_start / 4, DYN_ALLOC_MIN_BLOCK_SIZE);
+	return ROUNDUP(size, step);
+}
+
+void test_fine_size_classes()
+{
+#if USE_KHEAP
+	panic("test_fine_size_classes: the kernel heap should be disabled. make sure USE_KHEAP = 0");
+	return;
+#endif
+
+	//Remove the current 1-to-1 mapping of the KERNEL HEAP area since the USE_KHEAP = 0 for this test
+	uint32 startDA = KERNEL_HEAP_START ;
+	uint32 sizeDA = 0x2AE000 ;
+	uint32 endDA = KERNEL_HEAP_START + sizeDA ;
+	remove_current_mappings(startDA, endDA);
+	set_dyn_alloc_size_classes(DA_SIZE_CLASSES_FINE);
+	set_dyn_alloc_class_stats(1);
+	initialize_dynamic_allocator(startDA, endDA);
+
+	int eval = 0;
+	bool is_correct = 1;
+	int initialFreeFrames = sys_calculate_free_frames();
+
+	//====================================================================//
+	/*1: Allocate a block of each possible size & check its class*/
+	cprintf_colored(TEXT_cyan, "\n1: Allocate a block of each possible size & check its class\n\n") ;
+	for (int s = 1; s <= DYN_ALLOC_MAX_BLOCK_SIZE; ++s)
+	{
+		startVAsInit[s] = alloc_block(s);
+		*startVAsInit[s] = s;
+		if (is_correct && get_block_size(startVAsInit[s]) != expected_fine_class(s))
+		{
+			is_correct = 0;
+			cprintf_colored(TEXT_TESTERR_CLR, "fine classes test#1.%d: WRONG! block size is not correct. Expected = %d, Actual = %d\n", s, expected_fine_class(s), get_block_size(startVAsInit[s]));
+		}
+	}
+	if (is_correct) eval += 40;
+	is_correct = 1;
+
+	//====================================================================//
+	/*2: Less memory than the power of 2 classes for the same requests*/
+	cprintf_colored(TEXT_cyan, "\n2: Compare the internal fragmentation with the power of 2 classes\n\n") ;
+	print_size_classes_fragmentation();
+	if (dynAllocStats.fine_class_bytes >= dynAllocStats.pow2_class_bytes)
+	{
+		is_correct = 0;
+		cprintf_colored(TEXT_TESTERR_CLR, "fine classes test#2: WRONG! fine classes should take less memory than the power of 2 ones\n");
+	}
+	if (is_correct) eval += 20;
+	is_correct = 1;
+
+	//====================================================================//
+	/*3: Free all blocks: the content is kept & all the pages are given back*/
+	cprintf_colored(TEXT_cyan, "\n3: Free all blocks\n\n") ;
+	for (int s = DYN_ALLOC_MAX_BLOCK_SIZE; s >= 1; --s)
+	{
+		if (is_correct && *startVAsInit[s] != s)
+		{
+			is_correct = 0;
+			cprintf_colored(TEXT_TESTERR_CLR, "fine classes test#3.%d: WRONG! block content is changed while it's not expected to.\n", s);
+		}
+		free_block(startVAsInit[s]);
+	}
+	if ((int)sys_calculate_free_frames() != initialFreeFrames)
+	{
+		is_correct = 0;
+		cprintf_colored(TEXT_TESTERR_CLR, "fine classes test#3: WRONG! pages are not given back. Expected free frames = %d, Actual = %d\n", initialFreeFrames, sys_calculate_free_frames());
+	}
+	if (is_correct) eval += 40;
+
+	set_dyn_alloc_size_classes(DA_SIZE_CLASSES_POW2);
+	set_dyn_alloc_class_stats(0);
+	cprintf_colored(TEXT_light_green, "test fine size classes completed. Evaluation = %d%\n", eval);
+}
+
 void test_realloc_block()
 {
 	panic("unseen test");
@@ -3,10 +3,13 @@
 #include <inc/memlayout.h>
 #include <inc/queue.h>
 #include <inc/dynamic_allocator.h>
+#include <inc/x86.h>
 #include <kern/cpu/sched.h>
 #include <kern/disk/pagefile_manager.h>
 #include "../mem/kheap.h"
+#include "../mem/kmem_cache.h"
 #include "../mem/memory_manager.h"
+#include "../conc/kspinlock.h"
 
 
 /**********************************************************************************************/
@@ -2095,7 +2098,76 @@ int test_krealloc_WF_page()
 }
 int test_krealloc_CF_page()
 {
-	panic("not implemented function");
+	cprintf_colored(TEXT_yellow,"==============================================\n");
+	cprintf_colored(TEXT_yellow,"MAKE SURE to have a FRESH RUN for this test\n(i.e. don't run any program/test before it)\n");
+	cprintf_colored(TEXT_yellow,"==============================================\n");
+
+	int eval = 0;
+	bool correct = 1;
+	int freeFrames;
+	char *ptr1, *ptr2, *ptr3, *ptr;
+
+	ptr1 = kmalloc(2*PAGE_SIZE);
+	ptr2 = kmalloc(4*PAGE_SIZE);
+	ptr3 = kmalloc(1*PAGE_SIZE);
+	for (int i = 0; i < 2*PAGE_SIZE; ++i) ptr1[i] = i % 127;
+	kfree(ptr2);
+
+	//1. Grow into the free neighbor
+	cprintf_colored(TEXT_cyan,"\n1. Expand in place into the next free space [25%]\n");
+	{
+		freeFrames = (int)sys_calculate_free_frames() ;
+		ptr = krealloc(ptr1, 5*PAGE_SIZE);
+		if (ptr != ptr1) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"1.1 Wrong krealloc: should be expanded in place. Expected = %x, Actual = %x\n", ptr1, ptr); }
+		if ((freeFrames - (int)sys_calculate_free_frames()) != 3) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"1.2 Wrong krealloc: only the extra pages should be allocated. Expected = %d, Actual = %d\n", 3, freeFrames - (int)sys_calculate_free_frames()); }
+		for (int i = 0; i < 2*PAGE_SIZE; ++i) if (ptr[i] != i % 127) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"1.3 Wrong krealloc: content is changed\n"); break; }
+		for (int i = 2*PAGE_SIZE; i < 5*PAGE_SIZE; ++i) ptr[i] = 1;
+	}
+	if (correct) eval += 25;
+	correct = 1;
+
+	//2. Shrink
+	cprintf_colored(TEXT_cyan,"\n2. Shrink in place [25%]\n");
+	{
+		freeFrames = (int)sys_calculate_free_frames() ;
+		ptr = krealloc(ptr1, 2*PAGE_SIZE);
+		if (ptr != ptr1) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"2.1 Wrong krealloc: should be shrunk in place. Expected = %x, Actual = %x\n", ptr1, ptr); }
+		if (((int)sys_calculate_free_frames() - freeFrames) != 3) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"2.2 Wrong krealloc: tail pages are not freed. Expected = %d, Actual = %d\n", 3, (int)sys_calculate_free_frames() - freeFrames); }
+		if (kheap_physical_address((uint32)ptr1 + 2*PAGE_SIZE) != 0) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"2.3 Wrong krealloc: tail pages are still mapped\n"); }
+	}
+	if (correct) eval += 25;
+	correct = 1;
+
+	//3. Move (not enough space after it)
+	cprintf_colored(TEXT_cyan,"\n3. Move by remapping the frames [30%]\n");
+	{
+		freeFrames = (int)sys_calculate_free_frames() ;
+		uint32 firstFramePA = kheap_physical_address((uint32)ptr1);
+		ptr = krealloc(ptr1, 8*PAGE_SIZE);
+		if (ptr == ptr1 || ptr == NULL) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.1 Wrong krealloc: should be moved to another space\n"); }
+		else
+		{
+			if ((freeFrames - (int)sys_calculate_free_frames()) != 6) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.2 Wrong krealloc: only the extra pages should be allocated. Expected = %d, Actual = %d\n", 6, freeFrames - (int)sys_calculate_free_frames()); }
+			if (kheap_physical_address((uint32)ptr) != firstFramePA) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.3 Wrong krealloc: existing frames should be moved not copied\n"); }
+			if (kheap_physical_address((uint32)ptr1) != 0) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.4 Wrong krealloc: old space is still mapped\n"); }
+			for (int i = 0; i < 2*PAGE_SIZE; ++i) if (ptr[i] != i % 127) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.5 Wrong krealloc: content is changed\n"); break; }
+		}
+	}
+	if (correct) eval += 30;
+	correct = 1;
+
+	//4. Free all
+	cprintf_colored(TEXT_cyan,"\n4. Free all [20%]\n");
+	{
+		freeFrames = (int)sys_calculate_free_frames() ;
+		kfree(ptr);
+		kfree(ptr3);
+		if (((int)sys_calculate_free_frames() - freeFrames) != 9) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"4.1 Wrong kfree after krealloc. Expected = %d, Actual = %d\n", 9, (int)sys_calculate_free_frames() - freeFrames); }
+	}
+	if (correct) eval += 20;
+
+	cprintf_colored(TEXT_light_green,"\ntest krealloc Page Alloc completed. Eval = %d%\n", eval);
+	return 0;
 }
 
 int test_krealloc_FF_block()
@@ -2116,7 +2188,54 @@ int test_krealloc_WF_block()
 }
 int test_krealloc_CF_block()
 {
-	panic("not implemented function");
+	int eval = 0;
+	bool correct = 1;
+	char *ptr1, *ptr;
+
+	ptr1 = kmalloc(100);
+	for (int i = 0; i < 100; ++i) ptr1[i] = i;
+
+	//1. Same block size
+	cprintf_colored(TEXT_cyan,"\n1. Resize within the same block size [25%]\n");
+	{
+		ptr = krealloc(ptr1, 120);
+		if (ptr != ptr1) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"1.1 Wrong krealloc: should stay in place. Expected = %x, Actual = %x\n", ptr1, ptr); }
+	}
+	if (correct) eval += 25;
+	correct = 1;
+
+	//2. Block to block
+	cprintf_colored(TEXT_cyan,"\n2. Resize to another block size [25%]\n");
+	{
+		ptr = krealloc(ptr1, 600);
+		if (get_block_size(ptr) != 1024) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"2.1 Wrong krealloc: wrong block size. Expected = %d, Actual = %d\n", 1024, get_block_size(ptr)); }
+		for (int i = 0; i < 100; ++i) if (ptr[i] != i) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"2.2 Wrong krealloc: content is changed\n"); break; }
+	}
+	if (correct) eval += 25;
+	correct = 1;
+
+	//3. Block to page
+	cprintf_colored(TEXT_cyan,"\n3. Resize to page allocator [25%]\n");
+	{
+		ptr = krealloc(ptr, 3*PAGE_SIZE);
+		if ((uint32)ptr < kheapPageAllocStart || (uint32)ptr >= kheapPageAllocBreak) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.1 Wrong krealloc: should be moved to the page allocator. Actual = %x\n", ptr); }
+		for (int i = 0; i < 100; ++i) if (ptr[i] != i) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"3.2 Wrong krealloc: content is changed\n"); break; }
+	}
+	if (correct) eval += 25;
+	correct = 1;
+
+	//4. Page to block
+	cprintf_colored(TEXT_cyan,"\n4. Resize back to block allocator [25%]\n");
+	{
+		ptr = krealloc(ptr, 50);
+		if ((uint32)ptr < KERNEL_HEAP_START || (uint32)ptr >= BLOCK_ALLOC_LIMIT) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"4.1 Wrong krealloc: should be moved to the block allocator. Actual = %x\n", ptr); }
+		for (int i = 0; i < 50; ++i) if (ptr[i] != i) { correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"4.2 Wrong krealloc: content is changed\n"); break; }
+		kfree(ptr);
+	}
+	if (correct) eval += 25;
+
+	cprintf_colored(TEXT_light_green,"\ntest krealloc Block Alloc completed. Eval = %d%\n", eval);
+	return 0;
 }
 
 int test_krealloc_FF_both()
@@ -2167,6 +2286,512 @@ int test_fast_CF()
 
 
 
+/**********************************************************************************************/
+/*********************************** THROUGHPUT BENCHMARK *************************************/
+/**********************************************************************************************/
+//Measures kmalloc/kfree of a PAGE allocation while the page allocator holds N free
+//holes that can't fit it, and compares it with the previous elist/alist page allocator
+//[legacy_kmalloc/legacy_kfree below: its kmalloc/kfree page path as it was, with its own
+//lists & break] doing the same requests on the same holes.
+#define BENCH_MAX_HOLES		1024
+#define BENCH_ROUNDS		200
+#define BENCH_ALLOC_PAGES	2
+
+struct LegacySegment {
+	uint32 size_in_number_of_pages;
+	uint32 base_address;
+	uint32 index;
+	uint32 is_used;
+	LIST_ENTRY(LegacySegment) prev_next_info;
+};
+LIST_HEAD(LegacySegment_List, LegacySegment);
+
+//The legacy allocator takes its descriptors from an array by an ever increasing counter
+struct LegacySegment legacy_segments[2*BENCH_MAX_HOLES + BENCH_ROUNDS];
+uint32 legacy_counter;
+struct LegacySegment_List legacy_elist, legacy_alist;
+uint32 legacy_break, legacy_max;
+struct kspinlock legacy_lk;
+void* bench_ptrs[2*BENCH_MAX_HOLES];
+
+static void* legacy_kmalloc(uint32 num_pages)
+{
+	acquire_kspinlock(&legacy_lk);
+	if (legacy_break == legacy_max)
+	{
+		release_kspinlock(&legacy_lk);
+		return NULL;
+	}
+
+	/* 1) Try exact fit in free list (elist) */
+	struct LegacySegment *free_seg = LIST_FIRST(&legacy_elist);
+	for (; free_seg != 0; free_seg = LIST_NEXT(free_seg)) {
+		if (free_seg->size_in_number_of_pages == num_pages) {
+			uint32 alloc_base = free_seg->base_address;
+			for (uint32 i = 0; i < num_pages; ++i)
+				get_page((void*)(alloc_base + i * PAGE_SIZE));
+			LIST_REMOVE(&legacy_elist, free_seg);
+
+			struct LegacySegment *new_alloc = &legacy_segments[legacy_counter];
+			new_alloc->base_address = alloc_base;
+			new_alloc->size_in_number_of_pages = num_pages;
+			new_alloc->is_used = 1;
+			new_alloc->index = legacy_counter;
+			LIST_INSERT_TAIL(&legacy_alist, new_alloc);
+			legacy_counter++;
+
+			release_kspinlock(&legacy_lk);
+			return (void*)alloc_base;
+		}
+	}
+
+	/* 2) Worst-fit: find largest free segment that can fit */
+	uint32 biggest = 0;
+	struct LegacySegment *worst = NULL;
+	free_seg = LIST_FIRST(&legacy_elist);
+	for (; free_seg != 0; free_seg = LIST_NEXT(free_seg)) {
+		if (free_seg->size_in_number_of_pages >= num_pages
+				&& free_seg->size_in_number_of_pages > biggest) {
+			biggest = free_seg->size_in_number_of_pages;
+			worst = free_seg;
+		}
+	}
+	if (worst != NULL) {
+		uint32 alloc_base = worst->base_address;
+		for (uint32 i = 0; i < num_pages; ++i)
+			get_page((void*)(alloc_base + i * PAGE_SIZE));
+		if (worst->size_in_number_of_pages == num_pages) {
+			LIST_REMOVE(&legacy_elist, worst);
+		} else {
+			worst->base_address += num_pages * PAGE_SIZE;
+			worst->size_in_number_of_pages -= num_pages;
+		}
+
+		struct LegacySegment *new_alloc = &legacy_segments[legacy_counter];
+		new_alloc->base_address = alloc_base;
+		new_alloc->size_in_number_of_pages = num_pages;
+		new_alloc->is_used = 1;
+		new_alloc->index = legacy_counter;
+		LIST_INSERT_TAIL(&legacy_alist, new_alloc);
+		legacy_counter++;
+
+		release_kspinlock(&legacy_lk);
+		return (void*)alloc_base;
+	}
+
+	/* 3) If no suitable free hole, expand the break */
+	uint32 holdkbead = legacy_break;
+	for (uint32 i = 0; i < num_pages; i++) {
+		if (holdkbead == legacy_max) {
+			release_kspinlock(&legacy_lk);
+			return NULL;
+		}
+		holdkbead += PAGE_SIZE;
+	}
+	uint32 alloc_base = legacy_break;
+	for (uint32 i = 0; i < num_pages; ++i) {
+		get_page((void*)(legacy_break));
+		legacy_break += PAGE_SIZE;
+	}
+
+	struct LegacySegment *new_alloc = &legacy_segments[legacy_counter];
+	new_alloc->base_address = alloc_base;
+	new_alloc->size_in_number_of_pages = num_pages;
+	new_alloc->is_used = 1;
+	new_alloc->index = legacy_counter;
+	LIST_INSERT_TAIL(&legacy_alist, new_alloc);
+	legacy_counter++;
+
+	release_kspinlock(&legacy_lk);
+	return (void*)alloc_base;
+}
+
+static void legacy_shrink_heap_if_possible(void)
+{
+	struct LegacySegment *f;
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		for (f = LIST_FIRST(&legacy_elist); f != NULL; f = LIST_NEXT(f)) {
+			uint32 f_end = f->base_address + f->size_in_number_of_pages * PAGE_SIZE;
+			if (f_end == legacy_break) {
+				legacy_break -= f->size_in_number_of_pages * PAGE_SIZE;
+				LIST_REMOVE(&legacy_elist, f);
+				f->is_used = 0;
+				f->base_address = 0;
+				f->size_in_number_of_pages = 0;
+				changed = 1;
+				break;
+			}
+		}
+	}
+}
+
+static void legacy_kfree(void* virtual_address)
+{
+	acquire_kspinlock(&legacy_lk);
+	uint32 va = (uint32)virtual_address;
+
+	/* find the allocated segment in alist by base address */
+	struct LegacySegment *seg, *target = NULL;
+	for (seg = LIST_FIRST(&legacy_alist); seg != NULL; seg = LIST_NEXT(seg)) {
+		if (seg->base_address == va) {
+			target = seg;
+			break;
+		}
+	}
+	if (target == NULL) {
+		release_kspinlock(&legacy_lk);
+		panic("legacy_kfree: no address found");
+	}
+
+	for (uint32 i = 0; i < target->size_in_number_of_pages; ++i)
+		return_page((void*)(target->base_address + i * PAGE_SIZE));
+
+	/* at the top of the heap: shrink the break instead of keeping it as a free hole */
+	uint32 block_end = target->base_address + target->size_in_number_of_pages * PAGE_SIZE;
+	if (block_end == legacy_break) {
+		LIST_REMOVE(&legacy_alist, target);
+		legacy_break -= target->size_in_number_of_pages * PAGE_SIZE;
+		target->is_used = 0;
+		target->size_in_number_of_pages = 0;
+		target->base_address = 0;
+		legacy_shrink_heap_if_possible();
+		release_kspinlock(&legacy_lk);
+		return;
+	}
+
+	/* find neighbors in elist by addresses */
+	target->is_used = 0;
+	struct LegacySegment *left = NULL, *right = NULL;
+	struct LegacySegment *f = LIST_FIRST(&legacy_elist);
+	for (; f != NULL; f = LIST_NEXT(f)) {
+		uint32 f_base = f->base_address;
+		uint32 f_end = f_base + f->size_in_number_of_pages * PAGE_SIZE;
+		if (f_end == target->base_address)
+			left = f;
+		if (target->base_address + target->size_in_number_of_pages * PAGE_SIZE == f_base)
+			right = f;
+		if (left && right) break;
+	}
+
+	LIST_REMOVE(&legacy_alist, target);
+	if (left && right) {
+		left->size_in_number_of_pages += target->size_in_number_of_pages + right->size_in_number_of_pages;
+		LIST_REMOVE(&legacy_elist, right);
+		right->base_address = 0;
+		right->size_in_number_of_pages = 0;
+		target->base_address = 0;
+		target->size_in_number_of_pages = 0;
+	} else if (left) {
+		left->size_in_number_of_pages += target->size_in_number_of_pages;
+		target->base_address = 0;
+		target->size_in_number_of_pages = 0;
+	} else if (right) {
+		right->base_address = target->base_address;
+		right->size_in_number_of_pages += target->size_in_number_of_pages;
+		target->base_address = 0;
+		target->size_in_number_of_pages = 0;
+	} else {
+		LIST_INSERT_TAIL(&legacy_elist, target);
+	}
+	legacy_shrink_heap_if_possible();
+	release_kspinlock(&legacy_lk);
+}
+
+//Same requests as bench_kheap() served by the legacy allocator inside a window of the
+//kernel heap (reserved by kmalloc & unmapped, so the legacy get_page() maps real frames)
+static uint32 bench_legacy(int numOfHoles, bool *correct)
+{
+	uint32 windowPages = 2*numOfHoles + BENCH_ALLOC_PAGES;
+	uint32 oldLargePages = get_kheap_large_pages();
+	set_kheap_large_pages(0);
+	void *window = kmalloc(windowPages*PAGE_SIZE);
+	if (window == NULL) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"kmalloc failed for the legacy window\n"); set_kheap_large_pages(oldLargePages); return 0; }
+	for (uint32 i = 0; i < windowPages; ++i)
+		return_page((void*)((uint32)window + i*PAGE_SIZE));
+	int freeFrames = (int)sys_calculate_free_frames() ;
+
+	init_kspinlock(&legacy_lk, "legacy kheap");
+	LIST_INIT(&legacy_elist);
+	LIST_INIT(&legacy_alist);
+	legacy_counter = 0;
+	legacy_break = (uint32)window;
+	legacy_max = (uint32)window + windowPages*PAGE_SIZE;
+
+	for (int i = 0; i < 2*numOfHoles; ++i)
+		bench_ptrs[i] = legacy_kmalloc(1);
+	for (int i = 0; i < 2*numOfHoles; i += 2)
+		legacy_kfree(bench_ptrs[i]);
+
+	uint32 cycles = 0;
+	uint64 start = read_tsc();
+	for (int r = 0; r < BENCH_ROUNDS; ++r)
+	{
+		void *ptr = legacy_kmalloc(BENCH_ALLOC_PAGES);
+		if (ptr == NULL) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"legacy kmalloc failed at round #%d\n", r); break; }
+		legacy_kfree(ptr);
+	}
+	cycles = (uint32)(read_tsc() - start) / BENCH_ROUNDS;
+
+	for (int i = 1; i < 2*numOfHoles; i += 2)
+		legacy_kfree(bench_ptrs[i]);
+	if ((int)sys_calculate_free_frames() != freeFrames) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"Wrong legacy kfree: frames are not returned back (diff = %d)\n", freeFrames - (int)sys_calculate_free_frames()); }
+	if (legacy_break != (uint32)window) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"Wrong legacy kfree: break is not restored (expected %x, actual %x)\n", window, legacy_break); }
+
+	kfree(window);
+	set_kheap_large_pages(oldLargePages);
+	return cycles;
+}
+
+static uint32 bench_kheap(int numOfHoles, bool *correct)
+{
+	int freeFrames = (int)sys_calculate_free_frames() ;
+	uint32 brk = kheapPageAllocBreak;
+	for (int i = 0; i < 2*numOfHoles; ++i)
+	{
+		bench_ptrs[i] = kmalloc(PAGE_SIZE);
+		if (bench_ptrs[i] == NULL) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"kmalloc failed while creating hole #%d\n", i/2); return 0; }
+	}
+	for (int i = 0; i < 2*numOfHoles; i += 2)
+		kfree(bench_ptrs[i]);
+
+	uint64 start = read_tsc();
+	for (int r = 0; r < BENCH_ROUNDS; ++r)
+	{
+		void *ptr = kmalloc(BENCH_ALLOC_PAGES*PAGE_SIZE);
+		if (ptr == NULL) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"kmalloc failed at round #%d\n", r); break; }
+		kfree(ptr);
+	}
+	uint32 cycles = (uint32)(read_tsc() - start) / BENCH_ROUNDS;
+
+	for (int i = 1; i < 2*numOfHoles; i += 2)
+		kfree(bench_ptrs[i]);
+
+	if ((int)sys_calculate_free_frames() != freeFrames) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"Wrong kfree: frames are not returned back (diff = %d)\n", freeFrames - (int)sys_calculate_free_frames()); }
+	if (kheapPageAllocBreak != brk) { *correct = 0; cprintf_colored(TEXT_TESTERR_CLR,"Wrong kfree: break is not restored (expected %x, actual %x)\n", brk, kheapPageAllocBreak); }
+	return cycles;
+}
+
+int test_kheap_bench()
+{
+	int numOfHoles[] = {16, 128, 512, BENCH_MAX_HOLES};
+	bool correct = 1;
+	cprintf_colored(TEXT_cyan,"\n	kmalloc/kfree of %d pages (avg. cycles per kmalloc+kfree over %d rounds)\n", BENCH_ALLOC_PAGES, BENCH_ROUNDS);
+	for (int t = 0; t < sizeof(numOfHoles)/sizeof(int); ++t)
+	{
+		uint32 indexed = bench_kheap(numOfHoles[t], &correct);
+		uint32 legacy = bench_legacy(numOfHoles[t], &correct);
+		cprintf("	#holes = %4d: kheap = %8d cycles, legacy elist/alist kheap = %8d cycles\n", numOfHoles[t], indexed, legacy);
+		if (!correct) break;
+	}
+	if (correct)
+		cprintf_colored(TEXT_light_green,"\nKHEAP benchmark completed successfully.\n");
+	return 0;
+}
+
+//Counts the kheap lock acquisitions of the small allocations done on each page fault
+//(a new WorkingSetElement is allocated and the evicted one is freed) with and without
+//the per-CPU block magazines.
+#define BENCH_NUM_OF_FAULTS	10000
+#define BENCH_WS_SIZE		64
+
+static uint32 bench_fault_allocations(uint32 *cycles)
+{
+	void* ws[BENCH_WS_SIZE] = {0};
+	uint32 locks = kheapNumOfLockAcquires;
+	uint64 start = read_tsc();
+	for (int f = 0; f < BENCH_NUM_OF_FAULTS; ++f)
+	{
+		int victim = f % BENCH_WS_SIZE;
+		if (ws[victim] != NULL)
+			kfree(ws[victim]);
+		ws[victim] = kmalloc(sizeof(struct WorkingSetElement));
+	}
+	*cycles = (uint32)(read_tsc() - start) / BENCH_NUM_OF_FAULTS;
+	locks = kheapNumOfLockAcquires - locks;
+	for (int i = 0; i < BENCH_WS_SIZE; ++i)
+		kfree(ws[i]);
+	return locks;
+}
+
+int test_kheap_lock_bench()
+{
+	uint32 oldState = get_kheap_magazines();
+	uint32 locks, cycles;
+	cprintf_colored(TEXT_cyan,"\n	kheap lock acquisitions per fault (1 WorkingSetElement alloc + 1 free, %d faults)\n", BENCH_NUM_OF_FAULTS);
+
+	set_kheap_magazines(0);
+	locks = bench_fault_allocations(&cycles);
+	cprintf("	without magazines: %d locks/1000 faults, %8d cycles/fault\n", locks * 1000 / BENCH_NUM_OF_FAULTS, cycles);
+
+	set_kheap_magazines(1);
+	locks = bench_fault_allocations(&cycles);
+	cprintf("	with magazines   : %d locks/1000 faults, %8d cycles/fault\n", locks * 1000 / BENCH_NUM_OF_FAULTS, cycles);
+
+	set_kheap_magazines(oldState);
+	cprintf_colored(TEXT_light_green,"\nKHEAP lock benchmark completed.\n");
+	return 0;
+}
+
+//Touches one word per page of a big kmalloc'd buffer in a page-strided order (every access
+//misses the TLB when it's mapped by 4 KB pages) with and without the 4 MB pages.
+#define BENCH_TLB_SIZE		(16*Mega)
+#define BENCH_TLB_ROUNDS	20
+
+static uint32 bench_tlb_accesses(uint32 *numOfLargePages)
+{
+	uint32 *buf = kmalloc(BENCH_TLB_SIZE);
+	if (buf == NULL)
+		panic("test_kheap_tlb_bench: no space for %d bytes", BENCH_TLB_SIZE);
+	*numOfLargePages = 0;
+	for (uint32 va = ROUNDUP((uint32)buf, PTSIZE); va + PTSIZE <= (uint32)buf + BENCH_TLB_SIZE; va += PTSIZE)
+		if (ptr_page_directory[PDX(va)] & PTE_PS)
+			(*numOfLargePages)++;
+
+	uint32 numOfPages = BENCH_TLB_SIZE / PAGE_SIZE;
+	uint32 wordsPerPage = PAGE_SIZE / sizeof(uint32);
+	volatile uint32 sum = 0;
+	//warm-up
+	for (uint32 p = 0; p < numOfPages; ++p)
+		buf[p * wordsPerPage] = p;
+	uint64 start = read_tsc();
+	for (int r = 0; r < BENCH_TLB_ROUNDS; ++r)
+		for (uint32 p = 0; p < numOfPages; ++p)
+			sum += buf[p * wordsPerPage + (r % wordsPerPage)];
+	uint32 cycles = (uint32)((read_tsc() - start) / (BENCH_TLB_ROUNDS * numOfPages));
+	kfree(buf);
+	return cycles;
+}
+
+//Same page-strided reads over the boot direct map [KERNEL_BASE + x => x] (read only): the 4 MB
+//aligned parts above its 1st 4 MB are mapped by 4 MB pages [see boot_map_range()] unless they're
+//split. RETURNS: the avg. cycles per read, or 0 if the direct map has no such part
+#define BENCH_TLB_DIRECT_MAP_MAX	(16*Mega)
+
+static uint32 bench_tlb_direct_map(uint32 *numOfLargePages, uint32 *size)
+{
+	uint32 start_va = KERNEL_BASE + PTSIZE;
+	uint32 end_va = ROUNDDOWN((uint32)ptr_free_mem, PTSIZE);
+	if (!USE_KHEAP)
+		end_va = KERNEL_BASE + PTSIZE + BENCH_TLB_DIRECT_MAP_MAX;
+	end_va = MIN(end_va, start_va + BENCH_TLB_DIRECT_MAP_MAX);
+	*numOfLargePages = 0;
+	*size = 0;
+	if (end_va <= start_va)
+		return 0;
+	*size = end_va - start_va;
+	for (uint32 va = start_va; va < end_va; va += PTSIZE)
+		if (ptr_page_directory[PDX(va)] & PTE_PS)
+			(*numOfLargePages)++;
+
+	uint32 numOfPages = *size / PAGE_SIZE;
+	uint32 wordsPerPage = PAGE_SIZE / sizeof(uint32);
+	volatile uint32 *buf = (uint32 *)start_va;
+	volatile uint32 sum = 0;
+	//warm-up
+	for (uint32 p = 0; p < numOfPages; ++p)
+		sum += buf[p * wordsPerPage];
+	uint64 start = read_tsc();
+	for (int r = 0; r < BENCH_TLB_ROUNDS; ++r)
+		for (uint32 p = 0; p < numOfPages; ++p)
+			sum += buf[p * wordsPerPage + (r % wordsPerPage)];
+	return (uint32)((read_tsc() - start) / (BENCH_TLB_ROUNDS * numOfPages));
+}
+
+int test_kheap_tlb_bench()
+{
+	uint32 oldState = get_kheap_large_pages();
+	uint32 cycles, numOfLargePages;
+	if (!pse_enabled)
+		cprintf_colored(TEXT_TESTERR_CLR,"\n	4 MB pages are not supported by this CPU: both runs use 4 KB pages\n");
+	cprintf_colored(TEXT_cyan,"\n	page-strided reads over %d MB (avg. cycles per read over %d rounds)\n", BENCH_TLB_SIZE/Mega, BENCH_TLB_ROUNDS);
+
+	set_kheap_large_pages(0);
+	cycles = bench_tlb_accesses(&numOfLargePages);
+	cprintf("	4 KB pages only : %4d cycles/read [%d 4MB pages]\n", cycles, numOfLargePages);
+
+	set_kheap_large_pages(1);
+	cycles = bench_tlb_accesses(&numOfLargePages);
+	cprintf("	with 4 MB pages : %4d cycles/read [%d 4MB pages]\n", cycles, numOfLargePages);
+
+	set_kheap_large_pages(oldState);
+
+	//the boot direct map: with its 4 MB pages, then split into 4 KB pages [merged back after]
+	uint32 size, numOfLargePagesBefore;
+	cycles = bench_tlb_direct_map(&numOfLargePagesBefore, &size);
+	if (size == 0)
+		cprintf_colored(TEXT_TESTERR_CLR,"\n	the direct map has no 4 MB aligned part above its 1st 4 MB: skipped\n");
+	else
+	{
+		cprintf_colored(TEXT_cyan,"\n	page-strided reads over %d MB of the direct map\n", size/Mega);
+		cprintf("	with 4 MB pages : %4d cycles/read [%d 4MB pages]\n", cycles, numOfLargePagesBefore);
+
+		for (uint32 va = KERNEL_BASE + PTSIZE; va < KERNEL_BASE + PTSIZE + size; va += PTSIZE)
+			split_kernel_large_page(va);
+		cycles = bench_tlb_direct_map(&numOfLargePages, &size);
+		cprintf("	4 KB pages only : %4d cycles/read [%d 4MB pages]\n", cycles, numOfLargePages);
+
+		uint32 numOfLargePagesAfter = 0;
+		for (uint32 va = KERNEL_BASE + PTSIZE; va < KERNEL_BASE + PTSIZE + size; va += PTSIZE)
+			numOfLargePagesAfter += merge_kernel_large_page(va);
+		if (numOfLargePagesAfter != numOfLargePagesBefore)
+			panic("test_kheap_tlb_bench: %d 4 MB pages of the direct map are merged back, %d expected", numOfLargePagesAfter, numOfLargePagesBefore);
+	}
+	cprintf_colored(TEXT_light_green,"\nKHEAP TLB benchmark completed.\n");
+	return 0;
+}
+
+//Allocates objects of a typed cache over several slabs and checks their alignment,
+//their constructed state after being recycled and that the empty slabs go back to kheap
+#define TST_CACHE_OBJ_SIZE	40
+#define TST_CACHE_NUM_OBJS	300
+static uint32 tst_cache_num_of_ctor_calls;
+static void tst_cache_ctor(void* obj)
+{
+	memset(obj, 0x5A, TST_CACHE_OBJ_SIZE);
+	tst_cache_num_of_ctor_calls++;
+}
+int test_kmem_cache()
+{
+	static uint8* objs[TST_CACHE_NUM_OBJS];
+	tst_cache_num_of_ctor_calls = 0;
+	uint32 freeFramesBefore = sys_calculate_free_frames();
+	struct kmem_cache* cache = kmem_cache_create("test cache", TST_CACHE_OBJ_SIZE, 0, tst_cache_ctor);
+	for (int round = 0; round < 2; ++round)
+	{
+		for (int i = 0; i < TST_CACHE_NUM_OBJS; ++i)
+		{
+			objs[i] = kmem_cache_alloc(cache);
+			if (objs[i] == NULL)
+				panic("test_kmem_cache: allocation #%d failed", i);
+			if ((uint32)objs[i] % KMEM_CACHE_LINE_SIZE != 0)
+				panic("test_kmem_cache: object %x is not aligned on a cache line", objs[i]);
+			for (int b = 0; b < TST_CACHE_OBJ_SIZE; ++b)
+				if (objs[i][b] != 0x5A)
+					panic("test_kmem_cache: object %x is not in its constructed state", objs[i]);
+			for (int j = 0; j < i; ++j)
+				if (objs[j] == objs[i])
+					panic("test_kmem_cache: object %x is allocated twice", objs[i]);
+		}
+		if (cache->stats.num_of_active_objs != TST_CACHE_NUM_OBJS)
+			panic("test_kmem_cache: wrong number of active objects");
+		for (int i = 0; i < TST_CACHE_NUM_OBJS; ++i)
+			kmem_cache_free(cache, objs[i]);
+	}
+	if (tst_cache_num_of_ctor_calls != cache->stats.num_of_grows * cache->objs_per_slab)
+		panic("test_kmem_cache: constructor should be called once per object of each new slab");
+	if (cache->stats.num_of_slabs > KMEM_MAX_EMPTY_SLABS)
+		panic("test_kmem_cache: %d empty slabs are kept (max = %d)", cache->stats.num_of_slabs, KMEM_MAX_EMPTY_SLABS);
+	kmem_cache_destroy(cache);
+	if (sys_calculate_free_frames() != freeFramesBefore)
+		panic("test_kmem_cache: frames are not freed after destroying the cache");
+
+	cprintf_colored(TEXT_light_green,"\nCongratulations!! test kmem_cache completed successfully.\n");
+	return 1;
+}
+
+
 /**********************************************************************************************/
 /******************************** OLD IMPLEMENTATION AREA *************************************/
 /**********************************************************************************************/
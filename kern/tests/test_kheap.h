@@ -22,6 +22,10 @@
  int test_kheap_phys_addr();
  int test_kheap_virt_addr();
  int test_fast_page_alloc();
+ int test_kheap_bench();
+ int test_kheap_lock_bench();
+ int test_kmem_cache();
+ int test_kheap_tlb_bench();
  int test_three_creation_functions();
  int test_ksbrk();
 
@@ -285,6 +285,11 @@ int tst_dyn_alloc(int number_of_arguments, char **arguments)
 	{
 		test_realloc_block();
 	}
+	// Test 9 Finer size classes: tst dynalloc fine
+	else if(strcmp(arguments[1], "fine") == 0)
+	{
+		test_fine_size_classes();
+	}
 	return 0;
 }
 
@@ -365,6 +370,16 @@ int tst_paging_manipulation(int number_of_arguments, char **arguments)
 	{
 		test_virtual_to_physical();
 	}
+	// Test 5-Buddy allocator of frames: tst pg buddy
+	else if(strcmp(arguments[1], "buddy") == 0)
+	{
+		test_frame_blocks();
+	}
+	// Test 6-Reverse mapping of frames: tst pg rmap
+	else if(strcmp(arguments[1], "rmap") == 0)
+	{
+		test_frame_rmap();
+	}
 	return 0;
 }
 
@@ -385,6 +400,26 @@ int tst_kheap(int number_of_arguments, char **arguments)
 		cprintf("Invalid number of arguments! USAGE: tst kheap <Strategy> fast\n") ;
 		return 0;
 	}
+	else if (strcmp(arguments[2], "locks") == 0 && number_of_arguments != 3)
+	{
+		cprintf("Invalid number of arguments! USAGE: tst kheap <Strategy> locks\n") ;
+		return 0;
+	}
+	else if (strcmp(arguments[2], "tlb") == 0 && number_of_arguments != 3)
+	{
+		cprintf("Invalid number of arguments! USAGE: tst kheap <Strategy> tlb\n") ;
+		return 0;
+	}
+	else if (strcmp(arguments[2], "kmemcache") == 0 && number_of_arguments != 3)
+	{
+		cprintf("Invalid number of arguments! USAGE: tst kheap <Strategy> kmemcache\n") ;
+		return 0;
+	}
+	else if (strcmp(arguments[2], "bench") == 0 && number_of_arguments != 3)
+	{
+		cprintf("Invalid number of arguments! USAGE: tst kheap <Strategy> bench\n") ;
+		return 0;
+	}
 	else if (strcmp(arguments[2], "kfree") == 0 && number_of_arguments != 4)
 	{
 		cprintf("Invalid number of arguments! USAGE: tst kheap <Strategy> kfree <both or blk or page>\n") ;
@@ -455,49 +490,76 @@ int tst_kheap(int number_of_arguments, char **arguments)
 		cprintf("Kernel Heap placement strategy is CUSTOM FIT\n");
 	}
 
+	// Lock acquisitions of small allocations per fault: tst kheap <Strategy> locks
+	if(strcmp(arguments[2], "locks") == 0)
+	{
+		test_kheap_lock_bench();
+		return 0;
+	}
+	// The following tests check the exact state of the dynamic allocator,
+	// so give back the blocks cached in the per-CPU magazines first (& restore them after)
+	uint32 oldMagazines = get_kheap_magazines();
+	set_kheap_magazines(0);
+	// Count what each kind of size classes would take for the blocks allocated by the test
+	uint32 oldClassStats = get_dyn_alloc_class_stats();
+	set_dyn_alloc_class_stats(1);
+	dynAllocStats.requested_bytes = dynAllocStats.pow2_class_bytes = dynAllocStats.fine_class_bytes = 0;
+
 	// Test 1-kmalloc: tst kheap <Strategy> kmalloc <allocator>
 	if(strcmp(arguments[2], "kmalloc") == 0)
 	{
 		test_kmalloc(testType);
-		return 0;
 	}
 	// Test Fast Implementation of kmalloc/kfree: tst kheap <Startegy> fast
 	else if(strcmp(arguments[2], "fast") == 0)
 	{
 		test_fast_page_alloc();
-		return 0;
+	}
+	// Reads over a big allocation with/without 4 MB pages: tst kheap <Strategy> tlb
+	else if(strcmp(arguments[2], "tlb") == 0)
+	{
+		test_kheap_tlb_bench();
+	}
+	// Typed object caches: tst kheap <Strategy> kmemcache
+	else if(strcmp(arguments[2], "kmemcache") == 0)
+	{
+		test_kmem_cache();
+	}
+	// Throughput of kmalloc/kfree with a fragmented page allocator: tst kheap <Strategy> bench
+	else if(strcmp(arguments[2], "bench") == 0)
+	{
+		test_kheap_bench();
 	}
 	// Test 2-kfree: tst kheap <Strategy> kfree <allocator>
 	else if(strcmp(arguments[2], "kfree") == 0)
 	{
 		test_kfree(testType);
-		return 0;
 	}
 	// Test 3-kphysaddr: tst kheap <Strategy> kphysaddr
 	// <Strategy> IS NEGLECTED
 	else if(strcmp(arguments[2], "kphysaddr") == 0)
 	{
 		test_kheap_phys_addr();
-		return 0;
 	}
 	// Test 4-kvirtaddr: tst kheap <Strategy> kvirtaddr
 	// <Strategy> IS NEGLECTED
 	else if(strcmp(arguments[2], "kvirtaddr") == 0)
 	{
 		test_kheap_virt_addr();
-		return 0;
 	}
 	// Test 5-krealloc: tst kheap <Strategy> krealloc <allocator>
 	else if(strcmp(arguments[2], "krealloc") == 0)
 	{
 		test_krealloc(testType);
-		return 0;
 	}
 	/*	// Test 6-sbr: tst kheap FF sbrk
 	else if (strcmp(arguments[2], "sbrk") == 0)
 	{
 		test_ksbrk();
 	}*/
+	print_size_classes_fragmentation();
+	set_dyn_alloc_class_stats(oldClassStats);
+	set_kheap_magazines(oldMagazines);
 	return 0;
 }
 
@@ -616,7 +616,8 @@ void scarce_memory()
 	int fflSize = 0;
 	acquire_kspinlock(&MemFrameLists.mfllock);
 	{
-		fflSize = LIST_SIZE(&MemFrameLists.free_frame_list);
+		struct freeFramesCounters counters = calculate_available_frames();
+		fflSize = counters.freeBuffered + counters.freeNotBuffered;
 
 		uint32 size_of_already_allocated = number_of_frames - fflSize ;
 		uint32 size_tobe_allocated = total_size_tobe_allocated - size_of_already_allocated;
@@ -982,6 +983,9 @@ uint32 check_va2pa(uint32 *ptr_page_directory, uint32 va)
 
 	if (!(*dirEntry & PERM_PRESENT))
 		return ~0;
+	//4 MB page [PSE]
+	if (*dirEntry & PTE_PS)
+		return ROUNDDOWN(*dirEntry, PTSIZE) + ROUNDDOWN(va % PTSIZE, PAGE_SIZE);
 	p = (uint32*) STATIC_KERNEL_VIRTUAL_ADDRESS(EXTRACT_ADDRESS(*dirEntry));
 
 	//LOG_VARS("ptr to page table  = %x", p);
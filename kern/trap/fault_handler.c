@@ -12,6 +12,7 @@
 #include <kern/disk/pagefile_manager.h>
 #include <kern/mem/memory_manager.h>
 #include <kern/mem/kheap.h>
+#include <kern/mem/kmem_cache.h>
 
 //2014 Test Free(): Set it to bypass the PAGE FAULT on an instruction with this length and continue executing the next one
 // 0 means don't bypass the PAGE FAULT
@@ -71,6 +72,11 @@ void fault_handler_init()
 	enableBuffering(0);
 	enableModifiedBuffer(0) ;
 	setModifiedBufferLength(1000);
+#if USE_KHEAP
+	wsElementCache = kmem_cache_create("WS elements", sizeof(struct WorkingSetElement), 0, NULL);
+	pageRefCache = kmem_cache_create("page references", sizeof(struct PageRefElement), 0, NULL);
+	rmapCache = kmem_cache_create("reverse mappings", sizeof(struct FrameMapping), 0, NULL);
+#endif
 }
 //==================
 // [1] MAIN HANDLER:
@@ -150,6 +156,15 @@ void fault_handler(struct Trapframe *tf)
 		print_trapframe(tf);
 		panic("faulted env == NULL!");
 	}
+	//a write to a present copy-on-write page [see env_fork()]: give the env its own copy
+	if ((tf->tf_err & FEC_WR) && fault_va < USER_TOP &&
+			(faulted_env->env_page_directory[PDX(fault_va)] & PERM_PRESENT) &&
+			(pt_get_page_permissions(faulted_env->env_page_directory, fault_va) & (PERM_PRESENT|PERM_COW)) == (PERM_PRESENT|PERM_COW))
+	{
+		faulted_env->cowFaultsCounter++ ;
+		cow_fault_handler(faulted_env, fault_va);
+		return;
+	}
 	//check the faulted address, is it a table or not ?
 	//If the directory entry of the faulted address is NOT PRESENT then
 	if ( (faulted_env->env_page_directory[PDX(fault_va)] & PERM_PRESENT) != PERM_PRESENT)
@@ -299,6 +314,9 @@ void fault_handler(struct Trapframe *tf)
 
 		// we have normal page fault =============================================================
 		faulted_env->pageFaultsCounter ++ ;
+		//minor (no page file read) & major faults are timed separately
+		uint32 nPageIn = faulted_env->nPageIn;
+		uint64 fault_start = read_tsc();
 
 //				cprintf("[%08s] user PAGE fault va %08x\n", faulted_env->prog_name, fault_va);
 //				cprintf("\nPage working set BEFORE fault handler...\n");
@@ -313,6 +331,17 @@ void fault_handler(struct Trapframe *tf)
 		{
 			page_fault_handler(faulted_env, fault_va);
 		}
+		uint32 fault_cycles = (uint32)(read_tsc() - fault_start);
+		if (faulted_env->nPageIn == nPageIn)
+		{
+			faulted_env->nMinorFaults++;
+			faulted_env->minorFaultsCycles += fault_cycles;
+		}
+		else
+		{
+			faulted_env->nMajorFaults++;
+			faulted_env->majorFaultsCycles += fault_cycles;
+		}
 
 		//		cprintf("\nPage working set AFTER fault handler...\n");
 		//		env_page_ws_print(faulted_env);
@@ -431,6 +460,52 @@ int get_optimal_num_faults(struct WS_List *initWorkingSet, int maxWSSize, struct
 }
 
 
+//Allocate & map a frame for the faulted page, then bring its content: read it from the page
+//file, or fill it with zeros if it's not there (i.e. first touch of a heap or stack page, so
+//never-touched heap pages are demand-zero [see calloc()]). Any other page that is not in the
+//page file is an invalid access: the env is exited.
+//A page marked PERM_NEVER_SWAPPED is known to have no copy in the page file, so it's given a
+//pre-zeroed frame directly without walking the disk page tables [see allocate_zeroed_frame()].
+//A read-only program page is mapped read-only on the frame shared by the program envs, and a
+//program page that's not in the page file is loaded from the program image [lazy loading].
+//No kernel memory is left to map the faulted page [see rmap_add()]: give back its new
+//frame & exit the env
+static void exit_on_no_kernel_mem(struct Env * faulted_env, struct FrameInfo *ptr_frame_info, uint32 va_page)
+{
+	free_frame(ptr_frame_info);
+	cprintf("[%s] no kernel memory left to map the page at %x\n", faulted_env->prog_name, va_page);
+	env_exit();
+}
+
+static void place_faulted_page(struct Env * faulted_env, uint32 fault_va)
+{
+	uint32 va_page = ROUNDDOWN(fault_va, PAGE_SIZE);
+	struct FrameInfo *ptr_frame_info = NULL;
+	if (va_page < USER_HEAP_START && map_shared_program_page(faulted_env, va_page))
+		return;
+	if (pt_get_page_permissions(faulted_env->env_page_directory, va_page) & PERM_NEVER_SWAPPED)
+	{
+		allocate_zeroed_frame(&ptr_frame_info);
+		if (map_frame(faulted_env->env_page_directory, ptr_frame_info, va_page, PERM_USER | PERM_WRITEABLE) != 0)
+			exit_on_no_kernel_mem(faulted_env, ptr_frame_info, va_page);
+		return;
+	}
+
+	allocate_frame(&ptr_frame_info);
+	if (map_frame(faulted_env->env_page_directory, ptr_frame_info, va_page, PERM_USER | PERM_WRITEABLE) != 0)
+		exit_on_no_kernel_mem(faulted_env, ptr_frame_info, va_page);
+	if (pf_read_env_page(faulted_env, (void*)va_page) != E_PAGE_NOT_EXIST_IN_PF)
+		return;
+	if (va_page < USER_HEAP_START && load_program_page(faulted_env, va_page, ptr_frame_info))
+		return;
+
+	int is_stack = (va_page >= USTACKBOTTOM) && (va_page < USTACKTOP);
+	int is_heap  = (va_page >= USER_HEAP_START) && (va_page < USER_HEAP_MAX);
+	if (!(is_stack || is_heap))
+		env_exit();
+	memset((void*)va_page, 0, PAGE_SIZE);
+}
+
 void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 {
 #if USE_KHEAP
@@ -452,28 +527,18 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 	          if (LIST_SIZE(&(faulted_env->page_WS_list)) >= faulted_env->page_WS_max_size)
 	          {
 	              struct WorkingSetElement *wse = LIST_FIRST(&(faulted_env->page_WS_list));
+	              tlb_batch_begin(faulted_env->env_page_directory);
 	              while (wse != NULL)
 	              {
 	                  struct WorkingSetElement *next_wse = LIST_NEXT(wse);
 	                  unmap_frame(faulted_env->env_page_directory, wse->virtual_address);
 	                  LIST_REMOVE(&(faulted_env->page_WS_list), wse);
-	                  kfree(wse);
+	                  env_page_ws_list_free_element(faulted_env, wse);
 	                  wse = next_wse;
 	              }
+	              tlb_batch_end();
 	          }
-	          struct FrameInfo *finfo = NULL;
-	          int ret_alloc = allocate_frame(&finfo);
-	          if (ret_alloc != 0)
-	          { panic("OPTIMAL: allocate_frame failed");}
-	          map_frame(faulted_env->env_page_directory, finfo, va_page, PERM_USER | PERM_WRITEABLE);
-	          int r = pf_read_env_page(faulted_env, (void*)va_page);
-	          if (r == E_PAGE_NOT_EXIST_IN_PF)
-	          {
-	              int is_stack = (va_page >= USTACKBOTTOM) && (va_page < USTACKTOP);
-	              int is_heap  = (va_page >= USER_HEAP_START) && (va_page < USER_HEAP_MAX);
-	              if (!(is_stack || is_heap))
-	                  env_exit();
-	          }
+	          place_faulted_page(faulted_env, va_page);
 	          struct WorkingSetElement *wse_new = env_page_ws_list_create_element(faulted_env, va_page);
 	          LIST_INSERT_TAIL(&(faulted_env->page_WS_list), wse_new);
 	          if (LIST_SIZE(&(faulted_env->page_WS_list)) == faulted_env->page_WS_max_size)
@@ -481,7 +546,7 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 	          else
 	              faulted_env->page_last_WS_element = NULL;
 	      }
-	      struct PageRefElement *pref_new = kmalloc(sizeof(struct PageRefElement));
+	      struct PageRefElement *pref_new = kmem_cache_alloc(pageRefCache);
 	      if (pref_new == NULL){
 	          panic("ERROR: Out of kernel heap space for PageRefElement");}
 	      pref_new->virtual_address = va_page;
@@ -498,26 +563,7 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 				//Your code is here
 				//Comment the following line
 				//panic("page_fault_handler().PLACEMENT is not implemented yet...!!");
-				struct FrameInfo* finfo=NULL;
-				int ret = allocate_frame(&finfo);
-				map_frame(faulted_env->env_page_directory,finfo,fault_va,PERM_USER|PERM_WRITEABLE);
-				if(ret != 0){
-					return;
-				}
-				else{
-					int ret2 = pf_read_env_page(faulted_env,(void *)fault_va);
-					if (ret2 == E_PAGE_NOT_EXIST_IN_PF)
-					{
-						int is_stack = (fault_va >= USTACKBOTTOM) && (fault_va < USTACKTOP);
-						int is_heap = (fault_va >= USER_HEAP_START) && (fault_va < USER_HEAP_MAX);
-						if(is_stack || is_heap)
-						{}
-						else
-						{
-							env_exit();
-						}
-					}
-				}
+				place_faulted_page(faulted_env, fault_va);
 				struct WorkingSetElement *new_wse = env_page_ws_list_create_element(faulted_env,fault_va);
 				LIST_INSERT_TAIL(&(faulted_env->page_WS_list),new_wse);
 				if (LIST_SIZE(&faulted_env->page_WS_list)== faulted_env->page_WS_max_size)
@@ -544,6 +590,8 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 			    if (victimWSElement == NULL)
 			        victimWSElement = LIST_FIRST(&(faulted_env->page_WS_list));
 
+			    //the used bits cleared by the sweep & the victim are flushed at once
+			    tlb_batch_begin(faulted_env->env_page_directory);
 			    while (1)
 			    {
 			        uint32 perms = pt_get_page_permissions(faulted_env->env_page_directory, victimWSElement->virtual_address);
@@ -573,24 +621,11 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 			    }
 
 			    unmap_frame(faulted_env->env_page_directory, victim_va);
+			    tlb_batch_end();
 			    LIST_REMOVE(&(faulted_env->page_WS_list), victimWSElement);
-			    kfree(victimWSElement);
-
-			    struct FrameInfo *finfo = NULL;
-			    int ret_alloc = allocate_frame(&finfo);
-			    if (ret_alloc != 0)
-			        panic("CLOCK: allocate_frame failed");
-
-			    map_frame(faulted_env->env_page_directory, finfo, va_page, PERM_USER | PERM_WRITEABLE);
+			    env_page_ws_list_free_element(faulted_env, victimWSElement);
 
-			    int r = pf_read_env_page(faulted_env, (void*)va_page);
-			    if (r == E_PAGE_NOT_EXIST_IN_PF)
-			    {
-			        int is_stack = (va_page >= USTACKBOTTOM) && (va_page < USTACKTOP);
-			        int is_heap  = (va_page >= USER_HEAP_START) && (va_page < USER_HEAP_MAX);
-			        if (!(is_stack || is_heap))
-			            env_exit();
-			    }
+			    place_faulted_page(faulted_env, va_page);
 
 			    struct WorkingSetElement *new_wse = env_page_ws_list_create_element(faulted_env, va_page);
 			    LIST_INSERT_TAIL(&(faulted_env->page_WS_list), new_wse);
@@ -627,14 +662,9 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 			          // ready to remove it from WS
 			          LIST_REMOVE(&faulted_env->page_WS_list,lru_victim);
 			          unmap_frame(faulted_env->env_page_directory,victim_addr);
-			          kfree(lru_victim);
-			          int ret = alloc_page(faulted_env->env_page_directory,fault_va,PERM_USER|PERM_PRESENT|PERM_WRITEABLE,0);
-			          if(ret != 0)
-			          {
-			            panic("failed to allocated page");
-			          }
-			          //READ FAULTED PAGE FROM PAGE FILE TO MEM
-			          pf_read_env_page(faulted_env,(void *)fault_va);
+			          env_page_ws_list_free_element(faulted_env, lru_victim);
+			          //ALLOCATE A FRAME & READ FAULTED PAGE FROM PAGE FILE TO MEM
+			          place_faulted_page(faulted_env, fault_va);
 			          // CREATE WS_ELEMENT AND ADD IT TO WS_LIST
 			          struct WorkingSetElement * faulted_page = env_page_ws_list_create_element(faulted_env,fault_va);
 			          LIST_INSERT_TAIL(&faulted_env->page_WS_list,faulted_page);
@@ -652,6 +682,8 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 			          struct WorkingSetElement * modi_victim = NULL;
 			          struct WorkingSetElement * cur_element ;
 			          bool isfound = 0;
+			          //the used bits cleared by the search & the victim are flushed at once
+			          tlb_batch_begin(faulted_env->env_page_directory);
 			          // TRY1 :  SEARCH FOR BEST_VICTIM
 			          LIST_FOREACH_SAFE(cur_element,&faulted_env->page_WS_list,WorkingSetElement)
 			          {    uint32 prems = pt_get_page_permissions(faulted_env->env_page_directory,cur_element->virtual_address);
@@ -711,14 +743,10 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 			          } // ready to remove it from WS
 			          LIST_REMOVE(&faulted_env->page_WS_list,modi_victim);
 			          unmap_frame(faulted_env->env_page_directory,victim_addr);
-			          kfree(modi_victim);
-			          int allocated = alloc_page(faulted_env->env_page_directory,fault_va,PERM_USER|PERM_PRESENT|PERM_WRITEABLE,0);
-			          if(allocated != 0)
-			          {
-
-			          }
-			          //READ FAULTED PAGE FROM PAGE FILE TO MEM
-			          pf_read_env_page(faulted_env,(void *)fault_va);
+			          tlb_batch_end();
+			          env_page_ws_list_free_element(faulted_env, modi_victim);
+			          //ALLOCATE A FRAME & READ FAULTED PAGE FROM PAGE FILE TO MEM
+			          place_faulted_page(faulted_env, fault_va);
 			          // CREATE WS_ELEMENT AND ADD IT TO WS_LIST
 			          struct WorkingSetElement * faulted_page = env_page_ws_list_create_element(faulted_env,fault_va);
 			          LIST_INSERT_TAIL(&faulted_env->page_WS_list,faulted_page);
@@ -731,6 +759,43 @@ void page_fault_handler(struct Env * faulted_env, uint32 fault_va)
 }
 
 
+//===============================
+// [4] COPY-ON-WRITE FAULT HANDLER:
+//===============================
+//The faulted page is present, read-only & marked PERM_COW: if its frame is still shared with
+//other env(s), copy it to a new private frame, otherwise (the last sharer) just take it back.
+//Either way, the page becomes writable again.
+void cow_fault_handler(struct Env * faulted_env, uint32 fault_va)
+{
+	uint32 va_page = ROUNDDOWN(fault_va, PAGE_SIZE);
+	uint32 *ptr_page_table;
+	struct FrameInfo *ptr_shared_frame = get_frame_info(faulted_env->env_page_directory, va_page, &ptr_page_table);
+	if (ptr_shared_frame->references == 1)
+	{
+		pt_set_page_permissions(faulted_env->env_page_directory, va_page, PERM_WRITEABLE, PERM_COW);
+		return;
+	}
+
+	struct FrameInfo *ptr_frame_info = NULL;
+	allocate_frame(&ptr_frame_info);
+	if (rmap_add(ptr_frame_info, faulted_env->env_page_directory, va_page) != 0)
+		exit_on_no_kernel_mem(faulted_env, ptr_frame_info, va_page);
+	//the frames may be outside the kernel direct map: copy through temp. mappings
+	void *dst_va = kmap_frame(ptr_frame_info);
+	void *src_va = kmap_frame(ptr_shared_frame);
+	memcpy(dst_va, src_va, PAGE_SIZE);
+	kunmap_frame(src_va);
+	kunmap_frame(dst_va);
+
+	uint32 perms = (ptr_page_table[PTX(va_page)] & 0xFFF & ~PERM_COW) | PERM_WRITEABLE;
+	ptr_page_table[PTX(va_page)] = CONSTRUCT_ENTRY(to_physical_address(ptr_frame_info), perms);
+	ptr_frame_info->references = 1;
+	ptr_frame_info->base_virual_address = va_page;
+	rmap_remove(ptr_shared_frame, faulted_env->env_page_directory, va_page);
+	decrement_references(ptr_shared_frame);
+	tlb_invalidate(faulted_env->env_page_directory, (void*)va_page);
+}
+
 void __page_fault_handler_with_buffering(struct Env * curenv, uint32 fault_va)
 {
 	panic("this function is not required...!!");
@@ -32,6 +32,10 @@ bool FASTNchanceCLOCK ;
 
 /*2021*/ int page_WS_max_sweeps;
 
+//Object caches of the fault path [created in fault_handler_init()]
+struct kmem_cache* wsElementCache;
+struct kmem_cache* pageRefCache;
+
 extern uint8 bypassInstrLength ;
 
 /******************************/
@@ -76,5 +80,6 @@ void __page_fault_handler_with_buffering(struct Env * curenv, uint32 fault_va);
 void dyn_alloc_local_scope_method(struct Env * curenv, uint32 fault_va);
 void page_fault_handler(struct Env * curenv, uint32 fault_va);
 void table_fault_handler(struct Env * curenv, uint32 fault_va);
+void cow_fault_handler(struct Env * curenv, uint32 fault_va);
 /*2025*/ int get_optimal_num_faults(struct WS_List *initWorkingSet, int maxWSSize, struct PageRef_List *pageReferences);
 #endif /* KERN_FAULT_HANDLER_H_ */
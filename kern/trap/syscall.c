@@ -16,6 +16,7 @@
 #include <kern/disk/pagefile_manager.h>
 #include <kern/mem/memory_manager.h>
 #include <kern/mem/shared_memory_manager.h>
+#include <kern/mem/kheap.h>
 #include <kern/tests/utilities.h>
 #include <kern/tests/test_working_set.h>
 
@@ -251,7 +252,8 @@ void sys_clearFFL()
 	int size;
 	acquire_kspinlock(&MemFrameLists.mfllock);
 	{
-		size = LIST_SIZE(&MemFrameLists.free_frame_list) ;
+		struct freeFramesCounters counters = calculate_available_frames();
+		size = counters.freeBuffered + counters.freeNotBuffered ;
 		struct FrameInfo* ptr_tmp_FI ;
 		for (int i = 0; i < size ; i++)
 		{
@@ -286,6 +288,11 @@ void sys_free_user_mem(uint32 virtual_address, uint32 size)
 		cprintf("\nsys_free_user_mem(): ILLEGAL ADDRESS! Process will be terminated...\n");
 		env_exit();
 	}
+	if (overlaps_user_break(cur_env, virtual_address, size))
+	{
+		cprintf("\nsys_free_user_mem(): RANGE BELOW THE SBRK BREAK! Process will be terminated...\n");
+		env_exit();
+	}
 
 	if(isBufferingEnabled())
 	{
@@ -309,10 +316,29 @@ void sys_allocate_user_mem(uint32 virtual_address, uint32 size)
 		cprintf("\nsys_free_user_mem(): ILLEGAL ADDRESS! Process will be terminated...\n");
 		env_exit();
 	}
+	if (overlaps_user_break(cur_env, virtual_address, size))
+	{
+		cprintf("\nsys_allocate_user_mem(): RANGE BELOW THE SBRK BREAK! Process will be terminated...\n");
+		env_exit();
+	}
 	allocate_user_mem(cur_env, virtual_address, size);
 	return;
 }
 
+//Free several ranges of the user heap in one call [see the arenas of lib/uheap.c]
+int sys_free_user_mem_ranges(struct UserMemRange* ranges, uint32 count)
+{
+	if (count > UHEAP_MAX_PENDING_RANGES || ranges == NULL || (uint32)ranges >= USER_TOP
+			|| (uint32)ranges + count * sizeof(struct UserMemRange) > USER_TOP)
+		return E_INVAL;
+	//copy the ranges into the kernel before freeing any of them
+	struct UserMemRange batch[UHEAP_MAX_PENDING_RANGES];
+	memcpy(batch, ranges, count * sizeof(struct UserMemRange));
+	for (uint32 i = 0; i < count; ++i)
+		sys_free_user_mem(batch[i].virtual_address, batch[i].size);
+	return 0;
+}
+
 void sys_allocate_chunk(uint32 virtual_address, uint32 size, uint32 perms)
 {
 	struct Env* cur_env = get_cpu_proc();
@@ -328,6 +354,18 @@ void sys_move_user_mem(uint32 src_virtual_address, uint32 dst_virtual_address, u
 	struct Env* cur_env = get_cpu_proc();
 	assert(cur_env != NULL);
 
+	if (src_virtual_address < USER_HEAP_START || dst_virtual_address < USER_HEAP_START
+		|| size >= USER_HEAP_MAX - USER_HEAP_START
+		|| src_virtual_address + size >= USER_HEAP_MAX || dst_virtual_address + size >= USER_HEAP_MAX)
+	{
+		cprintf("\nsys_move_user_mem(): ILLEGAL ADDRESS! Process will be terminated...\n");
+		env_exit();
+	}
+	if (overlaps_user_break(cur_env, src_virtual_address, size) || overlaps_user_break(cur_env, dst_virtual_address, size))
+	{
+		cprintf("\nsys_move_user_mem(): RANGE BELOW THE SBRK BREAK! Process will be terminated...\n");
+		env_exit();
+	}
 	move_user_mem(cur_env, src_virtual_address, dst_virtual_address, size);
 	return;
 }
@@ -481,6 +519,19 @@ int sys_create_env(char* programName, unsigned int page_WS_size,unsigned int LRU
 	return env->env_id;
 }
 
+//Create a copy-on-write copy of the current env & place it into the NEW queue
+int sys_fork()
+{
+	struct Env* env = env_fork(get_cpu_proc());
+	if(env == NULL)
+	{
+		return E_ENV_CREATION_ERROR;
+	}
+	sched_new_env(env);
+
+	return env->env_id;
+}
+
 //Place a new env into the READY queue
 void sys_run_env(int32 envId)
 {
@@ -510,6 +561,23 @@ int sys_get_optimal_num_faults()
 	return 0;
 }
 
+//Copy a snapshot of the kernel heap counters to the given user buffer
+int sys_get_kheap_stats(struct KHeapStats* stats)
+{
+#if USE_KHEAP
+	if (stats == NULL || (uint32)stats >= USER_TOP || (uint32)stats + sizeof(struct KHeapStats) > USER_TOP)
+		return E_INVAL;
+	//take it in the kernel first: the user buffer may fault while the kheap lock is held
+	struct KHeapStats snapshot;
+	get_kheap_stats(&snapshot);
+	memcpy(stats, &snapshot, sizeof(snapshot));
+	return 0;
+#else
+	panic("MUST ENABLE KHEAP");
+#endif
+	return 0;
+}
+
 //====================================
 /*******************************/
 /* ETC... SYSTEM CALLS */
@@ -647,6 +715,9 @@ uint32 syscall(uint32 syscallno, uint32 a1, uint32 a2, uint32 a3, uint32 a4, uin
 		sys_run_env((int32)a1);
 		return 0;
 		break;
+	case SYS_fork:
+		return sys_fork();
+		break;
 	case SYS_getenvindex:
 		return sys_getenvindex();
 		break;
@@ -726,6 +797,15 @@ uint32 syscall(uint32 syscallno, uint32 a1, uint32 a2, uint32 a3, uint32 a4, uin
 	case SYS_get_optimal_num_faults:
 		return sys_get_optimal_num_faults();
 
+	case SYS_get_kheap_stats:
+		return sys_get_kheap_stats((struct KHeapStats*)a1);
+
+	case SYS_free_user_mem_ranges:
+		return sys_free_user_mem_ranges((struct UserMemRange*)a1, a2);
+
+	case SYS_sbrk:
+		return (uint32)sys_sbrk((int)a1);
+
 	case NSYSCALLS:
 		return 	-E_INVAL;
 		break;
@@ -6,6 +6,7 @@
  */
 #include <inc/assert.h>
 #include <inc/string.h>
+#include <inc/stdio.h>
 #include "../inc/dynamic_allocator.h"
 
 //==================================================================================//
@@ -72,20 +73,92 @@ int get_nearst_power_of_2(uint32 size)
     return 0;
 }
 
+//*****************
+// Size classes:
+//*********************
+// Block size of each freeBlockLists index: power of 2 sizes first (so their index stays
+// log2(size) - LOG2_MIN_SIZE), then the ones in between [used by DA_SIZE_CLASSES_FINE only]
+static const uint16 classSizes[DYN_ALLOC_NUM_OF_SIZES] =
+{
+	8, 16, 32, 64, 128, 256, 512, 1024, 2048,
+	24, 40, 48, 56, 80, 96, 112, 160, 192, 224,
+	320, 384, 448, 640, 768, 896, 1280, 1536, 1792
+};
+
+// Size to class lookup tables of both kinds of classes, indexed by ROUNDUP(size, 8) / 8
+#define SIZE_TO_CLASS_ENTRIES (DYN_ALLOC_MAX_BLOCK_SIZE / DYN_ALLOC_MIN_BLOCK_SIZE + 1)
+static uint8 sizeToClass[2][SIZE_TO_CLASS_ENTRIES];
+static uint32 activeSizeClasses = DA_SIZE_CLASSES_POW2;
+
+static void build_size_class_tables()
+{
+	for (int kind = DA_SIZE_CLASSES_POW2; kind <= DA_SIZE_CLASSES_FINE; kind++)
+	{
+		int num_of_classes = (kind == DA_SIZE_CLASSES_POW2) ? DYN_ALLOC_NUM_OF_POW2_SIZES : DYN_ALLOC_NUM_OF_SIZES;
+		sizeToClass[kind][0] = 0;
+		for (int e = 1; e < SIZE_TO_CLASS_ENTRIES; e++)
+		{
+			uint32 size = e * DYN_ALLOC_MIN_BLOCK_SIZE;
+			int best = -1;
+			for (int i = 0; i < num_of_classes; i++)
+			{
+				if (classSizes[i] >= size && (best == -1 || classSizes[i] < classSizes[best]))
+					best = i;
+			}
+			sizeToClass[kind][e] = best;
+		}
+	}
+}
+
+static inline int class_of(uint32 kind, uint32 size)
+{
+	return sizeToClass[kind][(size + DYN_ALLOC_MIN_BLOCK_SIZE - 1) >> LOG2_MIN_SIZE];
+}
+
 // Get the index in freeBlockLists
 int get_block_list_idx(uint32 size)
 {
-    if (size > 0)
+    if (size == 0 || size > DYN_ALLOC_MAX_BLOCK_SIZE)
+        return 0;
+    return class_of(activeSizeClasses, size);
+}
+
+// Get the block size that's given to a request of "size"
+uint32 get_size_class(uint32 size)
+{
+    if (size == 0)
+        return 0;
+    return classSizes[get_block_list_idx(size)];
+}
+
+uint32 get_block_class_size(int idx)
+{
+    return classSizes[idx];
+}
+
+static uint32 percentage(uint32 part, uint32 whole)
+{
+    if (whole == 0)
+        return 0;
+    //avoid overflowing part * 100
+    return whole < (1 << 24) ? (part * 100) / whole : part / (whole / 100);
+}
+
+// Compare the internal fragmentation of all the block allocations so far under both kinds of classes
+void print_size_classes_fragmentation()
+{
+    if (!dynAllocClassStats)
     {
-        for (int i = LOG2_MIN_SIZE; i <= LOG2_MAX_SIZE; i++)
-        {
-            if (clc_pow(2, i) >= size)
-            {
-                return (i - LOG2_MIN_SIZE); // Start from index 0
-            }
-        }
+        cprintf("Size classes statistics are disabled\n");
+        return;
     }
-    return 0;
+    uint32 requested = dynAllocStats.requested_bytes;
+    cprintf("Block allocations so far: requested = %d bytes [current classes: %s]\n", requested,
+            activeSizeClasses == DA_SIZE_CLASSES_FINE ? "FINE" : "POWER OF 2");
+    cprintf("  power of 2 classes: %d bytes, internal fragmentation = %d%%\n", dynAllocStats.pow2_class_bytes,
+            percentage(dynAllocStats.pow2_class_bytes - requested, dynAllocStats.pow2_class_bytes));
+    cprintf("  fine classes      : %d bytes, internal fragmentation = %d%%\n", dynAllocStats.fine_class_bytes,
+            percentage(dynAllocStats.fine_class_bytes - requested, dynAllocStats.fine_class_bytes));
 }
 
 // get page index
@@ -101,6 +174,7 @@ void *case_1(int idx_block_list){
 
     // Remove this block from free block list
     LIST_REMOVE(&freeBlockLists[idx_block_list], block);
+    dynAllocStats.num_of_live_blocks[idx_block_list]++;
 
     // Update el free blocks num
     int pageIndex = get_page_index(block_va);
@@ -151,6 +225,11 @@ void initialize_dynamic_allocator(uint32 daStart, uint32 daEnd)
 
     // initialize FreePagesList
     LIST_INIT(&freePagesList);
+    memset(&dynAllocStats, 0, sizeof(dynAllocStats));
+
+    // size classes: the lookup tables & the kind to use
+    build_size_class_tables();
+    activeSizeClasses = (dynAllocSizeClasses == DA_SIZE_CLASSES_FINE) ? DA_SIZE_CLASSES_FINE : DA_SIZE_CLASSES_POW2;
 
     // initialize pages
     	// and add to free pages list
@@ -166,9 +245,9 @@ void initialize_dynamic_allocator(uint32 daStart, uint32 daEnd)
     }
 
     // initialize all FreeBlockLists
-    // BLOCK_SIZES {8, 16, 32, 64, 128, 256, 512, 1024, 2048}
+    // BLOCK_SIZES {8, 16, 32, 64, 128, 256, 512, 1024, 2048, [FINE: 24, 40, 48, 56, 80, ...]}
 
-    numBlockSizes = LOG2_MAX_SIZE - LOG2_MIN_SIZE + 1; // 9
+    numBlockSizes = DYN_ALLOC_NUM_OF_SIZES;
     for (int i = 0; i < numBlockSizes; i++)
     {
         LIST_INIT(&freeBlockLists[i]);
@@ -217,9 +296,16 @@ void *alloc_block(uint32 size)
         return NULL;
     }
 
-    // get nearest power of 2
-    uint32 new_size = get_nearst_power_of_2(size);
-    int idx_block_list = get_block_list_idx(new_size);
+    // get the size class
+    int idx_block_list = get_block_list_idx(size);
+    uint32 new_size = classSizes[idx_block_list];
+
+    if (dynAllocClassStats)
+    {
+        dynAllocStats.requested_bytes += size;
+        dynAllocStats.pow2_class_bytes += classSizes[class_of(DA_SIZE_CLASSES_POW2, size)];
+        dynAllocStats.fine_class_bytes += classSizes[class_of(DA_SIZE_CLASSES_FINE, size)];
+    }
 
     // CASE 1: if a free block exists
     if (LIST_SIZE(&freeBlockLists[idx_block_list]) > 0)
@@ -251,6 +337,7 @@ void *alloc_block(uint32 size)
         // Initialize page info
         page->num_of_free_blocks = block_num;
         page->block_size = new_size;
+        dynAllocStats.num_of_pages[idx_block_list]++;
 
         // Split page to blocks
         // add them to free list
@@ -264,17 +351,23 @@ void *alloc_block(uint32 size)
         return case_1(idx_block_list);
     }
 
-    // CASE 3: else, allocate block from the next list(s)
+    // CASE 3: else, allocate block from the smallest larger class that has a free block
     else
     {
-        for (int i = idx_block_list + 1; i < numBlockSizes; i++)
+        int found = -1;
+        for (int i = 0; i < numBlockSizes; i++)
         {
-            if (LIST_SIZE(&freeBlockLists[i]) > 0)
+            if (classSizes[i] > new_size && LIST_SIZE(&freeBlockLists[i]) > 0
+                    && (found == -1 || classSizes[i] < classSizes[found]))
             {
-            	// use case 1 to get block
-            	return case_1(i);
+                found = i;
             }
         }
+        if (found != -1)
+        {
+            // use case 1 to get block
+            return case_1(found);
+        }
 
         // CASE 4: No memory available
         panic("alloc_block: Out of memory!");
@@ -318,12 +411,13 @@ void free_block(void *va)
 
     // increment num of free blocks
     pageBlockInfoArr[page_index].num_of_free_blocks += 1;
+    dynAllocStats.num_of_live_blocks[list_index]--;
 
     int free_blocks = pageBlockInfoArr[page_index].num_of_free_blocks;
 
     // if page become free
     // remove all blocks from free block list
-    if (free_blocks*block_size == PAGE_SIZE)
+    if (free_blocks == PAGE_SIZE / block_size)
     {
         uint32 page_va = to_page_va(&pageBlockInfoArr[page_index]);
 
@@ -336,6 +430,7 @@ void free_block(void *va)
 
         // return el page (free page)
         return_page((void *)page_va);
+        dynAllocStats.num_of_pages[list_index]--;
 
         // reset page info and add it to free page list
         init_page(page_index);
@@ -353,7 +448,24 @@ void free_block(void *va)
 void *realloc_block(void* va, uint32 new_size)
 {
 	//TODO: [PROJECT'25.BONUS#2] KERNEL REALLOC - realloc_block
-	//Your code is here
-	//Comment the following line
-	panic("realloc_block() Not implemented yet");
+	if (va == NULL)
+		return alloc_block(new_size);
+	if (new_size == 0)
+	{
+		free_block(va);
+		return NULL;
+	}
+
+	// still in the same size class: keep it in place
+	uint32 old_size = get_block_size(va);
+	if (get_size_class(new_size) == old_size)
+		return va;
+
+	void *new_va = alloc_block(new_size);
+	if (new_va != NULL)
+	{
+		memcpy(new_va, va, MIN(old_size, new_size));
+		free_block(va);
+	}
+	return new_va;
 }
@@ -9,6 +9,15 @@ volatile struct Env *myEnv = NULL;
 volatile bool printStats = 1;
 
 volatile char *binaryname = "(PROGRAM NAME UNKNOWN)";
+
+//Average of the given total cycles (in 64-cycle units to avoid a 64-bit division)
+static uint32 avg_fault_cycles(uint64 total_cycles, uint32 num_of_faults)
+{
+	if (num_of_faults == 0)
+		return 0;
+	return ((uint32)(total_cycles >> 6) / num_of_faults) << 6;
+}
+
 void
 libmain(int argc, char **argv)
 {
@@ -48,9 +57,14 @@ libmain(int argc, char **argv)
 			{
 				cprintf("Num of PAGE faults = %d, modif = %d\n", myEnv->pageFaultsCounter, myEnv->nModifiedPages);
 				cprintf("# PAGE IN (from disk) = %d, # PAGE OUT (on disk) = %d, # NEW PAGE ADDED (on disk) = %d\n", myEnv->nPageIn, myEnv->nPageOut,myEnv->nNewPageAdded);
+				cprintf("# MINOR faults = %d (avg %d cycles), # MAJOR faults = %d (avg %d cycles)\n",
+						myEnv->nMinorFaults, avg_fault_cycles(myEnv->minorFaultsCycles, myEnv->nMinorFaults),
+						myEnv->nMajorFaults, avg_fault_cycles(myEnv->majorFaultsCycles, myEnv->nMajorFaults));
 			}
 			//cprintf("Num of freeing scarce memory = %d, freeing full working set = %d\n", myEnv->freeingScarceMemCounter, myEnv->freeingFullWSCounter);
 			cprintf("Num of clocks = %d\n", myEnv->nClocks);
+			if (uheap_syscalls_saved() != 0)
+				cprintf("# USER HEAP syscalls = %d, saved by arenas = %d\n", uheapStats.num_of_syscalls, uheap_syscalls_saved());
 			cprintf("**************************************\n");
 		}
 		sys_unlock_cons();
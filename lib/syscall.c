@@ -146,6 +146,16 @@ int sys_create_env(char* programName, unsigned int page_WS_size,unsigned int LRU
 	return syscall(SYS_create_env,(uint32)programName, (uint32)page_WS_size,(uint32)LRU_second_list_size, (uint32)percent_WS_pages_to_remove, 0);
 }
 
+//Returns the env id of the (not yet running) child to the parent & 0 to the child
+int sys_fork(void)
+{
+	int ret = syscall(SYS_fork, 0, 0, 0, 0, 0);
+	//the child starts with a copy of the parent's data: point it to its own env
+	if (ret == 0)
+		myEnv = &(envs[sys_getenvindex()]);
+	return ret;
+}
+
 void sys_run_env(int32 envId)
 {
 	syscall(SYS_run_env, (int32)envId, 0, 0, 0, 0);
@@ -273,6 +283,11 @@ int sys_get_optimal_num_faults()
 	return syscall(SYS_get_optimal_num_faults, 0, 0, 0, 0, 0);
 }
 
+int sys_get_kheap_stats(struct KHeapStats* stats)
+{
+	return syscall(SYS_get_kheap_stats, (uint32)stats, 0, 0, 0, 0);
+}
+
 void sys_free_user_mem(uint32 virtual_address, uint32 size)
 {
 	syscall(SYS_free_user_mem, virtual_address, size, 0, 0, 0);
@@ -285,6 +300,16 @@ void sys_allocate_user_mem(uint32 virtual_address, uint32 size)
 	return ;
 }
 
+void* sys_sbrk(int numOfPages)
+{
+	return (void*)syscall(SYS_sbrk, (uint32)numOfPages, 0, 0, 0, 0);
+}
+
+int sys_free_user_mem_ranges(struct UserMemRange* ranges, uint32 count)
+{
+	return syscall(SYS_free_user_mem_ranges, (uint32)ranges, count, 0, 0, 0);
+}
+
 
 void sys_env_set_priority(int32 envID, int priority)
 {
@@ -49,213 +49,685 @@ void return_page(void* va)
 
 
 struct Segment {
-	uint32 size;
+	uint32 size_in_number_of_pages;
 	uint32 base_address;
+	uint32 is_used;
 	LIST_ENTRY(Segment) prev_next_info;
 };
 
-struct Segment *new_Seg;
+LIST_HEAD(SegmentList, Segment);
 
-//for allocated
-LIST_HEAD(SegmentInfoElement_List, Segment);
-struct SegmentInfoElement_List segments_list;
+//==============================================
+// PAGE ALLOCATOR INDEX:
+//==============================================
+//Same index as the kernel heap [kern/mem/kheap.c]: free segments are kept in
+//size-segregated bins: bins [1..UHEAP_EXACT_BINS-1] hold segments of exactly that
+//number of pages, the rest hold power-of-2 ranges [2^k, 2^(k+1)). A bitmap of the
+//non-empty bins gives the first/largest usable bin in O(1).
+//Each bin is indexed by address (a page map of the first pages of its segments) for
+//the first/next fit, and the free segments are also listed by their exact size with
+//a page map of the non-empty sizes for the exact/best/worst fit.
+//Every segment (free or used) is also tagged at its first & last page so that free()
+//finds its segment and both of its neighbors in O(1) instead of walking the lists.
+//Over the whole user heap, the tags, the size lists & the words of the page maps would
+//take more than 1 MB of each program, so they are kept in leaves of one max-size block
+//of the dynamic allocator that are allocated on the first use of their range.
+#define UHEAP_EXACT_BINS	16
+#define UHEAP_NUM_BINS		32
+#define UHEAP_TAGS_PER_LEAF	(DYN_ALLOC_MAX_BLOCK_SIZE / sizeof(struct Segment*))
+#define UHEAP_NUM_LEAVES	(NUM_OF_UHEAP_PAGES / UHEAP_TAGS_PER_LEAF)
+
+//Two-level bitmap of NUM_OF_UHEAP_PAGES bits: a bit of summary[] is set if the
+//corresponding word is not zero (i.e. its leaf is allocated), so a set bit is found
+//in at most UHEAP_MAP_SUMMARY_WORDS steps
+#define UHEAP_MAP_WORDS				((NUM_OF_UHEAP_PAGES + 31) / 32)
+#define UHEAP_MAP_SUMMARY_WORDS		((UHEAP_MAP_WORDS + 31) / 32)
+#define UHEAP_MAP_WORDS_PER_LEAF	(DYN_ALLOC_MAX_BLOCK_SIZE / sizeof(uint32))
+#define UHEAP_MAP_LEAVES			((UHEAP_MAP_WORDS + UHEAP_MAP_WORDS_PER_LEAF - 1) / UHEAP_MAP_WORDS_PER_LEAF)
+struct UHeapPageMap {
+	uint32 summary[UHEAP_MAP_SUMMARY_WORDS];
+	uint32* leaves[UHEAP_MAP_LEAVES];
+};
 
-//for free
-LIST_HEAD(SegmentfreeElement_List, Segment);
-struct SegmentfreeElement_List free_segments_list;
+uint32 uheap_bins_bitmap = 0;
+uint32 uheap_bin_counts[UHEAP_NUM_BINS];
+struct UHeapPageMap uheap_bin_maps[UHEAP_NUM_BINS];	//first page index of the free segments of each bin
+struct UHeapPageMap uheap_size_map;						//sizes that have a free segment
+struct Segment** uheap_size_lists[UHEAP_NUM_LEAVES];	//free segments of each size
+struct Segment** uheap_seg_tags[UHEAP_NUM_LEAVES];
+uint32 uheap_next_fit_va = 0;
 
+static inline uint32 uheap_page_index(uint32 va)
+{
+	return (va - USER_HEAP_START) >> PGSHIFT;
+}
 
-static void *custom_fit(uint32 rounded_size)
+static inline uint32 segment_end(struct Segment* seg)
 {
-    // ========================================================================
-    // STEP 1: Try EXACT FIT in free segments list
-    // ========================================================================
-    struct Segment *seg;
-    LIST_FOREACH(seg, &free_segments_list)
-    {
-        if (seg->size == rounded_size)
-        {
-            uint32 va_address = seg->base_address;
+	return seg->base_address + seg->size_in_number_of_pages * PAGE_SIZE;
+}
 
-            // Remove from free list (exact fit - use entire segment)
-            LIST_REMOVE(&free_segments_list, seg);
+static inline uint32 uheap_bin_of(uint32 num_of_pages)
+{
+	if (num_of_pages < UHEAP_EXACT_BINS)
+		return num_of_pages;
+	//log2(num_of_pages) >= 4 here
+	return UHEAP_EXACT_BINS + (31 - __builtin_clz(num_of_pages)) - 4;
+}
 
-            return (void *)va_address;
-        }
-    }
+static void* new_index_leaf()
+{
+	void* leaf = alloc_block(DYN_ALLOC_MAX_BLOCK_SIZE);
+	if (leaf == NULL)
+		panic("new_index_leaf() in user: no memory for the page allocator index");
+	memset(leaf, 0, DYN_ALLOC_MAX_BLOCK_SIZE);
+	return leaf;
+}
 
-    // ========================================================================
-    // STEP 2: Try WORST FIT (largest block that fits)
-    // ========================================================================
-    struct Segment *worst_seg = NULL;
-    uint32 biggest_size = 0;
+//Entry idx of an array of segments over the user heap pages (tags or size lists)
+static inline struct Segment* get_entry(struct Segment*** leaves, uint32 idx)
+{
+	struct Segment** leaf = leaves[idx / UHEAP_TAGS_PER_LEAF];
+	if (leaf == NULL)
+		return NULL;
+	return leaf[idx % UHEAP_TAGS_PER_LEAF];
+}
 
-    // Find the segment with the LARGEST size that can fit our allocation
-    LIST_FOREACH(seg, &free_segments_list)
-    {
-        if (seg->size >= rounded_size && seg->size > biggest_size)
-        {
-            biggest_size = seg->size;
-            worst_seg = seg;
-        }
-    }
+static void set_entry(struct Segment*** leaves, uint32 idx, struct Segment* seg)
+{
+	struct Segment** leaf = leaves[idx / UHEAP_TAGS_PER_LEAF];
+	if (leaf == NULL)
+	{
+		if (seg == NULL)
+			return;
+		leaf = leaves[idx / UHEAP_TAGS_PER_LEAF] = new_index_leaf();
+	}
+	leaf[idx % UHEAP_TAGS_PER_LEAF] = seg;
+}
 
-    // If worst fit block found
-    if (worst_seg != NULL)
-    {
-        uint32 alloc_address = worst_seg->base_address;
+static inline struct Segment* get_tag(uint32 va)
+{
+	return get_entry(uheap_seg_tags, uheap_page_index(va));
+}
 
-        // Adjust the segment (allocate from the BEGINNING)
-        worst_seg->base_address += rounded_size;
-        worst_seg->size -= rounded_size;
+static inline void set_tag(uint32 va, struct Segment* seg)
+{
+	set_entry(uheap_seg_tags, uheap_page_index(va), seg);
+}
 
-        // If segment becomes empty after allocation, remove it
-        if (worst_seg->size == 0)
-        {
-            LIST_REMOVE(&free_segments_list, worst_seg);
-        }
+static inline void set_segment_tags(struct Segment* seg)
+{
+	set_tag(seg->base_address, seg);
+	set_tag(segment_end(seg) - PAGE_SIZE, seg);
+}
 
-        return (void *)alloc_address;
-    }
+//Only the first & last pages of the live segments are tagged: tags are cleared
+//before a segment is resized, merged or released (its descriptor is freed)
+static inline void clear_segment_tags(struct Segment* seg)
+{
+	set_tag(seg->base_address, NULL);
+	set_tag(segment_end(seg) - PAGE_SIZE, NULL);
+}
 
-    // ========================================================================
-    // STEP 3: Extend the heap break
-    // ========================================================================
+static inline struct Segment* segment_starting_at(uint32 va)
+{
+	if (va < uheapPageAllocStart || va >= uheapPageAllocBreak)
+		return NULL;
+	struct Segment* seg = get_tag(va);
+	if (seg == NULL || seg->base_address != va)
+		return NULL;
+	return seg;
+}
 
-    // Check if we have enough space to extend
-    if ((uheapPageAllocBreak + rounded_size) > USER_HEAP_MAX)
-    {
-        return NULL; // Heap is full
-    }
+static inline struct Segment* segment_ending_at(uint32 va)
+{
+	if (va <= uheapPageAllocStart || va > uheapPageAllocBreak)
+		return NULL;
+	struct Segment* seg = get_tag(va - PAGE_SIZE);
+	if (seg == NULL || segment_end(seg) != va)
+		return NULL;
+	return seg;
+}
 
-    // Allocate by extending the break
-    uint32 alloc_address = uheapPageAllocBreak;
-    uheapPageAllocBreak += rounded_size;
+static struct Segment* new_segment(uint32 base_address, uint32 num_of_pages)
+{
+	struct Segment *seg = alloc_block(sizeof(struct Segment));
+	if (seg == NULL)
+		panic("new_segment() in user: no memory for the segment descriptors");
+	seg->base_address = base_address;
+	seg->size_in_number_of_pages = num_of_pages;
+	seg->is_used = 1;
+	return seg;
+}
 
-    return (void *)alloc_address;
+static inline void release_segment(struct Segment* seg)
+{
+	free_block(seg);
 }
 
+//Word w of the map [its leaf should be allocated]
+static inline uint32* page_map_word(struct UHeapPageMap* map, uint32 w)
+{
+	return &map->leaves[w / UHEAP_MAP_WORDS_PER_LEAF][w % UHEAP_MAP_WORDS_PER_LEAF];
+}
 
+static inline void page_map_set(struct UHeapPageMap* map, uint32 i)
+{
+	if (map->leaves[i / 32 / UHEAP_MAP_WORDS_PER_LEAF] == NULL)
+		map->leaves[i / 32 / UHEAP_MAP_WORDS_PER_LEAF] = new_index_leaf();
+	*page_map_word(map, i / 32) |= 1 << (i % 32);
+	map->summary[i / 1024] |= 1 << ((i / 32) % 32);
+}
 
-////=================================
-//// [1] ALLOCATE SPACE IN USER HEAP: ragheb
-////=================================
-void* malloc(uint32 size)
+static inline void page_map_clear(struct UHeapPageMap* map, uint32 i)
 {
-	//==============================================================
-	//DON'T CHANGE THIS CODE========================================
-	uheap_init();
-	if (size == 0) {
-		return NULL ;
+	uint32 *word = page_map_word(map, i / 32);
+	*word &= ~(1 << (i % 32));
+	if (*word == 0)
+		map->summary[i / 1024] &= ~(1 << ((i / 32) % 32));
+}
+
+//Smallest set bit >= from (-1 if none)
+static int page_map_next(struct UHeapPageMap* map, uint32 from)
+{
+	uint32 w = from / 32;
+	if (w >= UHEAP_MAP_WORDS)
+		return -1;
+	if (map->summary[w / 32] & (1 << (w % 32)))
+	{
+		uint32 bits = *page_map_word(map, w) & (~0U << (from % 32));
+		if (bits)
+			return w * 32 + __builtin_ctz(bits);
 	}
+	//the next non-empty word after w from the summary
+	w++;
+	for (uint32 s = w / 32; s < UHEAP_MAP_SUMMARY_WORDS; ++s)
+	{
+		uint32 summary = map->summary[s];
+		if (s == w / 32)
+			summary &= ~0U << (w % 32);
+		if (summary)
+		{
+			w = s * 32 + __builtin_ctz(summary);
+			return w * 32 + __builtin_ctz(*page_map_word(map, w));
+		}
+	}
+	return -1;
+}
 
-	//==============================================================
-	//TODO: [PROJECT'25.IM#2] USER HEAP - #1 malloc
-	// [1] Handle Small Allocations (Block Allocator)
-	if (size <= DYN_ALLOC_MAX_BLOCK_SIZE)
+//Largest set bit (-1 if none)
+static int page_map_last(struct UHeapPageMap* map)
+{
+	for (int s = UHEAP_MAP_SUMMARY_WORDS - 1; s >= 0; --s)
 	{
-		return alloc_block(size);
+		if (map->summary[s])
+		{
+			uint32 w = s * 32 + 31 - __builtin_clz(map->summary[s]);
+			return w * 32 + 31 - __builtin_clz(*page_map_word(map, w));
+		}
 	}
+	return -1;
+}
 
-	uint32 rounded_size = ROUNDUP(size, PAGE_SIZE);
+//The size lists are linked through prev_next_info (a free segment is in no other list).
+//The le_prev of the head is the tail, so that the segments of a size are taken in
+//the order they were freed.
+static void insert_free_segment(struct Segment* seg)
+{
+	uint32 size = seg->size_in_number_of_pages;
+	uint32 bin = uheap_bin_of(size);
+	seg->is_used = 0;
+	page_map_set(&uheap_bin_maps[bin], uheap_page_index(seg->base_address));
+	uheap_bin_counts[bin]++;
+	uheap_bins_bitmap |= (1 << bin);
+
+	struct Segment *head = get_entry(uheap_size_lists, size);
+	seg->prev_next_info.le_next = NULL;
+	if (head == NULL)
+	{
+		seg->prev_next_info.le_prev = seg;
+		set_entry(uheap_size_lists, size, seg);
+	}
+	else
+	{
+		seg->prev_next_info.le_prev = head->prev_next_info.le_prev;
+		head->prev_next_info.le_prev->prev_next_info.le_next = seg;
+		head->prev_next_info.le_prev = seg;
+	}
+	page_map_set(&uheap_size_map, size);
 
-	if (rounded_size > (USER_HEAP_MAX - USER_HEAP_START)) {
+	set_segment_tags(seg);
+}
 
-	    return NULL;
-	}
+static void remove_free_segment(struct Segment* seg)
+{
+	uint32 size = seg->size_in_number_of_pages;
+	uint32 bin = uheap_bin_of(size);
+	page_map_clear(&uheap_bin_maps[bin], uheap_page_index(seg->base_address));
+	if (--uheap_bin_counts[bin] == 0)
+		uheap_bins_bitmap &= ~(1 << bin);
+
+	struct Segment *head = get_entry(uheap_size_lists, size);
+	struct Segment *prev = seg->prev_next_info.le_prev, *next = seg->prev_next_info.le_next;
+	if (seg == head)
+		set_entry(uheap_size_lists, size, next);
+	else
+		prev->prev_next_info.le_next = next;
+	if (next != NULL)
+		next->prev_next_info.le_prev = prev;
+	else if (seg != head)
+		head->prev_next_info.le_prev = prev;
+	if (get_entry(uheap_size_lists, size) == NULL)
+		page_map_clear(&uheap_size_map, size);
+
+	clear_segment_tags(seg);
+}
 
+//Return the bitmap of the non-empty bins that MAY contain a segment of num_of_pages
+static inline uint32 candidate_bins(uint32 num_of_pages)
+{
+	return uheap_bins_bitmap & ~((1 << uheap_bin_of(num_of_pages)) - 1);
+}
 
-	if (LIST_SIZE(&free_segments_list) > 0)
+//Lowest-addressed free segment >= num_of_pages with base >= min_va (NULL if none).
+//Each candidate bin gives its lowest segment from its address map. All segments of
+//the bins above the bin of num_of_pages fit; in that bin itself (if it's a range),
+//the smaller segments are skipped in address order.
+static struct Segment* lowest_fit(uint32 num_of_pages, uint32 min_va)
+{
+	struct Segment *seg, *found = NULL;
+	uint32 from = min_va > USER_HEAP_START ? uheap_page_index(min_va) : 0;
+	uint32 bins = candidate_bins(num_of_pages);
+	while (bins)
 	{
-		struct Segment *seg_exact;
-
-		LIST_FOREACH(seg_exact, &free_segments_list)
+		uint32 bin = __builtin_ctz(bins);
+		bins &= bins - 1;
+		int i = page_map_next(&uheap_bin_maps[bin], from);
+		while (i >= 0)
 		{
-			if (seg_exact->size == rounded_size)
+			seg = get_entry(uheap_seg_tags, i);
+			if (found != NULL && seg->base_address > found->base_address)
+				break;
+			if (seg->size_in_number_of_pages >= num_of_pages)
 			{
-				uint32 va_address = seg_exact->base_address;
+				found = seg;
+				break;
+			}
+			i = page_map_next(&uheap_bin_maps[bin], i + 1);
+		}
+	}
+	return found;
+}
 
-				LIST_REMOVE(&free_segments_list, seg_exact);
-				sys_allocate_user_mem(va_address, rounded_size);
+//Smallest free segment >= num_of_pages: the next non-empty size
+static struct Segment* best_fit(uint32 num_of_pages)
+{
+	int size = page_map_next(&uheap_size_map, num_of_pages);
+	return size < 0 ? NULL : get_entry(uheap_size_lists, size);
+}
 
-				seg_exact->base_address = va_address;
-				seg_exact->size = rounded_size;
-                LIST_INSERT_TAIL(&segments_list, seg_exact);
+//Largest free segment if it fits
+static struct Segment* worst_fit(uint32 num_of_pages)
+{
+	int size = page_map_last(&uheap_size_map);
+	return size < (int)num_of_pages ? NULL : get_entry(uheap_size_lists, size);
+}
 
-				return (void*)va_address;
-			}
-		}
+static struct Segment* exact_fit(uint32 num_of_pages)
+{
+	return num_of_pages < NUM_OF_UHEAP_PAGES ? get_entry(uheap_size_lists, num_of_pages) : NULL;
+}
+
+//Select a free segment for num_of_pages according to the given placement strategy
+static struct Segment* find_free_segment(uint32 num_of_pages, uint32 strategy)
+{
+	struct Segment* seg = NULL;
+	switch (strategy)
+	{
+	case UHP_PLACE_FIRSTFIT:
+		return lowest_fit(num_of_pages, 0);
+	case UHP_PLACE_NEXTFIT:
+		seg = lowest_fit(num_of_pages, uheap_next_fit_va);
+		if (seg == NULL)
+			seg = lowest_fit(num_of_pages, 0);
+		return seg;
+	case UHP_PLACE_BESTFIT:
+		return best_fit(num_of_pages);
+	case UHP_PLACE_WORSTFIT:
+		return worst_fit(num_of_pages);
+	default:
+		//CUSTOM FIT: exact fit, else worst fit
+		seg = exact_fit(num_of_pages);
+		if (seg == NULL)
+			seg = worst_fit(num_of_pages);
+		return seg;
+	}
+}
 
-        struct Segment *seg_worst = NULL;
-        uint32 biggest_size = 0;
-        LIST_FOREACH(seg_exact, &free_segments_list)
-        {
-            if (seg_exact->size >= rounded_size && seg_exact->size > biggest_size)
-            {
-                biggest_size = seg_exact->size;
-                seg_worst = seg_exact;
-            }
-        }
-
-		// If the worst fit block found
-		if (seg_worst != NULL)
+//Reserve (without allocating) num_pages from a free hole or from the break. NULL if no space.
+static struct Segment* reserve_segment(uint32 num_pages, uint32 strategy)
+{
+	struct Segment *seg = find_free_segment(num_pages, strategy);
+	if (seg != NULL)
+	{
+		/* allocate from the beginning of the hole and keep the rest (if any) free */
+		remove_free_segment(seg);
+		if (seg->size_in_number_of_pages > num_pages)
 		{
-			uint32 wf_address = seg_worst->base_address;
+			struct Segment *rest = new_segment(seg->base_address + num_pages * PAGE_SIZE,
+					seg->size_in_number_of_pages - num_pages);
+			insert_free_segment(rest);
+			seg->size_in_number_of_pages = num_pages;
+		}
+		seg->is_used = 1;
+	}
+	else
+	{
+		/* no suitable free hole, expand the heap (uheapPageAllocBreak) */
+		if (num_pages > (USER_HEAP_MAX - uheapPageAllocBreak) / PAGE_SIZE)
+			return NULL;
+		seg = new_segment(uheapPageAllocBreak, num_pages);
+		uheapPageAllocBreak += num_pages * PAGE_SIZE;
+	}
+	set_segment_tags(seg);
+	uheap_next_fit_va = segment_end(seg);
+	return seg;
+}
 
-			            sys_allocate_user_mem(wf_address, rounded_size);
+//Give back the space of an allocated segment whose pages are already freed:
+//merge it with its free neighbors, or shrink the break if it reaches it
+static void unreserve_segment(struct Segment *target)
+{
+	target->is_used = 0;
+	clear_segment_tags(target);
 
-			            // new segment for allocated memory
-			            struct Segment *new_seg = (struct Segment *)alloc_block(sizeof(struct Segment));
-			            if (new_seg == NULL)
-			            {
-			                return NULL;
-			            }
-			            new_seg->base_address = wf_address;
-			            new_seg->size = rounded_size;
-			            LIST_INSERT_TAIL(&segments_list, new_seg);
+	/* merge with the free neighbors (if any) */
+	struct Segment *left = segment_ending_at(target->base_address);
+	if (left != NULL && !left->is_used)
+	{
+		remove_free_segment(left);
+		left->size_in_number_of_pages += target->size_in_number_of_pages;
+		release_segment(target);
+		target = left;
+	}
+	struct Segment *right = segment_starting_at(segment_end(target));
+	if (right != NULL && !right->is_used)
+	{
+		remove_free_segment(right);
+		target->size_in_number_of_pages += right->size_in_number_of_pages;
+		release_segment(right);
+	}
 
-			            // Adjust the free segment
-			            seg_worst->base_address += rounded_size;
-			            seg_worst->size -= rounded_size;
+	/* If the freed hole reaches the top of the heap, shrink the break instead of keeping it
+	   (all the holes below it are already merged into it) */
+	if (segment_end(target) == uheapPageAllocBreak)
+	{
+		uheapPageAllocBreak = target->base_address;
+		release_segment(target);
+	}
+	else
+	{
+		insert_free_segment(target);
+	}
+}
 
-			            if (seg_worst->size == 0)
-			            {
-			                LIST_REMOVE(&free_segments_list, seg_worst);
-			            }
+//==============================================
+// ARENAS:
+//==============================================
+//When enabled [uheap_set_arenas()], the pages of the page allocator are not given
+//back to the kernel by each free(): the freed ranges and the pages allocated ahead of
+//the break (one arena at a time) are kept "pending" and are either reused by the next
+//allocations without any syscall, or given back together by one
+//sys_free_user_mem_ranges() once the batch is full.
+//The pending ranges are disjoint and all of their pages are still allocated in the kernel.
+struct UserMemRange uheap_pending[UHEAP_MAX_PENDING_RANGES];
+uint32 uheap_num_of_pending = 0;
+uint32 uheap_pending_pages = 0;
+
+static void release_pending_ranges()
+{
+	if (uheap_num_of_pending == 0)
+		return;
+	sys_free_user_mem_ranges(uheap_pending, uheap_num_of_pending);
+	uheapStats.num_of_syscalls++;
+	uheap_num_of_pending = 0;
+	uheap_pending_pages = 0;
+}
 
-			            return (void *)wf_address;
-			        }
+static void add_pending_range(uint32 va, uint32 num_pages)
+{
+	if (num_pages > UHEAP_MAX_PENDING_PAGES)
+	{
+		sys_free_user_mem(va, num_pages * PAGE_SIZE);
+		uheapStats.num_of_syscalls++;
+		return;
 	}
+	if (uheap_num_of_pending == UHEAP_MAX_PENDING_RANGES || uheap_pending_pages + num_pages > UHEAP_MAX_PENDING_PAGES)
+		release_pending_ranges();
+	uheap_pending[uheap_num_of_pending].virtual_address = va;
+	uheap_pending[uheap_num_of_pending].size = num_pages * PAGE_SIZE;
+	uheap_num_of_pending++;
+	uheap_pending_pages += num_pages;
+}
 
+//Remove [va, va + num_pages) from the pending ranges & return how many of its pages
+//were pending (i.e. still allocated in the kernel). If release, these pages are freed.
+static uint32 take_pending_pages(uint32 va, uint32 num_pages, uint8 release)
+{
+	uint32 end = va + num_pages * PAGE_SIZE;
+	uint32 taken = 0;
+	uint32 i = 0;
+	while (i < uheap_num_of_pending)
+	{
+		struct UserMemRange *r = &uheap_pending[i];
+		uint32 r_end = r->virtual_address + r->size;
+		if (r_end <= va || r->virtual_address >= end)
+		{
+			i++;
+			continue;
+		}
+		uint32 lo = MAX(va, r->virtual_address);
+		uint32 hi = MIN(end, r_end);
+		taken += (hi - lo) / PAGE_SIZE;
+		uheap_pending_pages -= (hi - lo) / PAGE_SIZE;
+		if (release)
+		{
+			sys_free_user_mem(lo, hi - lo);
+			uheapStats.num_of_syscalls++;
+		}
 
-	// case 4: the user heap is full
-	if ((uheapPageAllocBreak + rounded_size) > USER_HEAP_MAX)
+		if (r->virtual_address < lo && r_end > hi)
+		{
+			/* taken from the middle: keep both sides */
+			r->size = lo - r->virtual_address;
+			if (uheap_num_of_pending < UHEAP_MAX_PENDING_RANGES)
+			{
+				uheap_pending[uheap_num_of_pending].virtual_address = hi;
+				uheap_pending[uheap_num_of_pending].size = r_end - hi;
+				uheap_num_of_pending++;
+			}
+			else
+			{
+				uheap_pending_pages -= (r_end - hi) / PAGE_SIZE;
+				sys_free_user_mem(hi, r_end - hi);
+				uheapStats.num_of_syscalls++;
+			}
+			break; /* the ranges are disjoint */
+		}
+		else if (r->virtual_address < lo)
+		{
+			r->size = lo - r->virtual_address;
+			i++;
+		}
+		else if (r_end > hi)
+		{
+			r->virtual_address = hi;
+			r->size = r_end - hi;
+			i++;
+		}
+		else
+		{
+			/* fully taken: replace it by the last one */
+			*r = uheap_pending[--uheap_num_of_pending];
+		}
+	}
+	return taken;
+}
+
+//Allocate the pages of a newly reserved segment in the kernel
+static void allocate_pages(uint32 va, uint32 num_pages)
+{
+	uheapStats.num_of_page_allocs++;
+	if (!uheapArenasEnabled)
 	{
-		cprintf("ana gowa el case el user heap is full ");
+		sys_allocate_user_mem(va, num_pages * PAGE_SIZE);
+		uheapStats.num_of_syscalls++;
+		return;
+	}
+	if (take_pending_pages(va, num_pages, 0) == num_pages)
+		return;
+
+	/* the already pending pages are allocated again (harmless): one call for the whole range.
+	 * At the break, allocate a whole arena ahead of it within the same call */
+	uint32 end = va + num_pages * PAGE_SIZE;
+	uint32 arena_end = end;
+	if (end == uheapPageAllocBreak && end + UHEAP_ARENA_PAGES * PAGE_SIZE < USER_HEAP_MAX)
+	{
+		arena_end = end + UHEAP_ARENA_PAGES * PAGE_SIZE;
+		take_pending_pages(end, UHEAP_ARENA_PAGES, 0);
+	}
+	sys_allocate_user_mem(va, arena_end - va);
+	uheapStats.num_of_syscalls++;
+	if (arena_end > end)
+		add_pending_range(end, (arena_end - end) / PAGE_SIZE);
+}
+
+//Free the pages of a released segment in the kernel (later & in a batch with arenas)
+static void free_pages(uint32 va, uint32 num_pages)
+{
+	uheapStats.num_of_page_frees++;
+	if (!uheapArenasEnabled)
+	{
+		sys_free_user_mem(va, num_pages * PAGE_SIZE);
+		uheapStats.num_of_syscalls++;
+		return;
+	}
+	add_pending_range(va, num_pages);
+}
+
+//==============================================
+// BRK MODE [UHP_PLACE_BRK]:
+//==============================================
+//Bump allocation at the break with one sys_sbrk() per range: nothing is indexed, so
+//free() ignores these ranges and their pages are given back at the exit of the process.
+//The kernel keeps the pages below its break for sys_sbrk() only, so the other modes
+//allocate above it (uheapPageAllocBreak follows it), and no break is taken while the
+//other modes have segments above it.
+uint32 uheap_kernel_break = USER_HEAP_PAGE_ALLOC_START;
+
+static void* brk_alloc(uint32 num_pages)
+{
+	if (num_pages > (USER_HEAP_MAX - uheapPageAllocBreak) / PAGE_SIZE)
+		return NULL;
+	/* no pending page may stay beyond the break: the new ranges would be released later */
+	release_pending_ranges();
+	if (uheap_kernel_break != uheapPageAllocBreak)
+		return NULL;
+	uheapStats.num_of_page_allocs++;
+	uheapStats.num_of_syscalls++;
+	void *va = sys_sbrk(num_pages);
+	if (va == (void*)-1)
+	{
+		uheap_kernel_break = (uint32)sys_sbrk(0);
 		return NULL;
 	}
+	uheapPageAllocBreak += num_pages * PAGE_SIZE;
+	uheap_kernel_break = uheapPageAllocBreak;
+	return va;
+}
 
-	// case 3: not found enough space
-	uint32 va_address = uheapPageAllocBreak;
+void uheap_set_arenas(uint8 enable)
+{
+	uheapArenasEnabled = enable;
+	if (!enable)
+		release_pending_ranges();
+}
 
 
-    // Track the allocation
-    struct Segment *new_seg = (struct Segment *)alloc_block(sizeof(struct Segment));
-    if (new_seg == NULL) {
-        return NULL;
-    }
+////=================================
+//// [1] ALLOCATE SPACE IN USER HEAP: ragheb
+////=================================
+void* malloc(uint32 size)
+{
+	//==============================================================
+	//DON'T CHANGE THIS CODE========================================
+	uheap_init();
+	if (size == 0) {
+		return NULL ;
+	}
 
-    new_seg->base_address = va_address;
-    new_seg->size = rounded_size;
+	//==============================================================
+	//TODO: [PROJECT'25.IM#2] USER HEAP - #1 malloc
+	// [1] Handle Small Allocations (Block Allocator)
+	if (size <= DYN_ALLOC_MAX_BLOCK_SIZE)
+	{
+		return alloc_block(size);
+	}
 
-    LIST_INSERT_TAIL(&segments_list, new_seg);
-    uheapPageAllocBreak += rounded_size;
+	// [2] Page Allocator: take a hole by the current strategy, else expand the break
+	uint32 num_pages = size / PAGE_SIZE + (size % PAGE_SIZE != 0);
+	if (uheapPlaceStrategy == UHP_PLACE_BRK)
+	{
+		return brk_alloc(num_pages);
+	}
+	struct Segment *seg = reserve_segment(num_pages, uheapPlaceStrategy);
+	if (seg == NULL)
+	{
+		return NULL;
+	}
+	allocate_pages(seg->base_address, num_pages);
 
-	sys_allocate_user_mem(va_address, rounded_size);
+	return (void *)seg->base_address;
+}
 
-    return (void *)va_address;
+//=================================
+// [1.1] ALLOCATE ZEROED SPACE IN USER HEAP:
+//=================================
+//Page allocator ranges are NOT zeroed here: never-touched heap pages are demand-zero
+//(zero-filled by the fault handler on their first access), so zeroing costs nothing until
+//the page is touched. Only the freed pages that are still pending in an arena may hold
+//old data: they're released first so that they're faulted-in again as zero pages.
+void* calloc(uint32 num, uint32 size)
+{
+	uheap_init();
+	if (num == 0 || size == 0 || size > 0xFFFFFFFF / num) {
+		return NULL ;
+	}
+	uint32 total = num * size;
+
+	if (total <= DYN_ALLOC_MAX_BLOCK_SIZE)
+	{
+		void *va = alloc_block(total);
+		if (va != NULL)
+			memset(va, 0, total);
+		return va;
+	}
+
+	uint32 num_pages = total / PAGE_SIZE + (total % PAGE_SIZE != 0);
+	if (uheapPlaceStrategy == UHP_PLACE_BRK)
+	{
+		//the pages above the break are never touched
+		return brk_alloc(num_pages);
+	}
+	struct Segment *seg = reserve_segment(num_pages, uheapPlaceStrategy);
+	if (seg == NULL)
+	{
+		return NULL;
+	}
+	take_pending_pages(seg->base_address, num_pages, 1);
+	allocate_pages(seg->base_address, num_pages);
 
-//	panic("malloc() is not implemented yet...!!");
+	return (void *)seg->base_address;
 }
 
 
@@ -276,9 +748,9 @@ void free(void* virtual_address)
 {
 	uint32 va = (uint32)virtual_address;
 
-    if (virtual_address == NULL || (uint32)virtual_address == 0) {
-        return;
-    }
+	if (virtual_address == NULL || (uint32)virtual_address == 0) {
+		return;
+	}
 
 	// check it location if in block range or page range
 	if (va >= USER_HEAP_START && va < uheapPageAllocStart) {
@@ -286,80 +758,14 @@ void free(void* virtual_address)
 		return;
 	}
 
-		// Find the allocated size associated with this address
-		struct Segment *seg_to_free = NULL;
-		struct Segment *curr = NULL;
-
-		// Iterate allocated segments to find the target
-		LIST_FOREACH(curr, &segments_list ) {
-			if (curr->base_address == va) {
-				seg_to_free = curr;
-				break;
-			}
-		}
-
-		if (seg_to_free == NULL) {
-			return; // Address not found in allocated list
-		}
-
-
-		LIST_REMOVE(&segments_list, seg_to_free);
-
-		sys_free_user_mem(va, seg_to_free->size);
-
-
-		// the merging
-		struct Segment *s_node = NULL;
-		struct Segment *prev_node = NULL;
-		int inserted = 0;
-
-		LIST_FOREACH(s_node, &free_segments_list) {
-			if (s_node->base_address > va) {
-				LIST_INSERT_BEFORE(&free_segments_list, s_node, seg_to_free);
-				inserted = 1;
-				break;
-			}
-			prev_node = s_node;
-		}
-
-		if (inserted == 0)
-		{
-			LIST_INSERT_TAIL(&free_segments_list, seg_to_free);
-		}
-
-		struct Segment *next_node = LIST_NEXT(seg_to_free);
-		if (next_node != NULL)
-		{
-			if ((seg_to_free->base_address + seg_to_free->size) == next_node->base_address)
-			{
-				seg_to_free->size += next_node->size;
-				LIST_REMOVE(&free_segments_list, next_node);
-			}
-		}
-
-		// Attempt to Merge with Previous Segment
-		struct Segment *prev_seg = LIST_PREV(seg_to_free);
-		if (prev_seg != NULL)
-		{
-			if ((prev_seg->base_address + prev_seg->size) == seg_to_free->base_address)
-			{
-				prev_seg->size += seg_to_free->size;
-				LIST_REMOVE(&free_segments_list, seg_to_free);
-				seg_to_free = prev_seg;
-			}
-		}
-
-		// Check if we can reduce the Heap Break
-		struct Segment *last_seg = LIST_LAST(&free_segments_list);
-		if (last_seg != NULL && (last_seg->base_address + last_seg->size) == uheapPageAllocBreak)
-		{
-			uheapPageAllocBreak -= last_seg->size;
-			LIST_REMOVE(&free_segments_list, last_seg);
-		}
-
-	if(va > USER_HEAP_MAX) {
-		panic("invalid address");
+	// find the allocated segment by its base address
+	struct Segment *target = segment_starting_at(va);
+	if (target == NULL || !target->is_used) {
+		return; // Address not found in allocated segments
 	}
+
+	free_pages(va, target->size_in_number_of_pages);
+	unreserve_segment(target);
 }
 
 
@@ -383,48 +789,17 @@ void free(void* virtual_address)
 //=================================
 
 // helper func.
-void *check_id(int shared_obj_id, void *alloc_VA, uint32 alloc_size)
+// helper func.
+void *check_id(int shared_obj_id, struct Segment *seg)
 {
     if (shared_obj_id < 0)
     {
-        // Error - return space to free list
-        struct Segment *new_free_seg = (struct Segment *)alloc_block(sizeof(struct Segment));
-        if (new_free_seg != NULL)
-        {
-            new_free_seg->base_address = (uint32)alloc_VA;
-            new_free_seg->size = alloc_size;
-
-            // Insert back into free list (sorted)
-            struct Segment *seg;
-            int inserted = 0;
-            LIST_FOREACH(seg, &free_segments_list)
-            {
-                if (seg->base_address > (uint32)alloc_VA)
-                {
-                    LIST_INSERT_BEFORE(&free_segments_list, seg, new_free_seg);
-                    inserted = 1;
-                    break;
-                }
-            }
-            if (!inserted)
-            {
-                LIST_INSERT_TAIL(&free_segments_list, new_free_seg);
-            }
-        }
+        // Error - return space to the free segments
+        unreserve_segment(seg);
         return (void *)NULL;
     }
-    // Success - track the allocation
-    struct Segment *new_seg = (struct Segment *)alloc_block(sizeof(struct Segment));
-    if (new_seg == NULL)
-    {
-        return (void *)NULL;
-    }
-    new_seg->base_address = (uint32)alloc_VA;
-    new_seg->size = alloc_size;
-    LIST_INSERT_TAIL(&segments_list, new_seg);
-
     // if success return va
-    return alloc_VA;
+    return (void *)seg->base_address;
 }
 
 void *smalloc(char *sharedVarName, uint32 size, uint8 isWritable)
@@ -451,11 +826,14 @@ void *smalloc(char *sharedVarName, uint32 size, uint8 isWritable)
     uint32 alloc_size = ROUNDUP(size, PAGE_SIZE);
 
     // cust0m fit
-    void *alloc_VA = custom_fit(alloc_size);
-    if (!alloc_VA)
+    struct Segment *seg = reserve_segment(alloc_size / PAGE_SIZE, UHP_PLACE_CUSTOMFIT);
+    if (seg == NULL)
     {
         return NULL;
     }
+    void *alloc_VA = (void *)seg->base_address;
+    // pages still allocated for the heap arenas (if any) can't be shared
+    take_pending_pages(seg->base_address, seg->size_in_number_of_pages, 1);
     //    create_shared_object(sharedVarName, size, isWritable,alloc_VA);
     int shared_obj_id = sys_create_shared_object(sharedVarName, size, isWritable, alloc_VA);
     // RETURN:
@@ -468,7 +846,7 @@ void *smalloc(char *sharedVarName, uint32 size, uint8 isWritable)
     //	return alloc_VA;
 
     // Check return value
-    return check_id(shared_obj_id, alloc_VA, alloc_size);
+    return check_id(shared_obj_id, seg);
 
     //		if(shared_obj_id==E_SHARED_MEM_NOT_EXISTS || shared_obj_id==E_NO_SHARE){
     //			return NULL;
@@ -516,12 +894,15 @@ void *sget(int32 ownerEnvID, char *sharedVarName)
     // round up to get full page
     uint32 alloc_size = ROUNDUP(size, PAGE_SIZE);
     // get suitable space, va (start of allocation)
-    void *alloc_VA = custom_fit(alloc_size);
+    struct Segment *seg = reserve_segment(alloc_size / PAGE_SIZE, UHP_PLACE_CUSTOMFIT);
     // check free space exitst
-    if (!alloc_VA)
+    if (seg == NULL)
     {
         return NULL;
     }
+    void *alloc_VA = (void *)seg->base_address;
+    // pages still allocated for the heap arenas (if any) can't be shared
+    take_pending_pages(seg->base_address, seg->size_in_number_of_pages, 1);
     //	get_shared_object(ownerEnvID,sharedVarName,alloc_VA);
     int shared_obj_id = sys_get_shared_object(ownerEnvID, sharedVarName, alloc_VA);
     // RETURN:
@@ -529,7 +910,7 @@ void *sget(int32 ownerEnvID, char *sharedVarName)
     //	b) E_SHARED_MEM_NOT_EXISTS if the shared object is not exists
     // Check return value
 
-    return check_id(shared_obj_id, alloc_VA, alloc_size);
+    return check_id(shared_obj_id, seg);
 
     //	if(shared_obj_id==E_SHARED_MEM_NOT_EXISTS){
     //		return NULL;
@@ -544,6 +925,56 @@ void *sget(int32 ownerEnvID, char *sharedVarName)
 //==================================================================================//
 
 
+//Shrink an allocated segment in place: its tail pages are freed & given back
+static void shrink_segment(struct Segment *seg, uint32 new_num_of_pages)
+{
+	uint32 tail_va = seg->base_address + new_num_of_pages * PAGE_SIZE;
+	uint32 tail_pages = seg->size_in_number_of_pages - new_num_of_pages;
+
+	free_pages(tail_va, tail_pages);
+	clear_segment_tags(seg);
+	seg->size_in_number_of_pages = new_num_of_pages;
+	set_segment_tags(seg);
+
+	struct Segment *tail = new_segment(tail_va, tail_pages);
+	set_segment_tags(tail);
+	unreserve_segment(tail);
+}
+
+//Grow an allocated segment in place, either into its free right neighbor or by
+//moving the break. Return 0 if there's no room after it.
+static int expand_segment(struct Segment *seg, uint32 new_num_of_pages)
+{
+	uint32 extra = new_num_of_pages - seg->size_in_number_of_pages;
+	uint32 seg_end = segment_end(seg);
+	struct Segment *right = segment_starting_at(seg_end);
+
+	if (right != NULL && !right->is_used && right->size_in_number_of_pages >= extra)
+	{
+		remove_free_segment(right);
+		if (right->size_in_number_of_pages > extra)
+		{
+			right->base_address += extra * PAGE_SIZE;
+			right->size_in_number_of_pages -= extra;
+			insert_free_segment(right);
+		}
+		else
+			release_segment(right);
+	}
+	else if (seg_end == uheapPageAllocBreak && extra <= (USER_HEAP_MAX - uheapPageAllocBreak) / PAGE_SIZE)
+	{
+		uheapPageAllocBreak += extra * PAGE_SIZE;
+	}
+	else
+		return 0;
+
+	clear_segment_tags(seg);
+	seg->size_in_number_of_pages = new_num_of_pages;
+	set_segment_tags(seg);
+	allocate_pages(seg_end, extra);
+	return 1;
+}
+
 //=================================
 // REALLOC USER SPACE:
 //=================================
@@ -565,7 +996,69 @@ void *realloc(void *virtual_address, uint32 new_size)
 	//DON'T CHANGE THIS CODE========================================
 	uheap_init();
 	//==============================================================
-	panic("realloc() is not implemented yet...!!");
+	if (virtual_address == NULL)
+		return malloc(new_size);
+	if (new_size == 0)
+	{
+		free(virtual_address);
+		return NULL;
+	}
+
+	uint32 va = (uint32)virtual_address;
+	void *new_va = NULL;
+
+	/* BLOCK allocation: resize it in the dynamic allocator or move it to the page allocator */
+	if (va >= USER_HEAP_START && va < uheapPageAllocStart)
+	{
+		if (new_size <= DYN_ALLOC_MAX_BLOCK_SIZE)
+			return realloc_block(virtual_address, new_size);
+		new_va = malloc(new_size);
+		if (new_va != NULL)
+		{
+			memcpy(new_va, virtual_address, get_block_size(virtual_address));
+			free_block(virtual_address);
+		}
+		return new_va;
+	}
+
+	/* PAGE allocation */
+	struct Segment *seg = segment_starting_at(va);
+	if (seg == NULL || !seg->is_used)
+		return NULL;
+	uint32 old_pages = seg->size_in_number_of_pages;
+
+	/* small enough for a block: copy the kept part & give back the pages */
+	if (new_size <= DYN_ALLOC_MAX_BLOCK_SIZE)
+	{
+		new_va = alloc_block(new_size);
+		if (new_va != NULL)
+		{
+			memcpy(new_va, virtual_address, new_size);
+			free(virtual_address);
+		}
+		return new_va;
+	}
+
+	uint32 new_pages = new_size / PAGE_SIZE + (new_size % PAGE_SIZE != 0);
+	if (new_pages < old_pages)
+	{
+		shrink_segment(seg, new_pages);
+	}
+	else if (new_pages > old_pages && !expand_segment(seg, new_pages))
+	{
+		/* no room in place: move the existing pages to the new space instead of copying them */
+		struct Segment *new_seg = reserve_segment(new_pages, uheapPlaceStrategy);
+		if (new_seg == NULL)
+			return NULL;
+		// pages still allocated for the heap arenas (if any) can't be the destination of the move
+		take_pending_pages(new_seg->base_address, old_pages, 1);
+		sys_move_user_mem(va, new_seg->base_address, old_pages * PAGE_SIZE);
+		allocate_pages(new_seg->base_address + old_pages * PAGE_SIZE, new_pages - old_pages);
+		// the old pages are already moved: only give back their space
+		unreserve_segment(seg);
+		va = new_seg->base_address;
+	}
+	return (void*)va;
 }
 
 
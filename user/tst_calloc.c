@@ -0,0 +1,132 @@
+/* *********************************************************** */
+/* MAKE SURE PAGE_WS_MAX_SIZE = 2000 */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define numOfPages 8
+#define blockSize 100
+
+bool is_zeroed(int* va, uint32 size)
+{
+	for (uint32 i = 0; i < size / sizeof(int); ++i)
+		if (va[i] != 0)
+			return 0;
+	return 1;
+}
+
+void _main(void)
+{
+#if USE_KHEAP
+	{
+		if (LIST_SIZE(&(myEnv->page_WS_list)) >= myEnv->page_WS_max_size)
+			panic("Please increase the WS size");
+	}
+#else
+	panic("make sure to enable the kernel heap: USE_KHEAP=1");
+#endif
+
+	/*=================================================*/
+
+	int eval = 0;
+	bool is_correct = 1;
+	int *va, *newVA;
+
+	sys_set_uheap_strategy(UHP_PLACE_FIRSTFIT);
+	uheap_set_arenas(1);
+
+	//====================================================================//
+	cprintf("%~\n1: calloc of pages allocates no frame before their first access [30%]\n") ;
+	{
+		is_correct = 1;
+		int freeFrames = sys_calculate_free_frames() ;
+		va = calloc(numOfPages, PAGE_SIZE);
+		if (va == NULL)
+		{
+			cprintf("calloc #1: unexpected NULL\n");
+			is_correct = 0;
+		}
+		//the page tables of the new pages may be allocated
+		if (freeFrames - sys_calculate_free_frames() > 1)
+		{
+			cprintf("frames are allocated before accessing the pages. # frames = %d\n", freeFrames - sys_calculate_free_frames());
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: the pages are zero-filled on their first access [30%]\n") ;
+	{
+		is_correct = 1;
+		if (!is_zeroed(va, numOfPages * PAGE_SIZE))
+		{
+			cprintf("content is not zeroed\n");
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n3: reusing a freed & dirtied range still gives zeros [25%]\n") ;
+	{
+		is_correct = 1;
+		for (uint32 i = 0; i < numOfPages * PAGE_SIZE / sizeof(int); ++i)
+			va[i] = -1;
+		free(va);
+		newVA = calloc(numOfPages, PAGE_SIZE);
+		if (newVA != va)
+		{
+			cprintf("freed range is not reused. Expected %x, Actual %x\n", va, newVA);
+			is_correct = 0;
+		}
+		if (newVA == NULL || !is_zeroed(newVA, numOfPages * PAGE_SIZE))
+		{
+			cprintf("content of the reused range is not zeroed\n");
+			is_correct = 0;
+		}
+		free(newVA);
+		if (is_correct)
+		{
+			eval += 25;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n4: calloc of blocks is zeroed & overflowed sizes are refused [15%]\n") ;
+	{
+		is_correct = 1;
+		int *blk = malloc(blockSize * sizeof(int));
+		for (int i = 0; i < blockSize; ++i)
+			blk[i] = -1;
+		free(blk);
+		blk = calloc(blockSize, sizeof(int));
+		if (blk == NULL || !is_zeroed(blk, blockSize * sizeof(int)))
+		{
+			cprintf("block is not zeroed\n");
+			is_correct = 0;
+		}
+		free(blk);
+		if (calloc(0x10000, 0x10000) != NULL)
+		{
+			cprintf("overflowed size is not refused\n");
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 15;
+		}
+	}
+
+	uheap_set_arenas(0);
+
+	cprintf("%~\ntest calloc is finished. Evaluation = %d%\n", eval);
+
+	return;
+}
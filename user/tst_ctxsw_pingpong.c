@@ -0,0 +1,40 @@
+// Context switch benchmark: the master & its slave bounce the control between them by two kernel semaphores
+// Each round trip is 2 context switches. Run it before & after a change of the switch path to compare.
+#include <inc/lib.h>
+
+#define numOfRounds 1000
+
+void _main(void)
+{
+	int semVal = 0;
+	char initCmd0[64] = "__KSem@0@Init";
+	char initCmd1[64] = "__KSem@1@Init";
+	sys_utilities(initCmd0, (uint32)(&semVal));
+	sys_utilities(initCmd1, (uint32)(&semVal));
+
+	int id = sys_create_env("tpingpong_slave", (myEnv->page_WS_max_size), (myEnv->SecondListSize), (myEnv->percentage_of_WS_pages_to_be_removed));
+	if (id == E_ENV_CREATION_ERROR)
+		panic("NO AVAILABLE ENVs...");
+	sys_run_env(id);
+
+	char signalCmd[64] = "__KSem@1@Signal";
+	char waitCmd[64] = "__KSem@0@Wait";
+
+	//warm up: the first round faults in the pages of both envs
+	sys_utilities(signalCmd, 0);
+	sys_utilities(waitCmd, 0);
+
+	struct uint64 start = sys_get_virtual_time();
+	for (int i = 0; i < numOfRounds; ++i)
+	{
+		sys_utilities(signalCmd, 0);
+		sys_utilities(waitCmd, 0);
+	}
+	struct uint64 end = sys_get_virtual_time();
+
+	//the low 32 bits are enough for the elapsed cycles of the rounds
+	uint32 cycles = end.low - start.low;
+	cprintf("%~\nping-pong: %d round trips in %u cycles => %u cycles per context switch\n", numOfRounds, cycles, cycles / (2 * numOfRounds));
+
+	return;
+}
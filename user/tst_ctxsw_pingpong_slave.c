@@ -0,0 +1,18 @@
+// Slave of the context switch benchmark [tst_ctxsw_pingpong]: answers each ping of its master
+#include <inc/lib.h>
+
+#define numOfRounds 1000
+
+void _main(void)
+{
+	char waitCmd[64] = "__KSem@1@Wait";
+	char signalCmd[64] = "__KSem@0@Signal";
+
+	//+1 for the warm-up round
+	for (int i = 0; i < numOfRounds + 1; ++i)
+	{
+		sys_utilities(waitCmd, 0);
+		sys_utilities(signalCmd, 0);
+	}
+	return;
+}
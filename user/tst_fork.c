@@ -0,0 +1,136 @@
+/* *********************************************************** */
+/* MAKE SURE PAGE_WS_MAX_SIZE = 2000 */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define numOfPages 64
+
+int globalVar = 5;
+
+void fill(int* va, uint32 num_of_pages, int val)
+{
+	for (uint32 i = 0; i < num_of_pages; ++i)
+		va[i * PAGE_SIZE / sizeof(int)] = val + i;
+}
+
+bool check(int* va, uint32 num_of_pages, int val)
+{
+	for (uint32 i = 0; i < num_of_pages; ++i)
+		if (va[i * PAGE_SIZE / sizeof(int)] != val + i)
+			return 0;
+	return 1;
+}
+
+void _main(void)
+{
+#if USE_KHEAP
+	{
+		if (LIST_SIZE(&(myEnv->page_WS_list)) >= myEnv->page_WS_max_size)
+			panic("Please increase the WS size");
+	}
+#else
+	panic("make sure to enable the kernel heap: USE_KHEAP=1");
+#endif
+
+	/*=================================================*/
+
+	int eval = 0;
+	bool is_correct = 1;
+
+	int *va = malloc(numOfPages * PAGE_SIZE);
+	fill(va, numOfPages, 10);
+	int *sharedVar = smalloc("forkShared", sizeof(int), 1);
+	*sharedVar = 0;
+	rsttst();
+
+	int freeFrames = sys_calculate_free_frames() ;
+	int parentID = sys_getenvid();
+	int childID = sys_fork();
+	if (childID == 0)
+	{
+		//CHILD: sees the data of its parent at the fork time, then writes its own copy
+		if (sys_getparentenvid() != parentID || myEnv->env_id == parentID)
+			cprintf("child: wrong env. parent %d, expected %d\n", sys_getparentenvid(), parentID);
+		else if (globalVar != 5 || !check(va, numOfPages, 10))
+			cprintf("child: content is not correct after fork\n");
+		else
+		{
+			globalVar = 7;
+			fill(va, numOfPages, 30);
+			if (check(va, numOfPages, 30))
+				*sharedVar = 1;
+		}
+		inctst();
+		return;
+	}
+
+	//====================================================================//
+	cprintf("%~\n1: fork shares the pages instead of copying them [30%]\n") ;
+	{
+		//the new env needs its directory, page & disk tables & kernel stack, but not the data pages
+		if (childID < 0)
+		{
+			cprintf("fork failed. error %d\n", childID);
+			is_correct = 0;
+		}
+		else if (freeFrames - sys_calculate_free_frames() >= numOfPages / 2)
+		{
+			cprintf("data pages are copied on fork. # frames = %d\n", freeFrames - sys_calculate_free_frames());
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: the parent's writes are private [30%]\n") ;
+	{
+		is_correct = 1;
+		uint32 cowFaults = myEnv->cowFaultsCounter;
+		globalVar = 6;
+		fill(va, numOfPages, 20);
+		if (globalVar != 6 || !check(va, numOfPages, 20))
+		{
+			cprintf("content is not correct after writing\n");
+			is_correct = 0;
+		}
+		if (myEnv->cowFaultsCounter - cowFaults < numOfPages)
+		{
+			cprintf("writes are not copy-on-write. # faults = %d\n", myEnv->cowFaultsCounter - cowFaults);
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n3: the child's writes are private & shared objects stay shared [40%]\n") ;
+	{
+		is_correct = 1;
+		sys_run_env(childID);
+		while (gettst() != 1) ;
+		if (*sharedVar != 1)
+		{
+			cprintf("child didn't see its parent's data (or the shared object)\n");
+			is_correct = 0;
+		}
+		if (globalVar != 6 || !check(va, numOfPages, 20))
+		{
+			cprintf("child's writes are seen by its parent\n");
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 40;
+		}
+	}
+
+	cprintf("%~\ntest fork is finished. Evaluation = %d%\n", eval);
+
+	return;
+}
@@ -0,0 +1,90 @@
+/* *********************************************************** */
+/* MAKE SURE LAZY PROGRAM LOADING IS ENABLED (lazyload command) */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define numOfInts (2 * PAGE_SIZE / sizeof(int))
+
+int initData[numOfInts] = { [0] = 1, [numOfInts/2] = 2, [numOfInts-1] = 3 };
+int bssData[numOfInts];
+
+void _main(void)
+{
+	int eval = 0;
+	bool is_correct = 1;
+
+	//====================================================================//
+	cprintf("%~\n1: the program is not written to the page file at creation [30%]\n") ;
+	{
+		//only the initial stack page(s) are there
+		int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+		if (usedDiskPages > myEnv->initNumStackPages)
+		{
+			cprintf("program pages are in the page file. # pages = %d\n", usedDiskPages);
+		}
+		else
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: data & bss pages are loaded on their first access [40%]\n") ;
+	{
+		is_correct = 1;
+		int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+		if (initData[0] != 1 || initData[numOfInts/2] != 2 || initData[numOfInts-1] != 3 || initData[1] != 0)
+		{
+			cprintf("data is not loaded correctly\n");
+			is_correct = 0;
+		}
+		for (int i = 0; i < numOfInts; i += PAGE_SIZE / sizeof(int) / 4)
+		{
+			if (bssData[i] != 0)
+			{
+				cprintf("bss is not zero at index %d\n", i);
+				is_correct = 0;
+				break;
+			}
+		}
+		//reading clean pages doesn't write them anywhere
+		if (sys_pf_calculate_allocated_pages() != usedDiskPages)
+		{
+			cprintf("clean pages are written to the page file\n");
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 40;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n3: modified program pages keep their content [30%]\n") ;
+	{
+		is_correct = 1;
+		for (int i = 0; i < numOfInts; ++i)
+		{
+			initData[i] = i;
+			bssData[i] = -i;
+		}
+		for (int i = 0; i < numOfInts; ++i)
+		{
+			if (initData[i] != i || bssData[i] != -i)
+			{
+				cprintf("content is not correct at index %d\n", i);
+				is_correct = 0;
+				break;
+			}
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	cprintf("%~\ntest lazy program loading is finished. Evaluation = %d%\n", eval);
+
+	return;
+}
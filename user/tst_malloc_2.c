@@ -43,6 +43,9 @@ void _main(void)
 	/*=================================================*/
 
 
+	//Count what each kind of size classes would take for the blocks below
+	set_dyn_alloc_class_stats(1);
+
 	int eval = 0;
 	bool is_correct = 1;
 	int targetAllocatedSpace = 3*Mega;
@@ -203,6 +206,7 @@ void _main(void)
 		}
 	}
 
+	print_size_classes_fragmentation();
 	cprintf("%~\ntest malloc (2) [DYNAMIC ALLOCATOR] is finished. Evaluation = %d%\n", eval);
 
 	return;
@@ -0,0 +1,134 @@
+/* *********************************************************** */
+/* MAKE SURE PAGE_WS_MAX_SIZE = 2000 */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define numOfPages 4
+
+void fill(int* va, uint32 num_of_pages, int val)
+{
+	for (uint32 i = 0; i < num_of_pages; ++i)
+		va[i * PAGE_SIZE / sizeof(int)] = val + i;
+}
+
+bool check(int* va, uint32 num_of_pages, int val)
+{
+	for (uint32 i = 0; i < num_of_pages; ++i)
+		if (va[i * PAGE_SIZE / sizeof(int)] != val + i)
+			return 0;
+	return 1;
+}
+
+void _main(void)
+{
+#if USE_KHEAP
+	{
+		if (LIST_SIZE(&(myEnv->page_WS_list)) >= myEnv->page_WS_max_size)
+			panic("Please increase the WS size");
+	}
+#else
+	panic("make sure to enable the kernel heap: USE_KHEAP=1");
+#endif
+
+	/*=================================================*/
+
+	int eval = 0;
+	bool is_correct = 1;
+	int *va, *newVA, *blocker;
+
+	sys_set_uheap_strategy(UHP_PLACE_FIRSTFIT);
+
+	//====================================================================//
+	cprintf("%~\n1: grow a range at the break: in place [25%]\n") ;
+	{
+		is_correct = 1;
+		va = malloc(numOfPages * PAGE_SIZE);
+		fill(va, numOfPages, 10);
+		newVA = realloc(va, 2 * numOfPages * PAGE_SIZE);
+		if (newVA != va)
+		{
+			cprintf("range is moved. Expected %x, Actual %x\n", va, newVA);
+			is_correct = 0;
+		}
+		if (!check(newVA, numOfPages, 10))
+		{
+			cprintf("content is not correct after growing in place\n");
+			is_correct = 0;
+		}
+		fill(newVA, 2 * numOfPages, 20);
+		va = newVA;
+		if (is_correct)
+		{
+			eval += 25;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: grow a range with no room after it: moved without copying [40%]\n") ;
+	{
+		is_correct = 1;
+		blocker = malloc(PAGE_SIZE + 1);
+		uint32 faults = myEnv->pageFaultsCounter;
+		newVA = realloc(va, 4 * numOfPages * PAGE_SIZE);
+		if (newVA == NULL || newVA == va)
+		{
+			cprintf("range is not moved. Actual %x\n", newVA);
+			is_correct = 0;
+		}
+		else if (!check(newVA, 2 * numOfPages, 20))
+		{
+			cprintf("content is not correct after moving\n");
+			is_correct = 0;
+		}
+		//the moved pages are still in memory: neither the move nor reading them faults
+		if (myEnv->pageFaultsCounter != faults)
+		{
+			cprintf("pages are copied instead of moved. # faults = %d\n", myEnv->pageFaultsCounter - faults);
+			is_correct = 0;
+		}
+		fill(newVA, 4 * numOfPages, 30);
+		va = newVA;
+		if (is_correct)
+		{
+			eval += 40;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n3: shrink a range: in place [15%]\n") ;
+	{
+		is_correct = 1;
+		newVA = realloc(va, numOfPages * PAGE_SIZE);
+		if (newVA != va || !check(newVA, numOfPages, 30))
+		{
+			cprintf("range is not shrunk in place. Expected %x, Actual %x\n", va, newVA);
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 15;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n4: free all: the break is back to the start [20%]\n") ;
+	{
+		is_correct = 1;
+		free(va);
+		free(blocker);
+		if (uheapPageAllocBreak != uheapPageAllocStart)
+		{
+			cprintf("BREAK value is not correct! Expected = %x, Actual = %x\n", uheapPageAllocStart, uheapPageAllocBreak);
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 20;
+		}
+	}
+
+	cprintf("%~\ntest realloc is finished. Evaluation = %d%\n", eval);
+
+	return;
+}
@@ -0,0 +1,113 @@
+#include <inc/lib.h>
+
+#define numOfAllocs 10
+#define allocPages 3
+
+int* startVAs[numOfAllocs] ;
+
+void _main(void)
+{
+	int eval = 0;
+	bool is_correct = 1;
+	uint32 oldStrategy = sys_get_uheap_strategy();
+
+	sys_set_uheap_strategy(UHP_PLACE_BRK);
+
+	//====================================================================//
+	cprintf("%~\n1: the initial break is the start of the page allocator [10%]\n") ;
+	{
+		if ((uint32)sys_sbrk(0) != USER_HEAP_PAGE_ALLOC_START)
+		{
+			cprintf("wrong initial break. Expected %x, Actual %x\n", USER_HEAP_PAGE_ALLOC_START, sys_sbrk(0));
+		}
+		else
+		{
+			eval += 10;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: allocations are bumped at the break without allocating any frame [40%]\n") ;
+	{
+		is_correct = 1;
+		int freeFrames = sys_calculate_free_frames() ;
+		uint32 expectedVA = USER_HEAP_PAGE_ALLOC_START;
+		for (int i = 0; i < numOfAllocs; ++i)
+		{
+			startVAs[i] = malloc(allocPages * PAGE_SIZE);
+			if ((uint32)startVAs[i] != expectedVA)
+			{
+				cprintf("malloc #2.%d: wrong address. Expected %x, Actual %x\n", i, expectedVA, startVAs[i]);
+				is_correct = 0;
+				break;
+			}
+			expectedVA += allocPages * PAGE_SIZE;
+		}
+		if ((uint32)sys_sbrk(0) != expectedVA || uheapPageAllocBreak != expectedVA)
+		{
+			cprintf("wrong break. Expected %x, Actual kernel %x user %x\n", expectedVA, sys_sbrk(0), uheapPageAllocBreak);
+			is_correct = 0;
+		}
+		//the page tables of the new pages may be allocated
+		if (freeFrames - sys_calculate_free_frames() > 1)
+		{
+			cprintf("frames are allocated before accessing the pages. # frames = %d\n", freeFrames - sys_calculate_free_frames());
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 40;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n3: the pages are allocated on their first access [30%]\n") ;
+	{
+		is_correct = 1;
+		for (int i = 0; i < numOfAllocs; ++i)
+		{
+			startVAs[i][0] = i;
+			startVAs[i][allocPages * PAGE_SIZE / sizeof(int) - 1] = -i;
+		}
+		for (int i = 0; i < numOfAllocs; ++i)
+		{
+			if (startVAs[i][0] != i || startVAs[i][allocPages * PAGE_SIZE / sizeof(int) - 1] != -i)
+			{
+				cprintf("range #3.%d: WRONG! content is not correct. Expected %d\n", i, i);
+				is_correct = 0;
+				break;
+			}
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n4: sys_sbrk(-n) moves the break back & out of range breaks are refused [20%]\n") ;
+	{
+		is_correct = 1;
+		uint32 oldBreak = (uint32)sys_sbrk(0);
+		if ((uint32)sys_sbrk(-allocPages) != oldBreak || (uint32)sys_sbrk(0) != oldBreak - allocPages * PAGE_SIZE)
+		{
+			cprintf("break is not moved back\n");
+			is_correct = 0;
+		}
+		if (sys_sbrk(-(int)NUM_OF_UHEAP_PAGES) != (void*)-1 || sys_sbrk(NUM_OF_UHEAP_PAGES) != (void*)-1)
+		{
+			cprintf("out of range break is not refused\n");
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 20;
+		}
+	}
+
+	sys_set_uheap_strategy(oldStrategy);
+
+	cprintf("%~\ntest sbrk is finished. Evaluation = %d%\n", eval);
+
+	return;
+}
@@ -0,0 +1,69 @@
+/* *********************************************************** */
+/* MAKE SURE PAGE_WS_MAX_SIZE = 2000 */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define numOfSlaves 3
+
+void _main(void)
+{
+	int eval = 0;
+	bool is_correct = 1;
+	int ids[numOfSlaves], diffs[numOfSlaves];
+
+	rsttst();
+
+	//====================================================================//
+	cprintf("%~\n1: the 1st env of a program loads its read-only pages, the next ones share them [70%]\n") ;
+	{
+		for (int i = 0; i < numOfSlaves; ++i)
+		{
+			int freeFrames = sys_calculate_free_frames() ;
+			ids[i] = sys_create_env("tshtext_slave", (myEnv->page_WS_max_size), (myEnv->SecondListSize), (myEnv->percentage_of_WS_pages_to_be_removed));
+			diffs[i] = freeFrames - sys_calculate_free_frames();
+			if (ids[i] < 0)
+			{
+				cprintf("env #%d is not created. error %d\n", i, ids[i]);
+				is_correct = 0;
+			}
+		}
+		for (int i = 1; i < numOfSlaves && is_correct; ++i)
+		{
+			if (diffs[i] >= diffs[0])
+			{
+				cprintf("read-only pages are not shared. # frames of env #%d = %d, of env #0 = %d\n", i, diffs[i], diffs[0]);
+				is_correct = 0;
+			}
+		}
+		if (is_correct)
+		{
+			eval += 70;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: the envs run correctly on the shared pages [30%]\n") ;
+	{
+		is_correct = 1;
+		for (int i = 0; i < numOfSlaves; ++i)
+		{
+			if (ids[i] >= 0)
+				sys_run_env(ids[i]);
+		}
+		env_sleep(1000);
+		if (gettst() != numOfSlaves)
+		{
+			cprintf("not all the envs are finished. Expected %d, Actual %d\n", numOfSlaves, gettst());
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	cprintf("%~\ntest shared read-only program pages is finished. Evaluation = %d%\n", eval);
+
+	return;
+}
@@ -0,0 +1,7 @@
+#include <inc/lib.h>
+
+void _main(void)
+{
+	inctst();
+	return;
+}
@@ -0,0 +1,143 @@
+/* *********************************************************** */
+/* MAKE SURE PAGE_WS_MAX_SIZE = 2000 */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define kilo (1024)
+#define numOfAllocs 100
+#define allocSize (3*PAGE_SIZE - kilo)
+#define numOfFrees (UHEAP_MAX_PENDING_RANGES/2)
+
+int* startVAs[numOfAllocs] ;
+int* endVAs[numOfAllocs] ;
+
+void _main(void)
+{
+#if USE_KHEAP
+	{
+		if (LIST_SIZE(&(myEnv->page_WS_list)) >= myEnv->page_WS_max_size)
+			panic("Please increase the WS size");
+	}
+#else
+	panic("make sure to enable the kernel heap: USE_KHEAP=1");
+#endif
+
+	/*=================================================*/
+
+	int eval = 0;
+	bool is_correct = 1;
+	int usedDiskPages = sys_pf_calculate_allocated_pages() ;
+	uint32 expectedNumOfSyscalls;
+
+	uheap_set_arenas(1);
+
+	//====================================================================//
+	cprintf("%~\n1: allocate & fill a set of page allocator ranges [20%]\n") ;
+	{
+		is_correct = 1;
+		for (int i = 0; i < numOfAllocs; ++i)
+		{
+			startVAs[i] = malloc(allocSize);
+			if (startVAs[i] == NULL)
+			{
+				cprintf("malloc #1.%d: unexpected NULL\n", i);
+				is_correct = 0;
+				break;
+			}
+			endVAs[i] = (int*)((char*)startVAs[i] + allocSize) - 1;
+			*startVAs[i] = i;
+			*endVAs[i] = -i;
+		}
+		if (is_correct)
+		{
+			eval += 20;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n2: only one syscall per arena should be issued [20%]\n") ;
+	{
+		//each arena holds the 3 pages of the triggering range + UHEAP_ARENA_PAGES ahead of it
+		expectedNumOfSyscalls = ROUNDUP(numOfAllocs, 1 + UHEAP_ARENA_PAGES / 3) / (1 + UHEAP_ARENA_PAGES / 3);
+		if (uheapStats.num_of_syscalls > expectedNumOfSyscalls)
+		{
+			cprintf("too many syscalls. Expected at most %d, Actual %d\n", expectedNumOfSyscalls, uheapStats.num_of_syscalls);
+		}
+		else
+		{
+			eval += 20;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n3: free some ranges & reallocate them without any syscall [30%]\n") ;
+	{
+		is_correct = 1;
+		uint32 numOfSyscalls = uheapStats.num_of_syscalls;
+		for (int i = 0; i < 2*numOfFrees; i += 2)
+		{
+			free(startVAs[i]);
+		}
+		for (int i = 0; i < 2*numOfFrees; i += 2)
+		{
+			startVAs[i] = malloc(allocSize);
+			endVAs[i] = (int*)((char*)startVAs[i] + allocSize) - 1;
+			*startVAs[i] = i;
+			*endVAs[i] = -i;
+		}
+		//the freed ranges are still pending (not released yet), so they're reused as they are
+		if (uheapStats.num_of_syscalls != numOfSyscalls)
+		{
+			cprintf("unexpected syscalls. Expected 0, Actual %d\n", uheapStats.num_of_syscalls - numOfSyscalls);
+			is_correct = 0;
+		}
+		for (int i = 0; i < numOfAllocs; ++i)
+		{
+			if (*startVAs[i] != i || *endVAs[i] != -i)
+			{
+				cprintf("range #3.%d: WRONG! content is not correct. Expected %d\n", i, i);
+				is_correct = 0;
+				break;
+			}
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	//====================================================================//
+	cprintf("%~\n4: free all & disable the arenas: all pages should be freed [30%]\n") ;
+	{
+		is_correct = 1;
+		for (int i = 0; i < numOfAllocs; ++i)
+		{
+			free(startVAs[i]);
+		}
+		uheap_set_arenas(0);
+		if (uheapPageAllocBreak != uheapPageAllocStart)
+		{
+			cprintf("BREAK value is not correct! Expected = %x, Actual = %x\n", uheapPageAllocStart, uheapPageAllocBreak);
+			is_correct = 0;
+		}
+		if (sys_pf_calculate_allocated_pages() != usedDiskPages)
+		{
+			cprintf("page(s) are still allocated in PageFile\n");
+			is_correct = 0;
+		}
+		if (uheap_syscalls_saved() <= 0)
+		{
+			cprintf("no syscalls are saved by the arenas\n");
+			is_correct = 0;
+		}
+		if (is_correct)
+		{
+			eval += 30;
+		}
+	}
+
+	cprintf("%~\ntest user heap arenas is finished. Evaluation = %d%\n", eval);
+
+	return;
+}